@@ -0,0 +1,216 @@
+/**
+ * @brief     C++ aligned allocator template implemenation
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_ALIGNED_ALLOCATOR_H_
+#define taapp_ALIGNED_ALLOCATOR_H_
+
+#include "allocator_traits.h"
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+namespace taapp
+{
+
+/**
+ * @brief allocator that aligns every block to Alignment bytes
+ * @details malloc only guarantees alignment suitable for the largest scalar
+ * type, typically 16 bytes. This allocator lets the buffer of a vector feed
+ * aligned 32 or 64 byte SIMD loads directly. Alignment must be a power of
+ * two and a multiple of sizeof(void*). The alignment is preserved by
+ * allocate and reallocate, so the reallocate fast path used by vector for
+ * trivial types keeps it as well.
+ *
+ * Like realloc, reallocate leaves p untouched when it fails. realloc itself
+ * is not used outside of Visual C++, since a block it moves may lose its
+ * alignment after p has already been released. Instead the new aligned
+ * block is allocated first and the contents are copied to it.
+ */
+template<typename T, size_t Alignment> class aligned_allocator
+{
+public:
+
+    template<typename U> struct rebind
+    {
+        typedef aligned_allocator<U, Alignment> other;
+    };
+
+    inline aligned_allocator()
+#ifndef NDEBUG
+        : counter_(0)
+#endif
+    {
+    }
+
+#ifndef NDEBUG
+    inline aligned_allocator(const aligned_allocator&) : counter_(0)
+    {
+    }
+#endif
+
+    template<typename U>
+    inline aligned_allocator(const aligned_allocator<U, Alignment>&)
+#ifndef NDEBUG
+        : counter_(0)
+#endif
+    {
+    }
+
+#ifndef NDEBUG
+    ~aligned_allocator()
+    {
+        assert(counter_ == 0);
+    }
+#endif
+
+    inline bool operator==(const aligned_allocator&) const
+    {
+        return true;
+    }
+
+    inline bool operator!=(const aligned_allocator&) const
+    {
+        return false;
+    }
+
+    // exchanges the state of two instances, so that each keeps counting
+    // the blocks it handed out
+    inline void swap(aligned_allocator& other)
+    {
+#ifndef NDEBUG
+        int counter = counter_;
+        counter_ = other.counter_;
+        other.counter_ = counter;
+#endif
+    }
+
+    // allocate but don't initialize num elements of type T
+    inline T* allocate (size_t n, const void* = 0)
+    {
+        T* t = static_cast<T*>(aligned_malloc(sizeof(*t) * n));
+#ifndef NDEBUG
+        ++counter_;
+#endif
+        return t;
+    }
+
+    // resize storage p from oldn to n elements, preserving its contents.
+    // returns NULL and leaves p valid on failure
+    T* reallocate(void* p, size_t oldn, size_t n)
+    {
+        size_t size = sizeof(T) * n;
+        void* t;
+#ifndef NDEBUG
+        if(p == NULL)
+        {
+            ++counter_;
+        }
+#endif
+#if defined(_MSC_VER)
+        t = _aligned_realloc(p, size, Alignment);
+#else
+        // p is only released once its contents are in the new block
+        t = aligned_malloc(size);
+        if(t != NULL && p != NULL)
+        {
+            size_t oldsize = sizeof(T) * oldn;
+            memcpy(t, p, (oldsize < size) ? oldsize : size);
+            free(p);
+        }
+#endif
+        return static_cast<T*>(t);
+    }
+
+    // number of elements that fit in storage p allocated for n elements
+    inline size_t usable_size(T* p, size_t n)
+    {
+#if defined(_MSC_VER) && defined(taapp_HEAP_USABLE_SIZE)
+        size_t usable = (p != NULL) ? _aligned_msize(p, Alignment, 0) : 0;
+        return ((usable > sizeof(T) * n) ? usable : sizeof(T) * n) / sizeof(T);
+#else
+        return heap_usable_size(p, sizeof(T) * n) / sizeof(T);
+#endif
+    }
+
+    // initialize elements of allocated storage p with value v
+    inline void construct (T* p, const T& v)
+    {
+        new(static_cast<void*>(p)) constructor(v);
+    }
+
+    // destroy but do not deallocate elements of initialized storage p
+    inline void destroy (T* p)
+    {
+        p->~T();
+    }
+
+    // deallocate storage p of deleted elements
+    inline void deallocate(T* p, size_t n)
+    {
+#ifndef NDEBUG
+        --counter_;
+#endif
+#if defined(_MSC_VER)
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+
+private:
+
+    typedef int AlignmentCheck[
+        ((Alignment & (Alignment - 1)) == 0 &&
+         Alignment % sizeof(void*) == 0) * 2 - 1];
+
+#ifndef NDEBUG
+    int counter_;
+#endif
+
+    // define a custom placement new operator to remove dependency on
+    // the std <new> header
+    class constructor
+    {
+    public:
+        T t_;
+
+        inline constructor(const T& t) : t_(t)
+        {
+        }
+
+        inline void* operator new (size_t size, void* ptr)
+        {
+            return ptr;
+        }
+
+        inline void operator delete (void *, void *)
+        {
+        }
+    };
+
+    static inline bool is_aligned(const void* p)
+    {
+        return (reinterpret_cast<size_t>(p) & (Alignment - 1)) == 0;
+    }
+
+    static inline void* aligned_malloc(size_t size)
+    {
+#if defined(_MSC_VER)
+        return _aligned_malloc(size, Alignment);
+#else
+        void* p;
+        return (posix_memalign(&p, Alignment, size) == 0) ? p : NULL;
+#endif
+    }
+};
+
+}
+
+#endif // taapp_ALIGNED_ALLOCATOR_H_
@@ -7,6 +7,7 @@
 #ifndef taapp_ALLOCATOR_H_
 #define taapp_ALLOCATOR_H_
 
+#include "allocator_traits.h"
 #include <cassert>
 #include <cstdlib>
 
@@ -22,11 +23,30 @@ public:
         typedef allocator<U> other;
     };
 
+    inline allocator()
 #ifndef NDEBUG
-    allocator() : counter_(0)
+        : counter_(0)
+#endif
+    {
+    }
+
+    // copies, including those obtained through rebind, count their own
+    // allocations in debug builds
+#ifndef NDEBUG
+    inline allocator(const allocator&) : counter_(0)
+    {
+    }
+#endif
+
+    template<typename U>
+    inline allocator(const allocator<U>&)
+#ifndef NDEBUG
+        : counter_(0)
+#endif
     {
     }
 
+#ifndef NDEBUG
     ~allocator()
     {
         assert(counter_ == 0);
@@ -43,6 +63,17 @@ public:
         return false;
     }
 
+    // exchanges the state of two instances, so that each keeps counting
+    // the blocks it handed out
+    inline void swap(allocator& other)
+    {
+#ifndef NDEBUG
+        int counter = counter_;
+        counter_ = other.counter_;
+        other.counter_ = counter;
+#endif
+    }
+
     // allocate but don't initialize num elements of type T
     inline T* allocate (size_t n, const void* = 0)
     {
@@ -65,6 +96,20 @@ public:
         return t;
     }
 
+    // resize storage p from oldn to n elements, preserving its contents.
+    // knowing the old size lets allocators that do not track it themselves
+    // implement reallocation; this one simply forwards to realloc.
+    inline T* reallocate(void* p, size_t oldn, size_t n)
+    {
+        return reallocate(p, n);
+    }
+
+    // number of elements that fit in storage p allocated for n elements
+    inline size_t usable_size(T* p, size_t n)
+    {
+        return heap_usable_size(p, sizeof(T) * n) / sizeof(T);
+    }
+
     // initialize elements of allocated storage p with value v
     inline void construct (T* p, const T& v)
     {
@@ -0,0 +1,381 @@
+/**
+ * @brief     compile time detection of optional allocator features
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_ALLOCATOR_TRAITS_H_
+#define taapp_ALLOCATOR_TRAITS_H_
+
+#include "relative_ptr.h"
+#include <cstddef>
+#include <cstdlib>
+
+#if defined(taapp_HEAP_USABLE_SIZE)
+#if defined(__GLIBC__) || defined(_MSC_VER)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+#endif
+
+namespace taapp
+{
+
+/**
+ * @brief returns the number of bytes usable in a block from malloc
+ * @details malloc rounds requests up to its own size classes, so a block
+ * requested with size bytes may have room for more. The platform is only
+ * asked when taapp_HEAP_USABLE_SIZE is defined: glibc documents
+ * malloc_usable_size as a diagnostic, and _FORTIFY_SOURCE=3 reports writes
+ * past the requested size as overflows. size is returned otherwise, or if
+ * the platform provides no way to query the block.
+ */
+inline size_t heap_usable_size(void* p, size_t size)
+{
+    size_t usable = size;
+#if defined(taapp_HEAP_USABLE_SIZE)
+    if(p != NULL)
+    {
+#if defined(__GLIBC__)
+        usable = malloc_usable_size(p);
+#elif defined(_MSC_VER)
+        usable = _msize(p);
+#elif defined(__APPLE__)
+        usable = malloc_size(p);
+#endif
+    }
+#else
+    (void) p;
+#endif
+    return (usable > size) ? usable : size;
+}
+
+/**
+ * @brief describes the optional members an allocator for type T provides
+ * @details Containers use this to take advantage of allocator extensions
+ * when present, and fall back to the required interface otherwise.
+ *
+ * usable_size: size_t usable_size(T* p, size_t n) returns the number of
+ * elements that fit in the block p allocated for n elements. The result
+ * may be passed as n to reallocate and deallocate in place of the original.
+ *
+ * allocate_bulk: T* allocate_bulk(size_t n) allocates n blocks of one T
+ * each in a single call, and void deallocate_bulk(T* chain, size_t n)
+ * frees them the same way. The blocks form a chain linked through their
+ * first pointer sized word (see chain_next), terminated by NULL. Each block
+ * may also be freed individually with deallocate(p, 1), and blocks from
+ * allocate(1) may be returned through deallocate_bulk.
+ *
+ * release_all: void release_all() frees every block the allocator instance
+ * has handed out. Containers whose values are trivially destructible call
+ * it from clear() instead of deallocating each node.
+ *
+ * swap: void swap(Alloc& other) exchanges the state of two instances.
+ * Allocators whose copies do not share state, such as those that count
+ * their blocks or own slabs, provide it so that containers can swap them.
+ *
+ * reallocate: T* reallocate(void* p, size_t oldn, size_t n) resizes a
+ * block, and is told its old size so that allocators which do not track
+ * sizes can move it. Allocators written against the older
+ * T* reallocate(void* p, size_t n) are called with that instead.
+ */
+template<typename Alloc, typename T> class allocator_traits
+{
+private:
+
+    typedef char yes[1];
+    typedef char no[2];
+
+    template<typename U, size_t (U::*)(T*, size_t)> struct check;
+
+    template<typename U> static yes& test_usable_size(
+        check<U, &U::usable_size>*);
+    template<typename U> static no& test_usable_size(...);
+
+    template<typename U, T* (U::*)(size_t)> struct check_bulk;
+
+    template<typename U> static yes& test_allocate_bulk(
+        check_bulk<U, &U::allocate_bulk>*);
+    template<typename U> static no& test_allocate_bulk(...);
+
+    template<typename U, void (U::*)()> struct check_release;
+
+    template<typename U> static yes& test_release_all(
+        check_release<U, &U::release_all>*);
+    template<typename U> static no& test_release_all(...);
+
+    template<typename U, void (U::*)(U&)> struct check_swap;
+
+    template<typename U> static yes& test_swap(check_swap<U, &U::swap>*);
+    template<typename U> static no& test_swap(...);
+
+    template<typename U, T* (U::*)(void*, size_t, size_t)>
+    struct check_sized_reallocate;
+
+    template<typename U> static yes& test_sized_reallocate(
+        check_sized_reallocate<U, &U::reallocate>*);
+    template<typename U> static no& test_sized_reallocate(...);
+
+    template<typename U, T* (U::*)(void*, size_t)>
+    struct check_unsized_reallocate;
+
+    template<typename U> static yes& test_unsized_reallocate(
+        check_unsized_reallocate<U, &U::reallocate>*);
+    template<typename U> static no& test_unsized_reallocate(...);
+
+    template<bool Enable, int Dummy = 0> struct select
+    {
+        static inline size_t usable_size(Alloc&, T*, size_t n)
+        {
+            return n;
+        }
+
+        static T* allocate_chain(Alloc& a, size_t n)
+        {
+            T* chain = NULL;
+            while(n > 0)
+            {
+                T* p = a.allocate(1);
+                if(p == NULL)
+                {
+                    break;
+                }
+                set_chain_next(p, chain);
+                chain = p;
+                --n;
+            }
+            return chain;
+        }
+
+        static void deallocate_chain(Alloc& a, T* chain, size_t)
+        {
+            while(chain != NULL)
+            {
+                T* next = chain_next(chain);
+                a.deallocate(chain, 1);
+                chain = next;
+            }
+        }
+
+        static inline void release_all(Alloc&)
+        {
+        }
+    };
+
+    template<int Dummy> struct select<true, Dummy>
+    {
+        static inline size_t usable_size(Alloc& a, T* p, size_t n)
+        {
+            return a.usable_size(p, n);
+        }
+
+        static inline T* allocate_chain(Alloc& a, size_t n)
+        {
+            return a.allocate_bulk(n);
+        }
+
+        static inline void deallocate_chain(Alloc& a, T* chain, size_t n)
+        {
+            a.deallocate_bulk(chain, n);
+        }
+
+        static inline void release_all(Alloc& a)
+        {
+            a.release_all();
+        }
+    };
+
+    template<bool Member, bool Empty, int Dummy = 0> struct select_swap
+    {
+        static inline void swap(Alloc& a, Alloc& b)
+        {
+            Alloc t(a);
+            a = b;
+            b = t;
+        }
+    };
+
+    template<bool Empty, int Dummy> struct select_swap<true, Empty, Dummy>
+    {
+        static inline void swap(Alloc& a, Alloc& b)
+        {
+            a.swap(b);
+        }
+    };
+
+    // taking the address of reallocate instantiates it, so the test is
+    // only made for allocators that are actually reallocated through. an
+    // inherited member is not detected, so the sized form is assumed
+    // unless Alloc declares only the unsized one
+    template<int Dummy = 0> struct reallocate_form
+    {
+        enum
+        {
+            SIZED =
+                sizeof(test_sized_reallocate<Alloc>(0)) == sizeof(yes) ||
+                sizeof(test_unsized_reallocate<Alloc>(0)) != sizeof(yes)
+        };
+    };
+
+    template<bool Sized, int Dummy = 0> struct select_reallocate
+    {
+        static inline T* reallocate(Alloc& a, void* p, size_t, size_t n)
+        {
+            return a.reallocate(p, n);
+        }
+    };
+
+    template<int Dummy> struct select_reallocate<true, Dummy>
+    {
+        static inline T* reallocate(
+            Alloc& a,
+            void* p,
+            size_t oldn,
+            size_t n)
+        {
+            return a.reallocate(p, oldn, n);
+        }
+    };
+
+    // an allocator with no state has nothing to exchange, and need not be
+    // copyable
+    template<int Dummy> struct select_swap<false, true, Dummy>
+    {
+        static inline void swap(Alloc&, Alloc&)
+        {
+        }
+    };
+
+public:
+
+    enum
+    {
+        HAS_USABLE_SIZE =
+            sizeof(test_usable_size<Alloc>(0)) == sizeof(yes),
+        HAS_ALLOCATE_BULK =
+            sizeof(test_allocate_bulk<Alloc>(0)) == sizeof(yes),
+        HAS_RELEASE_ALL =
+            sizeof(test_release_all<Alloc>(0)) == sizeof(yes),
+        HAS_SWAP = sizeof(test_swap<Alloc>(0)) == sizeof(yes)
+    };
+
+    static inline size_t usable_size(Alloc& a, T* p, size_t n)
+    {
+        return select<HAS_USABLE_SIZE>::usable_size(a, p, n);
+    }
+
+    /**
+     * @brief allocates a chain of n blocks of one T each
+     * @details uses allocate_bulk if available, or n calls to allocate(1).
+     * may return fewer than n blocks if memory is exhausted.
+     */
+    static inline T* allocate_chain(Alloc& a, size_t n)
+    {
+        return select<HAS_ALLOCATE_BULK>::allocate_chain(a, n);
+    }
+
+    // frees a chain of n blocks, with deallocate_bulk if available
+    static inline void deallocate_chain(Alloc& a, T* chain, size_t n)
+    {
+        select<HAS_ALLOCATE_BULK>::deallocate_chain(a, chain, n);
+    }
+
+    /**
+     * @brief exchanges the allocators a and b
+     * @details uses the allocator's swap if available, so that state
+     * belonging to an instance, such as its slabs or debug counters, moves
+     * with the blocks it handed out. otherwise allocators with state are
+     * exchanged through a copy, as taapp::swap does.
+     */
+    static inline void swap(Alloc& a, Alloc& b)
+    {
+        select_swap<HAS_SWAP, __is_empty(Alloc)>::swap(a, b);
+    }
+
+    // resizes storage p from oldn to n elements, preserving its contents
+    static inline T* reallocate(Alloc& a, void* p, size_t oldn, size_t n)
+    {
+        return select_reallocate<reallocate_form<>::SIZED>::reallocate(
+            a,
+            p,
+            oldn,
+            n);
+    }
+
+    // frees everything allocated from a, if the allocator supports it
+    static inline void release_all(Alloc& a)
+    {
+        select<HAS_RELEASE_ALL>::release_all(a);
+    }
+
+    // the block after p in a chain
+    static inline T* chain_next(T* p)
+    {
+        return *reinterpret_cast<T**>(p);
+    }
+
+    static inline void set_chain_next(T* p, T* next)
+    {
+        *reinterpret_cast<T**>(p) = next;
+    }
+
+    // the number of blocks in a chain. a chain from allocate_chain may be
+    // shorter than requested, so this gives the n to deallocate it with
+    static inline size_t chain_length(T* chain)
+    {
+        size_t n = 0;
+        while(chain != NULL)
+        {
+            ++n;
+            chain = chain_next(chain);
+        }
+        return n;
+    }
+};
+
+/**
+ * @brief selects the pointer type containers use to link their nodes
+ * @details An allocator whose memory may be mapped at a different address
+ * in each process, such as file_allocator, declares a nested type named
+ * relative_pointers. Containers using it link their nodes with relative_ptr
+ * so they stay valid wherever the memory is mapped. All other allocators
+ * get plain pointers.
+ */
+template<typename Alloc> class pointer_traits
+{
+private:
+
+    typedef char yes[1];
+    typedef char no[2];
+
+    template<typename U> static yes& test_relative(
+        typename U::relative_pointers*);
+    template<typename U> static no& test_relative(...);
+
+    template<bool Relative, typename U> struct select
+    {
+        typedef U* type;
+    };
+
+    template<typename U> struct select<true, U>
+    {
+        typedef relative_ptr<U> type;
+    };
+
+public:
+
+    enum
+    {
+        RELATIVE_POINTERS = sizeof(test_relative<Alloc>(0)) == sizeof(yes)
+    };
+
+    template<typename U> struct rebind
+    {
+        typedef typename select<RELATIVE_POINTERS, U>::type other;
+    };
+};
+
+}
+
+#endif // taapp_ALLOCATOR_TRAITS_H_
@@ -0,0 +1,252 @@
+/**
+ * @brief     atomic operations used by the concurrent containers
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_ATOMIC_H_
+#define taapp_ATOMIC_H_
+
+#include <cstddef>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/**
+ * @brief declares a variable with thread storage duration
+ * @details the variable must be a POD type with a constant initializer.
+ */
+#if defined(_MSC_VER)
+#define taapp_THREAD_LOCAL __declspec(thread)
+#else
+#define taapp_THREAD_LOCAL __thread
+#endif
+
+namespace taapp
+{
+
+/*
+   These functions operate on naturally aligned integer or pointer words of
+   4 or 8 bytes. They depend upon compiler intrinsics: the __atomic builtins
+   on GCC 4.7+ and clang, and the Interlocked family on Microsoft Visual C++.
+   Loads have acquire semantics, stores have release semantics, and
+   read-modify-write operations are sequentially consistent. The _relaxed
+   variants only guarantee that the access itself is not torn.
+*/
+
+#if defined(_MSC_VER)
+
+template<size_t Size> struct atomic_word;
+
+template<> struct atomic_word<4>
+{
+    typedef long type;
+
+    static inline type compare_exchange(volatile void* p, type e, type d)
+    {
+        return _InterlockedCompareExchange(
+            static_cast<volatile type*>(p), d, e);
+    }
+
+    static inline type exchange(volatile void* p, type v)
+    {
+        return _InterlockedExchange(static_cast<volatile type*>(p), v);
+    }
+
+    static inline type fetch_add(volatile void* p, type v)
+    {
+        return _InterlockedExchangeAdd(static_cast<volatile type*>(p), v);
+    }
+};
+
+template<> struct atomic_word<8>
+{
+    typedef __int64 type;
+
+    static inline type compare_exchange(volatile void* p, type e, type d)
+    {
+        return _InterlockedCompareExchange64(
+            static_cast<volatile type*>(p), d, e);
+    }
+
+    static inline type exchange(volatile void* p, type v)
+    {
+        return _InterlockedExchange64(static_cast<volatile type*>(p), v);
+    }
+
+    static inline type fetch_add(volatile void* p, type v)
+    {
+        return _InterlockedExchangeAdd64(static_cast<volatile type*>(p), v);
+    }
+};
+
+// converts between a value and the integer word of the same size
+template<typename T> union atomic_cast
+{
+    T value;
+    typename atomic_word<sizeof(T)>::type word;
+};
+
+#endif // _MSC_VER
+
+template<typename T> inline T atomic_load(const volatile T* p)
+{
+#if defined(_MSC_VER)
+    T v = *p;
+    _ReadWriteBarrier();
+    return v;
+#else
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+template<typename T> inline T atomic_load_relaxed(const volatile T* p)
+{
+#if defined(_MSC_VER)
+    return *p;
+#else
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+#endif
+}
+
+template<typename T> inline void atomic_store(volatile T* p, T v)
+{
+#if defined(_MSC_VER)
+    _ReadWriteBarrier();
+    *p = v;
+#else
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#endif
+}
+
+template<typename T> inline void atomic_store_relaxed(volatile T* p, T v)
+{
+#if defined(_MSC_VER)
+    *p = v;
+#else
+    __atomic_store_n(p, v, __ATOMIC_RELAXED);
+#endif
+}
+
+/**
+ * @brief replaces *p with desired if *p equals expected
+ * @details on failure expected is updated to the current value of *p.
+ */
+template<typename T>
+inline bool atomic_compare_exchange(volatile T* p, T& expected, T desired)
+{
+#if defined(_MSC_VER)
+    typedef atomic_word<sizeof(T)> word;
+    atomic_cast<T> e;
+    atomic_cast<T> d;
+    atomic_cast<T> r;
+    e.value = expected;
+    d.value = desired;
+    r.word = word::compare_exchange(p, e.word, d.word);
+    expected = r.value;
+    return r.word == e.word;
+#else
+    return __atomic_compare_exchange_n(
+        p,
+        &expected,
+        desired,
+        false,
+        __ATOMIC_SEQ_CST,
+        __ATOMIC_SEQ_CST);
+#endif
+}
+
+template<typename T> inline T atomic_exchange(volatile T* p, T v)
+{
+#if defined(_MSC_VER)
+    atomic_cast<T> c;
+    c.value = v;
+    c.word = atomic_word<sizeof(T)>::exchange(p, c.word);
+    return c.value;
+#else
+    return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// adds v to the integer *p, returning the previous value
+template<typename T> inline T atomic_fetch_add(volatile T* p, T v)
+{
+#if defined(_MSC_VER)
+    typedef typename atomic_word<sizeof(T)>::type type;
+    return static_cast<T>(atomic_word<sizeof(T)>::fetch_add(
+        p,
+        static_cast<type>(v)));
+#else
+    return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// adds v to the integer *p without ordering other memory accesses, for
+// counters that are only read for statistics
+template<typename T> inline T atomic_fetch_add_relaxed(volatile T* p, T v)
+{
+#if defined(_MSC_VER)
+    return atomic_fetch_add(p, v);
+#else
+    return __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+#endif
+}
+
+// full memory barrier
+inline void atomic_thread_fence()
+{
+#if defined(_MSC_VER)
+    _mm_mfence();
+#else
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+// hint to the processor that the caller is spinning
+inline void cpu_relax()
+{
+#if defined(_MSC_VER)
+    _mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/**
+ * @brief test and test-and-set spin lock
+ * @details intended for critical sections of a few instructions. The lock
+ * is a POD type so that it may be statically initialized to zero.
+ */
+struct spinlock
+{
+    volatile int locked_;
+
+    inline void lock()
+    {
+        int expected = 0;
+        while(!atomic_compare_exchange(&locked_, expected, 1))
+        {
+            while(atomic_load_relaxed(&locked_) != 0)
+            {
+                cpu_relax();
+            }
+            expected = 0;
+        }
+    }
+
+    inline bool try_lock()
+    {
+        int expected = 0;
+        return atomic_compare_exchange(&locked_, expected, 1);
+    }
+
+    inline void unlock()
+    {
+        atomic_store(&locked_, 0);
+    }
+};
+
+}
+
+#endif // taapp_ATOMIC_H_
@@ -0,0 +1,268 @@
+/**
+ * @brief     C++ compressed pair template implemenation
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_COMPRESSED_PAIR_H_
+#define taapp_COMPRESSED_PAIR_H_
+
+namespace taapp
+{
+
+/**
+ * @brief chooses how compressed_pair stores T and U
+ * @details an empty class is stored as a base so that it takes no space.
+ * both types can only be bases if they differ. relies on the __is_empty
+ * intrinsic, which gcc, clang and msvc provide.
+ */
+template<typename T, typename U> struct compressed_pair_layout
+{
+    template<typename A, typename B> struct same
+    {
+        enum { VALUE = false };
+    };
+
+    template<typename A> struct same<A, A>
+    {
+        enum { VALUE = true };
+    };
+
+    enum
+    {
+        FIRST_EMPTY = __is_empty(T),
+        SECOND_EMPTY = __is_empty(U) && !(FIRST_EMPTY && same<T, U>::VALUE),
+        VALUE = (FIRST_EMPTY ? 1 : 0) | (SECOND_EMPTY ? 2 : 0)
+    };
+};
+
+/**
+ * @brief pair whose empty members occupy no storage
+ * @details Containers keep their comparison functors and allocators in a
+ * compressed_pair with one of their data members, so stateless ones add
+ * nothing to the size of the container. Classes that keep more than two
+ * such members derive from a compressed_member for each instead.
+ */
+template<
+    typename T,
+    typename U,
+    int Layout = compressed_pair_layout<T, U>::VALUE>
+class compressed_pair
+{
+public:
+
+    inline compressed_pair() : first_(), second_()
+    {
+    }
+
+    inline compressed_pair(const T& t, const U& u) : first_(t), second_(u)
+    {
+    }
+
+    inline T& first()
+    {
+        return first_;
+    }
+
+    inline const T& first() const
+    {
+        return first_;
+    }
+
+    inline U& second()
+    {
+        return second_;
+    }
+
+    inline const U& second() const
+    {
+        return second_;
+    }
+
+private:
+
+    T first_;
+    U second_;
+};
+
+template<typename T, typename U>
+class compressed_pair<T, U, 1> : private T
+{
+public:
+
+    inline compressed_pair() : T(), second_()
+    {
+    }
+
+    inline compressed_pair(const T& t, const U& u) : T(t), second_(u)
+    {
+    }
+
+    inline T& first()
+    {
+        return *this;
+    }
+
+    inline const T& first() const
+    {
+        return *this;
+    }
+
+    inline U& second()
+    {
+        return second_;
+    }
+
+    inline const U& second() const
+    {
+        return second_;
+    }
+
+private:
+
+    U second_;
+};
+
+template<typename T, typename U>
+class compressed_pair<T, U, 2> : private U
+{
+public:
+
+    inline compressed_pair() : U(), first_()
+    {
+    }
+
+    inline compressed_pair(const T& t, const U& u) : U(u), first_(t)
+    {
+    }
+
+    inline T& first()
+    {
+        return first_;
+    }
+
+    inline const T& first() const
+    {
+        return first_;
+    }
+
+    inline U& second()
+    {
+        return *this;
+    }
+
+    inline const U& second() const
+    {
+        return *this;
+    }
+
+private:
+
+    T first_;
+};
+
+template<typename T, typename U>
+class compressed_pair<T, U, 3> : private T, private U
+{
+public:
+
+    inline compressed_pair() : T(), U()
+    {
+    }
+
+    inline compressed_pair(const T& t, const U& u) : T(t), U(u)
+    {
+    }
+
+    inline T& first()
+    {
+        return *this;
+    }
+
+    inline const T& first() const
+    {
+        return *this;
+    }
+
+    inline U& second()
+    {
+        return *this;
+    }
+
+    inline const U& second() const
+    {
+        return *this;
+    }
+};
+
+/**
+ * @brief a member that occupies no storage when T is empty
+ * @details A class holding several functors and allocators derives from one
+ * compressed_member for each and names an accessor for each, e.g.
+ * @code
+ * struct functors :
+ *     compressed_member<Hash, 0>,
+ *     compressed_member<Pred, 1>
+ * {
+ *     inline Hash& hasher() { return compressed_member<Hash, 0>::get(); }
+ *     inline Pred& equals() { return compressed_member<Pred, 1>::get(); }
+ * };
+ * @endcode
+ * Index tells apart the bases of one class, so two members may have the
+ * same type.
+ */
+template<typename T, int Index, bool Empty = __is_empty(T)>
+class compressed_member
+{
+public:
+
+    inline compressed_member() : value_()
+    {
+    }
+
+    inline explicit compressed_member(const T& t) : value_(t)
+    {
+    }
+
+    inline T& get()
+    {
+        return value_;
+    }
+
+    inline const T& get() const
+    {
+        return value_;
+    }
+
+private:
+
+    T value_;
+};
+
+template<typename T, int Index>
+class compressed_member<T, Index, true> : private T
+{
+public:
+
+    inline compressed_member() : T()
+    {
+    }
+
+    inline explicit compressed_member(const T& t) : T(t)
+    {
+    }
+
+    inline T& get()
+    {
+        return *this;
+    }
+
+    inline const T& get() const
+    {
+        return *this;
+    }
+};
+
+}
+
+#endif // taapp_COMPRESSED_PAIR_H_
@@ -0,0 +1,234 @@
+/**
+ * @brief     C++ sharded concurrent hash map template implemenation
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_CONCURRENT_UNORDERED_MAP_H_
+#define taapp_CONCURRENT_UNORDERED_MAP_H_
+
+#include "pair.h"
+#include "thread.h"
+#include "unordered_map.h"
+#include <cstddef>
+
+namespace taapp
+{
+
+/**
+ * @brief hash map that many threads may use at once
+ * @details Keys are partitioned across Shards shards, each an unordered_map
+ * guarded by its own rwlock, so threads working on different shards do not
+ * contend. Lookups take a shard's lock shared and modifications take it
+ * exclusively. Shards are padded so that no two share a cache line. Shards
+ * must be a power of two, and the functors and allocator are default
+ * constructed for every shard.
+ *
+ * No reference into the map ever escapes a lock: find copies the value
+ * out, and visit calls a functor on the value while the shard is locked.
+ * The functor must not call back into the map, and must not change the
+ * key. size() and visit_all lock one shard at a time, so they do not see a
+ * single consistent state of the map while other threads modify it.
+ */
+template<
+    typename Key,
+    typename T,
+    typename Hash = hash<Key>,
+    typename Pred = equal_to<Key>,
+    typename Alloc = allocator<pair<Key, T> >,
+    size_t Shards = 64>
+class concurrent_unordered_map
+{
+public:
+
+    typedef unordered_map<Key, T, Hash, Pred, Alloc> table;
+    typedef typename table::value_type value_type;
+
+    concurrent_unordered_map()
+    {
+    }
+
+    // removes every item. each shard is cleared in turn
+    void clear()
+    {
+        for(size_t i = 0; i < Shards; ++i)
+        {
+            scoped_lock<rwlock> lock(shards_[i].lock);
+            shards_[i].map.clear();
+        }
+    }
+
+    inline bool contains(const Key& k) const
+    {
+        const shard& s = get_shard(k);
+        shared_lock<rwlock> lock(s.lock);
+        return s.map.find(k) != s.map.end();
+    }
+
+    // removes k. returns true if it was present
+    inline bool erase(const Key& k)
+    {
+        shard& s = get_shard(k);
+        scoped_lock<rwlock> lock(s.lock);
+        return s.map.erase(k) != 0;
+    }
+
+    // copies the value of k to out. returns false if k is absent
+    inline bool find(const Key& k, T& out) const
+    {
+        const shard& s = get_shard(k);
+        shared_lock<rwlock> lock(s.lock);
+        typename table::const_iterator itr(s.map.find(k));
+        if(itr != s.map.end())
+        {
+            out = itr->second;
+            return true;
+        }
+        return false;
+    }
+
+    // inserts v if its key is absent. returns true if it was inserted
+    inline bool insert(const value_type& v)
+    {
+        shard& s = get_shard(v.first);
+        scoped_lock<rwlock> lock(s.lock);
+        return s.map.insert(v).second;
+    }
+
+    // inserts or overwrites the value of k. returns true if it was inserted
+    inline bool insert_or_assign(const Key& k, const T& t)
+    {
+        shard& s = get_shard(k);
+        scoped_lock<rwlock> lock(s.lock);
+        return s.map.insert_or_assign(k, t).second;
+    }
+
+    // the number of items, summed over the shards one at a time
+    size_t size() const
+    {
+        size_t count = 0;
+        for(size_t i = 0; i < Shards; ++i)
+        {
+            shared_lock<rwlock> lock(shards_[i].lock);
+            count += shards_[i].map.size();
+        }
+        return count;
+    }
+
+    /**
+     * @brief calls f(v) with the value_type v of k, holding the shard's
+     * lock exclusively
+     * @details f may modify v.second. returns false, without calling f, if
+     * k is absent.
+     */
+    template<typename F> bool visit(const Key& k, F& f)
+    {
+        shard& s = get_shard(k);
+        scoped_lock<rwlock> lock(s.lock);
+        typename table::iterator itr(s.map.find(k));
+        if(itr != s.map.end())
+        {
+            f(*itr);
+            return true;
+        }
+        return false;
+    }
+
+    // calls f(v) with the value_type v of k, holding the shard's lock shared
+    template<typename F> bool visit(const Key& k, F& f) const
+    {
+        const shard& s = get_shard(k);
+        shared_lock<rwlock> lock(s.lock);
+        typename table::const_iterator itr(s.map.find(k));
+        if(itr != s.map.end())
+        {
+            f(*itr);
+            return true;
+        }
+        return false;
+    }
+
+    // calls f(v) on every item, locking each shard exclusively in turn
+    template<typename F> void visit_all(F& f)
+    {
+        for(size_t i = 0; i < Shards; ++i)
+        {
+            scoped_lock<rwlock> lock(shards_[i].lock);
+            typename table::iterator itr(shards_[i].map.begin());
+            typename table::iterator end(shards_[i].map.end());
+            while(itr != end)
+            {
+                f(*itr);
+                ++itr;
+            }
+        }
+    }
+
+    // calls f(v) on every item, locking each shard shared in turn
+    template<typename F> void visit_all(F& f) const
+    {
+        for(size_t i = 0; i < Shards; ++i)
+        {
+            shared_lock<rwlock> lock(shards_[i].lock);
+            typename table::const_iterator itr(shards_[i].map.begin());
+            typename table::const_iterator end(shards_[i].map.end());
+            while(itr != end)
+            {
+                f(*itr);
+                ++itr;
+            }
+        }
+    }
+
+#ifndef taapp_CONCURRENT_UNORDERED_MAP_INTERNAL_API
+private:
+#endif // taapp_CONCURRENT_UNORDERED_MAP_INTERNAL_API
+
+    enum
+    {
+        CACHE_LINE = 64
+    };
+
+    typedef int ShardsTest[((Shards & (Shards - 1)) == 0) * 2 - 1];
+
+    struct shard
+    {
+        // locked by const lookups
+        mutable rwlock lock;
+        table map;
+        // keeps the next shard off this shard's cache lines
+        char pad[CACHE_LINE];
+    };
+
+    shard shards_[Shards];
+    Hash hash_;
+
+    inline size_t shard_index(const Key& k) const
+    {
+        // mix the hash so that the shard does not pick the bucket as well
+        size_t h = hash_(k);
+        h ^= h >> 16;
+        h *= 0x45d9f3bu;
+        h ^= h >> 16;
+        return h & (Shards - 1);
+    }
+
+    inline shard& get_shard(const Key& k)
+    {
+        return shards_[shard_index(k)];
+    }
+
+    inline const shard& get_shard(const Key& k) const
+    {
+        return shards_[shard_index(k)];
+    }
+
+private:
+    // noncopyable
+    concurrent_unordered_map(const concurrent_unordered_map&);
+    concurrent_unordered_map& operator=(const concurrent_unordered_map&);
+};
+
+}
+
+#endif // taapp_CONCURRENT_UNORDERED_MAP_H_
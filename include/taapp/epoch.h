@@ -0,0 +1,236 @@
+/**
+ * @brief     epoch based memory reclamation for lock-free containers
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_EPOCH_H_
+#define taapp_EPOCH_H_
+
+#include "atomic.h"
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+namespace taapp
+{
+
+/**
+ * @brief tells writers when no reader can still hold an unlinked node
+ * @details A reader brackets its access to shared nodes with enter() and
+ * leave(), usually through an epoch::guard. Entering publishes the global
+ * epoch in the thread's record with a store and a fence; leaving clears it
+ * with a store. Neither performs an atomic read-modify-write, so readers on
+ * different cores do not bounce a shared cache line.
+ *
+ * A writer that unlinks a node notes current() and keeps the node until
+ * is_safe() reports that the epoch has moved on twice. try_advance() moves
+ * the epoch forward only once every thread inside a guard has observed the
+ * current one, so a reader that stalls inside a guard delays reclamation
+ * but never sees freed memory.
+ *
+ * Each thread gets a record on first use. Records are never freed; on
+ * POSIX systems a thread's record is released when it exits and reused by
+ * the next thread that needs one. On Windows records are not recycled.
+ */
+class epoch
+{
+public:
+
+    // holds the calling thread inside an epoch for the lifetime of the scope
+    class guard
+    {
+    public:
+
+        inline guard()
+        {
+            epoch::enter();
+        }
+
+        inline ~guard()
+        {
+            epoch::leave();
+        }
+
+    private:
+        // noncopyable
+        guard(const guard&);
+        guard& operator=(const guard&);
+    };
+
+    // marks the calling thread as reading shared nodes. may be nested
+    static inline void enter()
+    {
+        record* r = get();
+        if(r->depth++ == 0)
+        {
+            atomic_store_relaxed(&r->active, atomic_load(&global()));
+            // the announcement must be visible before any node is read
+            atomic_thread_fence();
+        }
+    }
+
+    static inline void leave()
+    {
+        record* r = current();
+        assert(r != NULL && r->depth > 0);
+        if(--r->depth == 0)
+        {
+            atomic_store(&r->active, static_cast<size_t>(0));
+        }
+    }
+
+    // the epoch to record with a node when it is unlinked
+    static inline size_t now()
+    {
+        return atomic_load(&global());
+    }
+
+    /**
+     * @brief advances the epoch if every thread in a guard has observed it
+     * @details returns the epoch after the attempt.
+     */
+    static size_t try_advance()
+    {
+        // unlinks made before this call must be visible to new readers
+        atomic_thread_fence();
+        size_t e = atomic_load(&global());
+        record* r = atomic_load(&records());
+        while(r != NULL)
+        {
+            size_t a = atomic_load(&r->active);
+            if(a != 0 && a != e)
+            {
+                return e;
+            }
+            r = r->next;
+        }
+        size_t expected = e;
+        if(atomic_compare_exchange(&global(), expected, e + 1))
+        {
+            return e + 1;
+        }
+        return expected;
+    }
+
+    // true if a node unlinked in epoch retired is unreachable in epoch e
+    static inline bool is_safe(size_t retired, size_t e)
+    {
+        return e - retired >= 2;
+    }
+
+#ifndef taapp_EPOCH_INTERNAL_API
+private:
+#endif // taapp_EPOCH_INTERNAL_API
+
+    enum
+    {
+        CACHE_LINE = 64
+    };
+
+    // one per thread, padded so that announcements do not share a line
+    struct record
+    {
+        volatile size_t active;
+        size_t depth;
+        volatile int inuse;
+        record* next;
+        char pad[CACHE_LINE];
+    };
+
+    static inline volatile size_t& global()
+    {
+        // starts at 1 so that an active value of 0 means outside a guard
+        static volatile size_t e = 1;
+        return e;
+    }
+
+    static inline record* volatile& records()
+    {
+        static record* volatile head = NULL;
+        return head;
+    }
+
+    static inline record*& current()
+    {
+        static taapp_THREAD_LOCAL record* r = NULL;
+        return r;
+    }
+
+    static inline record* get()
+    {
+        record* r = current();
+        return (r != NULL) ? r : attach();
+    }
+
+    // claims a released record, or adds a new one to the list
+    static record* attach()
+    {
+        record* r = atomic_load(&records());
+        while(r != NULL)
+        {
+            int expected = 0;
+            if(atomic_load_relaxed(&r->inuse) == 0 &&
+                atomic_compare_exchange(&r->inuse, expected, 1))
+            {
+                break;
+            }
+            r = r->next;
+        }
+        if(r == NULL)
+        {
+            r = static_cast<record*>(malloc(sizeof(record)));
+            assert(r != NULL);
+            memset(r, 0, sizeof(*r));
+            r->inuse = 1;
+            record* head = atomic_load_relaxed(&records());
+            do
+            {
+                r->next = head;
+            }
+            while(!atomic_compare_exchange(&records(), head, r));
+        }
+#if !defined(_WIN32)
+        pthread_setspecific(exit_key(), r);
+#endif
+        current() = r;
+        return r;
+    }
+
+#if !defined(_WIN32)
+    static void detach(void* p)
+    {
+        record* r = static_cast<record*>(p);
+        current() = NULL;
+        r->depth = 0;
+        atomic_store(&r->active, static_cast<size_t>(0));
+        atomic_store(&r->inuse, 0);
+    }
+
+    static void create_exit_key()
+    {
+        pthread_key_create(&exit_key_storage(), &epoch::detach);
+    }
+
+    static inline pthread_key_t& exit_key_storage()
+    {
+        static pthread_key_t key;
+        return key;
+    }
+
+    static inline pthread_key_t exit_key()
+    {
+        static pthread_once_t once = PTHREAD_ONCE_INIT;
+        pthread_once(&once, &epoch::create_exit_key);
+        return exit_key_storage();
+    }
+#endif
+};
+
+}
+
+#endif // taapp_EPOCH_H_
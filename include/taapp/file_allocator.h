@@ -0,0 +1,488 @@
+/**
+ * @brief     C++ allocator template backed by a memory mapped file
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_FILE_ALLOCATOR_H_
+#define taapp_FILE_ALLOCATOR_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace taapp
+{
+
+/**
+ * @brief heap inside a memory mapped file
+ * @details The arena maps a file of fixed capacity and serves allocations
+ * from it. Every link the arena keeps is stored as an offset, so the file
+ * may be mapped at any address, in any number of processes. A root object,
+ * usually a container built with file_allocator, is registered with
+ * set_root so it can be found again after the file is reopened.
+ *
+ * Blocks are rounded up to GRANULE bytes. Freed blocks of up to MAX_SMALL
+ * bytes go to exact size free lists, and larger ones to a first fit list
+ * that splits blocks but does not coalesce them. An arena opened read only
+ * can be shared by many processes, but it must not be allocated from and
+ * the objects in it must not be modified. The arena is not thread safe.
+ * Memory mapped files are only supported on POSIX systems; elsewhere create
+ * and open fail.
+ */
+class file_arena
+{
+public:
+
+    enum
+    {
+        GRANULE = 16,
+        SMALL_CLASSES = 64,
+        MAX_SMALL = GRANULE * SMALL_CLASSES
+    };
+
+    file_arena() : header_(NULL), writable_(false)
+    {
+    }
+
+    ~file_arena()
+    {
+        close();
+    }
+
+    /**
+     * @brief creates or truncates the file at path and maps it writable
+     * @details capacity is the size of the file in bytes, including the
+     * arena's header. returns false if the file cannot be created or mapped.
+     */
+    bool create(const char* path, size_t capacity)
+    {
+        close();
+        if(capacity < sizeof(header))
+        {
+            return false;
+        }
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0)
+        {
+            return false;
+        }
+        if(ftruncate(fd, static_cast<off_t>(capacity)) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(
+            NULL,
+            capacity,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED,
+            fd,
+            0);
+        ::close(fd);
+        if(p == MAP_FAILED)
+        {
+            return false;
+        }
+        header_ = static_cast<header*>(p);
+        memset(header_, 0, sizeof(header));
+        header_->magic = MAGIC;
+        header_->capacity = capacity;
+        header_->used = round_size(sizeof(header));
+        writable_ = true;
+        return true;
+#else
+        (void) path;
+        return false;
+#endif
+    }
+
+    /**
+     * @brief maps an existing arena file
+     * @details the mapping is shared, so changes made through a writable
+     * mapping are visible to every other process mapping the file. returns
+     * false if the file cannot be mapped or was not created by an arena.
+     */
+    bool open(const char* path, bool writable)
+    {
+        close();
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path, writable ? O_RDWR : O_RDONLY);
+        if(fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        if(fstat(fd, &st) != 0 ||
+            static_cast<size_t>(st.st_size) < sizeof(header))
+        {
+            ::close(fd);
+            return false;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        void* p = mmap(
+            NULL,
+            size,
+            writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+            MAP_SHARED,
+            fd,
+            0);
+        ::close(fd);
+        if(p == MAP_FAILED)
+        {
+            return false;
+        }
+        header_ = static_cast<header*>(p);
+        if(header_->magic != MAGIC || header_->capacity != size)
+        {
+            munmap(p, size);
+            header_ = NULL;
+            return false;
+        }
+        writable_ = writable;
+        return true;
+#else
+        (void) path;
+        (void) writable;
+        return false;
+#endif
+    }
+
+    // unmaps the file. objects in the arena are not destroyed
+    void close()
+    {
+        if(header_ != NULL)
+        {
+            if(current() == this)
+            {
+                set_current(NULL);
+            }
+#if defined(__unix__) || defined(__APPLE__)
+            munmap(header_, header_->capacity);
+#endif
+            header_ = NULL;
+            writable_ = false;
+        }
+    }
+
+    // allocates size bytes, or returns NULL if the arena is full
+    void* allocate(size_t size)
+    {
+        assert(writable_);
+        size = round_size(size);
+        size_t offset = 0;
+        if(size <= MAX_SMALL)
+        {
+            size_t& head = header_->small[size / GRANULE - 1];
+            offset = head;
+            if(offset != 0)
+            {
+                head = *static_cast<size_t*>(address(offset));
+            }
+        }
+        else
+        {
+            offset = take_large(size);
+        }
+        if(offset == 0 && header_->capacity - header_->used >= size)
+        {
+            offset = header_->used;
+            header_->used += size;
+        }
+        return (offset != 0) ? address(offset) : NULL;
+    }
+
+    // returns the size byte block p to the arena
+    void deallocate(void* p, size_t size)
+    {
+        assert(writable_);
+        if(p != NULL)
+        {
+            release(offset_of(p), round_size(size));
+        }
+    }
+
+    /**
+     * @brief allocates and default constructs a T in the arena
+     * @details returns NULL if the arena is full. the object is destroyed
+     * by calling its destructor and passing it to deallocate.
+     */
+    template<typename T> T* construct()
+    {
+        void* p = allocate(sizeof(holder<T>));
+        return (p != NULL) ? &(new(p) holder<T>())->t_ : NULL;
+    }
+
+    // the object registered with set_root, or NULL
+    void* root() const
+    {
+        return (header_->root != 0) ? address(header_->root) : NULL;
+    }
+
+    void set_root(void* p)
+    {
+        assert(writable_);
+        header_->root = (p != NULL) ? offset_of(p) : 0;
+    }
+
+    inline size_t capacity() const
+    {
+        return header_->capacity;
+    }
+
+    // bytes handed out from the end of the arena, including freed blocks
+    inline size_t used() const
+    {
+        return header_->used;
+    }
+
+    inline bool is_open() const
+    {
+        return header_ != NULL;
+    }
+
+    // the arena file_allocator allocates from
+    static inline file_arena* current()
+    {
+        return current_arena();
+    }
+
+    static inline void set_current(file_arena* arena)
+    {
+        current_arena() = arena;
+    }
+
+#ifndef taapp_FILE_ARENA_INTERNAL_API
+private:
+#endif // taapp_FILE_ARENA_INTERNAL_API
+
+    enum
+    {
+        MAGIC = 0x61706174 // "tapa"
+    };
+
+    // stored at the start of the file. all links are offsets from it
+    struct header
+    {
+        size_t magic;
+        size_t capacity;
+        size_t used;
+        size_t root;
+        size_t small[SMALL_CLASSES];
+        size_t large;
+    };
+
+    // free block on the large list
+    struct large_block
+    {
+        size_t next;
+        size_t size;
+    };
+
+    // define a custom placement new operator to remove dependency on
+    // the std <new> header
+    template<typename T> class holder
+    {
+    public:
+        T t_;
+
+        inline holder() : t_()
+        {
+        }
+
+        inline void* operator new (size_t size, void* ptr)
+        {
+            return ptr;
+        }
+
+        inline void operator delete (void *, void *)
+        {
+        }
+    };
+
+    header* header_;
+    bool writable_;
+
+    static inline file_arena*& current_arena()
+    {
+        static file_arena* arena = NULL;
+        return arena;
+    }
+
+    static inline size_t round_size(size_t size)
+    {
+        return (size > 0) ?
+            (size + GRANULE - 1) & ~static_cast<size_t>(GRANULE - 1) :
+            GRANULE;
+    }
+
+    inline void* address(size_t offset) const
+    {
+        return reinterpret_cast<char*>(header_) + offset;
+    }
+
+    inline size_t offset_of(void* p) const
+    {
+        return static_cast<size_t>(
+            static_cast<char*>(p) - reinterpret_cast<char*>(header_));
+    }
+
+    void release(size_t offset, size_t size)
+    {
+        if(size <= MAX_SMALL)
+        {
+            size_t& head = header_->small[size / GRANULE - 1];
+            *static_cast<size_t*>(address(offset)) = head;
+            head = offset;
+        }
+        else
+        {
+            large_block* b = static_cast<large_block*>(address(offset));
+            b->next = header_->large;
+            b->size = size;
+            header_->large = offset;
+        }
+    }
+
+    // removes the first large block of at least size bytes from the list,
+    // returning the remainder to the arena
+    size_t take_large(size_t size)
+    {
+        size_t* link = &header_->large;
+        while(*link != 0)
+        {
+            size_t offset = *link;
+            large_block* b = static_cast<large_block*>(address(offset));
+            if(b->size >= size)
+            {
+                size_t remainder = b->size - size;
+                *link = b->next;
+                if(remainder > 0)
+                {
+                    release(offset + size, remainder);
+                }
+                return offset;
+            }
+            link = &b->next;
+        }
+        return 0;
+    }
+
+private:
+    // noncopyable
+    file_arena(const file_arena&);
+    file_arena& operator=(const file_arena&);
+};
+
+/**
+ * @brief allocator for containers that live in a file_arena
+ * @details Allocates from file_arena::current(). The allocator holds no
+ * state, so a container built with it may itself be placed in the arena
+ * and used from any process that maps the file, provided that process sets
+ * the arena as current before modifying the container. Because the type
+ * declares relative_pointers, list, map, set and unordered_map link their
+ * nodes with relative_ptr. vector keeps plain pointers and must not be
+ * placed in an arena.
+ */
+template<typename T> class file_allocator
+{
+public:
+
+    // tells the containers to link their nodes with relative_ptr
+    typedef void relative_pointers;
+
+    template<typename U> struct rebind
+    {
+        typedef file_allocator<U> other;
+    };
+
+    inline file_allocator()
+    {
+    }
+
+    template<typename U> inline file_allocator(const file_allocator<U>&)
+    {
+    }
+
+    inline bool operator==(const file_allocator&) const
+    {
+        return true;
+    }
+
+    inline bool operator!=(const file_allocator&) const
+    {
+        return false;
+    }
+
+    // allocate but don't initialize num elements of type T
+    inline T* allocate (size_t n, const void* = 0)
+    {
+        assert(file_arena::current() != NULL);
+        return static_cast<T*>(file_arena::current()->allocate(sizeof(T)*n));
+    }
+
+    // resize storage p from oldn to n elements, preserving its contents
+    T* reallocate(void* p, size_t oldn, size_t n)
+    {
+        T* t = allocate(n);
+        if(t != NULL && p != NULL)
+        {
+            memcpy(t, p, sizeof(T) * ((oldn < n) ? oldn : n));
+            deallocate(static_cast<T*>(p), oldn);
+        }
+        return t;
+    }
+
+    // initialize elements of allocated storage p with value v
+    inline void construct (T* p, const T& v)
+    {
+        new(static_cast<void*>(p)) constructor(v);
+    }
+
+    // destroy but do not deallocate elements of initialized storage p
+    inline void destroy (T* p)
+    {
+        p->~T();
+    }
+
+    // deallocate storage p of deleted elements
+    inline void deallocate(T* p, size_t n)
+    {
+        file_arena::current()->deallocate(p, sizeof(T) * n);
+    }
+
+private:
+
+    // define a custom placement new operator to remove dependency on
+    // the std <new> header
+    class constructor
+    {
+    public:
+        T t_;
+
+        inline constructor(const T& t) : t_(t)
+        {
+        }
+
+        inline void* operator new (size_t size, void* ptr)
+        {
+            return ptr;
+        }
+
+        inline void operator delete (void *, void *)
+        {
+        }
+    };
+};
+
+}
+
+#endif // taapp_FILE_ALLOCATOR_H_
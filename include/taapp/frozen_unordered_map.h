@@ -0,0 +1,628 @@
+/**
+ * @brief     C++ immutable perfect hash map template implemenation
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_FROZEN_UNORDERED_MAP_H_
+#define taapp_FROZEN_UNORDERED_MAP_H_
+
+#include "allocator.h"
+#include "atomic.h"
+#include "compressed_pair.h"
+#include "hash.h"
+#include "pair.h"
+#include "thread.h"
+#include "unordered_map.h"
+#include <cassert>
+#include <cstddef>
+
+namespace taapp
+{
+
+/**
+ * @brief read only hash map indexed by a minimal perfect hash
+ * @details The map is built once from an unordered_map or a range of
+ * pairs, and stores its n values in one contiguous array of n slots, with
+ * no chains and no empty slots. A lookup hashes the key, reads one
+ * displacement and compares the key of the one slot it selects, so every
+ * lookup, hit or miss, touches a single value.
+ *
+ * The hash is built with compress, hash and displace (CHD): the keys are
+ * split into partitions of about PARTITION_KEYS keys, and the keys of
+ * each partition into buckets of about BUCKET_KEYS keys. Largest first,
+ * each bucket searches for the displacement that sends all of its keys to
+ * free slots of its partition. The partitions are independent, so they
+ * are built by several threads, and each one is small enough for its
+ * slots to stay in cache while it is searched. The index costs four bytes
+ * per bucket, about 1.3 bytes per key.
+ *
+ * Two keys are told apart by their Hash values alone while building, so
+ * build fails if distinct keys have equal hashes, as well as on duplicate
+ * keys. A failed build leaves the map unchanged.
+ */
+template<
+    typename Key,
+    typename T,
+    typename Hash = hash<Key>,
+    typename Pred = equal_to<Key>,
+    typename Alloc = allocator<pair<Key, T> > >
+class frozen_unordered_map
+{
+public:
+
+    typedef pair<Key, T> value_type;
+    typedef const value_type* const_iterator;
+
+    frozen_unordered_map() :
+        values_(NULL),
+        size_(0),
+        partitions_(NULL),
+        numpartitions_(0),
+        displacements_(NULL),
+        numbuckets_(0)
+    {
+    }
+
+    ~frozen_unordered_map()
+    {
+        clear();
+    }
+
+    // the values are stored in slot order, not in insertion order
+    inline const_iterator begin() const
+    {
+        return values_;
+    }
+
+    /**
+     * @brief builds the map from the pairs in [first, last)
+     * @details threads is the number of threads that search the
+     * partitions; 0 picks one per processor for large key sets. returns
+     * false if a key is duplicated or two keys have equal hashes.
+     */
+    bool build(
+        const value_type* first,
+        const value_type* last,
+        size_t threads = 0)
+    {
+        size_t n = static_cast<size_t>(last - first);
+        source_allocator salloc(value_alloc());
+        const value_type** sources = (n > 0) ? salloc.allocate(n) : NULL;
+        for(size_t i = 0; i < n; ++i)
+        {
+            sources[i] = first + i;
+        }
+        bool built = build_sources(sources, n, threads);
+        if(sources != NULL)
+        {
+            salloc.deallocate(sources, n);
+        }
+        return built;
+    }
+
+    // builds the map from the items of map. see the other overload
+    template<typename H, typename P, typename A, bool O>
+    bool build(
+        const unordered_map<Key, T, H, P, A, O>& map,
+        size_t threads = 0)
+    {
+        typedef typename unordered_map<Key, T, H, P, A, O>::const_iterator
+            map_iterator;
+        size_t n = map.size();
+        source_allocator salloc(value_alloc());
+        const value_type** sources = (n > 0) ? salloc.allocate(n) : NULL;
+        size_t i = 0;
+        map_iterator itr = map.begin();
+        map_iterator itrend = map.end();
+        while(itr != itrend)
+        {
+            sources[i] = &(*itr);
+            ++itr;
+            ++i;
+        }
+        bool built = build_sources(sources, n, threads);
+        if(sources != NULL)
+        {
+            salloc.deallocate(sources, n);
+        }
+        return built;
+    }
+
+    void clear()
+    {
+        for(size_t i = 0; i < size_; ++i)
+        {
+            values_[i].~value_type();
+        }
+        if(values_ != NULL)
+        {
+            value_alloc().deallocate(values_, size_);
+            partition_alloc().deallocate(partitions_, numpartitions_);
+            displacement_alloc().deallocate(displacements_, numbuckets_);
+        }
+        values_ = NULL;
+        size_ = 0;
+        partitions_ = NULL;
+        numpartitions_ = 0;
+        displacements_ = NULL;
+        numbuckets_ = 0;
+    }
+
+    inline bool contains(const Key& k) const
+    {
+        return find(k) != end();
+    }
+
+    inline bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    inline const_iterator end() const
+    {
+        return values_ + size_;
+    }
+
+    const_iterator find(const Key& k) const
+    {
+        if(size_ == 0)
+        {
+            return end();
+        }
+        unsigned long long g = mix(hasher()(k));
+        const partition& p = partitions_[range(g >> 32, numpartitions_)];
+        if(p.size == 0)
+        {
+            return end();
+        }
+        unsigned int d =
+            displacements_[p.firstbucket + range(g, p.numbuckets)];
+        const value_type* v = values_ + p.offset + slot(g, d, p.size);
+        return equals()(k, v->first) ? v : end();
+    }
+
+    inline size_t size() const
+    {
+        return size_;
+    }
+
+#ifndef taapp_FROZEN_UNORDERED_MAP_INTERNAL_API
+private:
+#endif // taapp_FROZEN_UNORDERED_MAP_INTERNAL_API
+
+    struct partition
+    {
+        // the index of the first slot and the number of slots
+        size_t offset;
+        size_t size;
+        // the index of the first displacement and the number of buckets
+        size_t firstbucket;
+        size_t numbuckets;
+    };
+
+    // a key being placed, and the index of its source
+    struct item
+    {
+        unsigned long long g;
+        size_t source;
+    };
+
+    // the scratch space and progress shared by the build threads
+    struct build_state
+    {
+        item* items;
+        item* sorted;
+        const partition* partitions;
+        size_t numpartitions;
+        unsigned int* displacements;
+        // one more bucket start per partition than it has buckets
+        size_t* bucketstarts;
+        size_t* order;
+        unsigned char* taken;
+        // the source of each slot
+        size_t* slots;
+        volatile size_t next;
+        volatile int failed;
+    };
+
+    typedef typename Alloc::template rebind<value_type>::other
+        value_allocator;
+    typedef typename Alloc::template rebind<partition>::other
+        partition_allocator;
+    typedef typename Alloc::template rebind<unsigned int>::other
+        displacement_allocator;
+    typedef typename Alloc::template rebind<const value_type*>::other
+        source_allocator;
+    typedef typename Alloc::template rebind<item>::other item_allocator;
+    typedef typename Alloc::template rebind<size_t>::other index_allocator;
+    typedef typename Alloc::template rebind<unsigned char>::other
+        byte_allocator;
+
+    enum
+    {
+        PARTITION_KEYS = 2048,
+        // larger buckets shrink the index, but every key more per bucket
+        // roughly doubles the displacements tried while building
+        BUCKET_KEYS = 3,
+        // a bucket with more keys than this means the hash is broken
+        MAX_BUCKET = 64,
+        // the smallest key set that is built with more than one thread
+        PARALLEL_KEYS = 1 << 16,
+        MAX_THREADS = 64
+    };
+
+    // displacements tried per bucket before the build gives up
+    static const unsigned int MAX_DISPLACEMENT = 1u << 24;
+
+    // define a custom placement new operator to remove dependency on
+    // the std <new> header
+    class constructor
+    {
+    public:
+        value_type t_;
+
+        inline constructor(const value_type& t) : t_(t)
+        {
+        }
+
+        inline void* operator new (size_t size, void* ptr)
+        {
+            return ptr;
+        }
+
+        inline void operator delete (void *, void *)
+        {
+        }
+    };
+
+    value_type* values_;
+    size_t size_;
+    partition* partitions_;
+    size_t numpartitions_;
+    unsigned int* displacements_;
+    size_t numbuckets_;
+    // the functors and allocators, which take no space when they are empty
+    struct functors :
+        compressed_member<Hash, 0>,
+        compressed_member<Pred, 1>,
+        compressed_member<value_allocator, 2>,
+        compressed_member<partition_allocator, 3>,
+        compressed_member<displacement_allocator, 4>
+    {
+        inline const Hash& hasher() const
+        {
+            return compressed_member<Hash, 0>::get();
+        }
+
+        inline const Pred& equals() const
+        {
+            return compressed_member<Pred, 1>::get();
+        }
+
+        inline value_allocator& value_alloc()
+        {
+            return compressed_member<value_allocator, 2>::get();
+        }
+
+        inline partition_allocator& partition_alloc()
+        {
+            return compressed_member<partition_allocator, 3>::get();
+        }
+
+        inline displacement_allocator& displacement_alloc()
+        {
+            return compressed_member<displacement_allocator, 4>::get();
+        }
+    };
+
+    functors functors_;
+
+    inline const Hash& hasher() const
+    {
+        return functors_.hasher();
+    }
+
+    inline const Pred& equals() const
+    {
+        return functors_.equals();
+    }
+
+    inline value_allocator& value_alloc()
+    {
+        return functors_.value_alloc();
+    }
+
+    inline partition_allocator& partition_alloc()
+    {
+        return functors_.partition_alloc();
+    }
+
+    inline displacement_allocator& displacement_alloc()
+    {
+        return functors_.displacement_alloc();
+    }
+
+    // remixes the hash, since user hashes often leave high bits unset
+    static inline unsigned long long mix(size_t h)
+    {
+        return hash_mix(static_cast<unsigned long long>(h));
+    }
+
+    // maps the low 32 bits of x onto [0, n) with a multiply, not a divide
+    static inline size_t range(unsigned long long x, size_t n)
+    {
+        return static_cast<size_t>(
+            ((x & 0xffffffffull) * static_cast<unsigned long long>(n)) >> 32);
+    }
+
+    // the slot within a partition of size slots for g displaced by d
+    static inline size_t slot(
+        unsigned long long g,
+        unsigned int d,
+        size_t size)
+    {
+        unsigned long long x = g ^ (d * 0x9e3779b97f4a7c15ull);
+        return range(hash_mix(x) >> 32, size);
+    }
+
+    bool build_sources(const value_type** sources, size_t n, size_t threads)
+    {
+        if(n == 0)
+        {
+            clear();
+            return true;
+        }
+        item_allocator ialloc(value_alloc());
+        index_allocator xalloc(value_alloc());
+        byte_allocator balloc(value_alloc());
+        size_t np = (n + PARTITION_KEYS - 1) / PARTITION_KEYS;
+        partition* partitions = partition_alloc().allocate(np);
+        item* items = ialloc.allocate(n);
+        item* sorted = ialloc.allocate(n);
+        size_t* counts = xalloc.allocate(np);
+        // sort the keys by partition
+        for(size_t i = 0; i < np; ++i)
+        {
+            counts[i] = 0;
+        }
+        for(size_t i = 0; i < n; ++i)
+        {
+            sorted[i].g = mix(hasher()(sources[i]->first));
+            sorted[i].source = i;
+            ++counts[range(sorted[i].g >> 32, np)];
+        }
+        size_t offset = 0;
+        size_t nb = 0;
+        for(size_t i = 0; i < np; ++i)
+        {
+            partition& p = partitions[i];
+            p.offset = offset;
+            p.size = counts[i];
+            p.firstbucket = nb;
+            p.numbuckets = (p.size + BUCKET_KEYS - 1) / BUCKET_KEYS;
+            p.numbuckets = (p.numbuckets > 0) ? p.numbuckets : 1;
+            counts[i] = offset;
+            offset += p.size;
+            nb += p.numbuckets;
+        }
+        for(size_t i = 0; i < n; ++i)
+        {
+            items[counts[range(sorted[i].g >> 32, np)]++] = sorted[i];
+        }
+        xalloc.deallocate(counts, np);
+        // the threads only read and write the scratch space allocated here,
+        // so the allocators are never called concurrently
+        unsigned int* displacements = displacement_alloc().allocate(nb);
+        build_state state;
+        state.items = items;
+        state.sorted = sorted;
+        state.partitions = partitions;
+        state.numpartitions = np;
+        state.displacements = displacements;
+        state.bucketstarts = xalloc.allocate(nb + np);
+        state.order = xalloc.allocate(nb);
+        state.taken = balloc.allocate(n);
+        state.slots = xalloc.allocate(n);
+        state.next = 0;
+        state.failed = 0;
+        if(threads == 0)
+        {
+            threads = (n >= PARALLEL_KEYS) ?
+                thread::hardware_concurrency() :
+                1;
+        }
+        threads = (threads < np) ? threads : np;
+        threads = (threads < MAX_THREADS) ? threads : MAX_THREADS;
+        // this thread is the first worker
+        thread workers[MAX_THREADS];
+        size_t started = 1;
+        while(started < threads && workers[started].start(&work, &state))
+        {
+            ++started;
+        }
+        work(&state);
+        for(size_t i = 1; i < started; ++i)
+        {
+            workers[i].join();
+        }
+        bool built = state.failed == 0;
+        if(built)
+        {
+            clear();
+            values_ = value_alloc().allocate(n);
+            for(size_t i = 0; i < n; ++i)
+            {
+                const value_type& v = *sources[state.slots[i]];
+                new(static_cast<void*>(values_ + i)) constructor(v);
+            }
+            size_ = n;
+            partitions_ = partitions;
+            numpartitions_ = np;
+            displacements_ = displacements;
+            numbuckets_ = nb;
+        }
+        else
+        {
+            partition_alloc().deallocate(partitions, np);
+            displacement_alloc().deallocate(displacements, nb);
+        }
+        xalloc.deallocate(state.slots, n);
+        balloc.deallocate(state.taken, n);
+        xalloc.deallocate(state.order, nb);
+        xalloc.deallocate(state.bucketstarts, nb + np);
+        ialloc.deallocate(sorted, n);
+        ialloc.deallocate(items, n);
+        return built;
+    }
+
+    // builds partitions until none are left or one of them fails
+    static void work(void* arg)
+    {
+        build_state& state = *static_cast<build_state*>(arg);
+        for(;;)
+        {
+            size_t p = atomic_fetch_add(&state.next, static_cast<size_t>(1));
+            if(p >= state.numpartitions || atomic_load(&state.failed) != 0)
+            {
+                break;
+            }
+            if(!build_partition(state, p))
+            {
+                atomic_store(&state.failed, 1);
+            }
+        }
+    }
+
+    // finds a displacement for every bucket of partition pi
+    static bool build_partition(build_state& state, size_t pi)
+    {
+        const partition& p = state.partitions[pi];
+        item* items = state.items + p.offset;
+        item* sorted = state.sorted + p.offset;
+        unsigned int* displacements = state.displacements + p.firstbucket;
+        size_t* starts = state.bucketstarts + p.firstbucket + pi;
+        size_t* order = state.order + p.firstbucket;
+        unsigned char* taken = state.taken + p.offset;
+        size_t* slots = state.slots + p.offset;
+        size_t nb = p.numbuckets;
+        // sort the keys by bucket
+        for(size_t b = 0; b <= nb; ++b)
+        {
+            starts[b] = 0;
+        }
+        for(size_t i = 0; i < p.size; ++i)
+        {
+            ++starts[range(items[i].g, nb) + 1];
+        }
+        // sort the buckets by size, largest first
+        size_t sizes[MAX_BUCKET + 2];
+        for(size_t s = 0; s < MAX_BUCKET + 2; ++s)
+        {
+            sizes[s] = 0;
+        }
+        for(size_t b = 0; b < nb; ++b)
+        {
+            size_t s = starts[b + 1];
+            if(s > MAX_BUCKET)
+            {
+                return false;
+            }
+            ++sizes[MAX_BUCKET - s + 1];
+        }
+        for(size_t s = 1; s < MAX_BUCKET + 2; ++s)
+        {
+            sizes[s] += sizes[s - 1];
+        }
+        for(size_t b = 0; b < nb; ++b)
+        {
+            order[sizes[MAX_BUCKET - starts[b + 1]]++] = b;
+        }
+        for(size_t b = 0; b < nb; ++b)
+        {
+            starts[b + 1] += starts[b];
+        }
+        for(size_t i = 0; i < p.size; ++i)
+        {
+            sorted[starts[range(items[i].g, nb)]++] = items[i];
+        }
+        // the bucket starts were advanced to the next bucket by the sort
+        for(size_t b = nb; b > 0; --b)
+        {
+            starts[b] = starts[b - 1];
+        }
+        starts[0] = 0;
+        for(size_t i = 0; i < p.size; ++i)
+        {
+            taken[i] = 0;
+        }
+        for(size_t i = 0; i < nb; ++i)
+        {
+            size_t b = order[i];
+            const item* first = sorted + starts[b];
+            size_t count = starts[b + 1] - starts[b];
+            displacements[b] = 0;
+            // two keys with equal hashes can never be separated
+            for(size_t j = 0; j < count; ++j)
+            {
+                for(size_t k = j + 1; k < count; ++k)
+                {
+                    if(first[j].g == first[k].g)
+                    {
+                        return false;
+                    }
+                }
+            }
+            unsigned int d = 0;
+            while(count > 0 && !try_place(first, count, d, p.size, taken))
+            {
+                if(++d == MAX_DISPLACEMENT)
+                {
+                    return false;
+                }
+            }
+            displacements[b] = d;
+            for(size_t j = 0; j < count; ++j)
+            {
+                slots[slot(first[j].g, d, p.size)] = first[j].source;
+            }
+        }
+        return true;
+    }
+
+    // takes the slots of the count keys at first displaced by d, if they
+    // are all free
+    static bool try_place(
+        const item* first,
+        size_t count,
+        unsigned int d,
+        size_t size,
+        unsigned char* taken)
+    {
+        for(size_t j = 0; j < count; ++j)
+        {
+            size_t s = slot(first[j].g, d, size);
+            if(taken[s] != 0)
+            {
+                // release the slots taken so far
+                while(j > 0)
+                {
+                    --j;
+                    taken[slot(first[j].g, d, size)] = 0;
+                }
+                return false;
+            }
+            taken[s] = 1;
+        }
+        return true;
+    }
+
+private:
+    // noncopyable
+    frozen_unordered_map(const frozen_unordered_map&);
+    frozen_unordered_map& operator=(const frozen_unordered_map&);
+};
+
+}
+
+#endif // taapp_FROZEN_UNORDERED_MAP_H_
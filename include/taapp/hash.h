@@ -0,0 +1,502 @@
+/**
+ * @brief     hash functions for the hash map containers
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_HASH_H_
+#define taapp_HASH_H_
+
+#include "pair.h"
+#include <cstddef>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define taapp_HASH_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define taapp_HASH_SSE2
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64) && !defined(__SIZEOF_INT128__)
+#include <intrin.h>
+#endif
+
+namespace taapp
+{
+
+/**
+ * @brief hashes byte ranges
+ * @details Keys of up to 256 bytes are hashed as wyhash does: 16 or 48 byte
+ * chunks are folded into the state with a 64 by 64 to 128 bit multiply.
+ * Longer keys are read in 64 byte stripes into eight independent 64 bit
+ * accumulators, as xxh3 does, which vectorizes with SSE2 or AVX2 when the
+ * compiler targets them. Every path yields the same hash for the same
+ * bytes. Words are read in the machine's byte order, so hashes differ
+ * between little and big endian machines and should not be stored.
+ */
+class byte_hash
+{
+public:
+
+    inline byte_hash() : seed_(0)
+    {
+    }
+
+    inline explicit byte_hash(unsigned long long seed) : seed_(seed)
+    {
+    }
+
+    inline size_t operator()(const void* p, size_t len) const
+    {
+        return static_cast<size_t>(hash(p, len, seed_));
+    }
+
+    static unsigned long long hash(
+        const void* key,
+        size_t len,
+        unsigned long long seed)
+    {
+        const unsigned char* p = static_cast<const unsigned char*>(key);
+        seed ^= mix(seed ^ P0, P1);
+        if(len > LONG_KEY)
+        {
+            return hash_long(p, len, seed);
+        }
+        unsigned long long a;
+        unsigned long long b;
+        if(len <= 16)
+        {
+            if(len >= 4)
+            {
+                // two pairs of possibly overlapping words cover every byte
+                size_t q = (len >> 3) << 2;
+                a = (read4(p) << 32) | read4(p + q);
+                b = (read4(p + len - 4) << 32) | read4(p + len - 4 - q);
+            }
+            else if(len > 0)
+            {
+                a = (static_cast<unsigned long long>(p[0]) << 16) |
+                    (static_cast<unsigned long long>(p[len >> 1]) << 8) |
+                    p[len - 1];
+                b = 0;
+            }
+            else
+            {
+                a = 0;
+                b = 0;
+            }
+        }
+        else
+        {
+            size_t i = len;
+            if(i > 48)
+            {
+                unsigned long long see1 = seed;
+                unsigned long long see2 = seed;
+                do
+                {
+                    seed = mix(read8(p) ^ P1, read8(p + 8) ^ seed);
+                    see1 = mix(read8(p + 16) ^ P2, read8(p + 24) ^ see1);
+                    see2 = mix(read8(p + 32) ^ P3, read8(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                }
+                while(i > 48);
+                seed ^= see1 ^ see2;
+            }
+            while(i > 16)
+            {
+                seed = mix(read8(p) ^ P1, read8(p + 8) ^ seed);
+                p += 16;
+                i -= 16;
+            }
+            a = read8(p + i - 16);
+            b = read8(p + i - 8);
+        }
+        a ^= P1;
+        b ^= seed;
+        mum(a, b);
+        return mix(a ^ P0 ^ len, b ^ P1);
+    }
+
+#ifndef taapp_HASH_INTERNAL_API
+private:
+#endif // taapp_HASH_INTERNAL_API
+
+    enum
+    {
+        // keys longer than this are hashed in stripes
+        LONG_KEY = 256,
+        STRIPE = 64,
+        LANES = 8,
+        // stripes between scrambles of the accumulators
+        BLOCK = 8,
+        KEY_LANES = 16
+    };
+
+    static const unsigned long long P0 = 0xa0761d6478bd642full;
+    static const unsigned long long P1 = 0xe7037ed1a0b428dbull;
+    static const unsigned long long P2 = 0x8ebc6af09c88c6dbull;
+    static const unsigned long long P3 = 0x589965cc75374cc3ull;
+    static const unsigned long long SCRAMBLE = 0x9e3779b1ull;
+
+    unsigned long long seed_;
+
+    static inline unsigned long long read8(const unsigned char* p)
+    {
+        unsigned long long v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline unsigned long long read4(const unsigned char* p)
+    {
+        unsigned int v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    // replaces a and b with the low and high words of a * b
+    static inline void mum(unsigned long long& a, unsigned long long& b)
+    {
+#if defined(__SIZEOF_INT128__)
+        __uint128_t r = a;
+        r *= b;
+        a = static_cast<unsigned long long>(r);
+        b = static_cast<unsigned long long>(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        a = _umul128(a, b, &b);
+#else
+        unsigned long long ha = a >> 32;
+        unsigned long long hb = b >> 32;
+        unsigned long long la = static_cast<unsigned int>(a);
+        unsigned long long lb = static_cast<unsigned int>(b);
+        unsigned long long rh = ha * hb;
+        unsigned long long rm0 = ha * lb;
+        unsigned long long rm1 = hb * la;
+        unsigned long long rl = la * lb;
+        unsigned long long t = rl + (rm0 << 32);
+        unsigned long long c = t < rl;
+        unsigned long long lo = t + (rm1 << 32);
+        c += lo < t;
+        a = lo;
+        b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+    }
+
+    static inline unsigned long long mix(
+        unsigned long long a,
+        unsigned long long b)
+    {
+        mum(a, b);
+        return a ^ b;
+    }
+
+    // folds stripes [0, n) of p into acc, scrambling after every block
+    static inline void accumulate_scalar(
+        unsigned long long* acc,
+        const unsigned char* p,
+        size_t n,
+        const unsigned long long* key)
+    {
+        for(size_t s = 0; s < n; ++s)
+        {
+            const unsigned long long* k = key + (s % BLOCK);
+            for(size_t i = 0; i < LANES; ++i)
+            {
+                unsigned long long d = read8(p + i * 8);
+                unsigned long long dk = d ^ k[i];
+                acc[i ^ 1] += d;
+                acc[i] += (dk & 0xffffffffull) * (dk >> 32);
+            }
+            p += STRIPE;
+            if(s % BLOCK == BLOCK - 1)
+            {
+                for(size_t i = 0; i < LANES; ++i)
+                {
+                    unsigned long long a = acc[i];
+                    a ^= a >> 47;
+                    a ^= key[BLOCK + i];
+                    acc[i] = a * SCRAMBLE;
+                }
+            }
+        }
+    }
+
+#if defined(taapp_HASH_SSE2)
+    static inline void accumulate_simd(
+        unsigned long long* acc,
+        const unsigned char* p,
+        size_t n,
+        const unsigned long long* key)
+    {
+        __m128i a[LANES / 2];
+        for(size_t i = 0; i < LANES / 2; ++i)
+        {
+            a[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc) + i);
+        }
+        const __m128i prime = _mm_set1_epi32(static_cast<int>(SCRAMBLE));
+        for(size_t s = 0; s < n; ++s)
+        {
+            const __m128i* k =
+                reinterpret_cast<const __m128i*>(key + (s % BLOCK));
+            const __m128i* d = reinterpret_cast<const __m128i*>(p);
+            for(size_t i = 0; i < LANES / 2; ++i)
+            {
+                __m128i dv = _mm_loadu_si128(d + i);
+                __m128i dk = _mm_xor_si128(dv, _mm_loadu_si128(k + i));
+                __m128i hi = _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1));
+                __m128i product = _mm_mul_epu32(dk, hi);
+                // each lane adds the data of its neighbour
+                __m128i swapped =
+                    _mm_shuffle_epi32(dv, _MM_SHUFFLE(1, 0, 3, 2));
+                a[i] = _mm_add_epi64(a[i], _mm_add_epi64(product, swapped));
+            }
+            p += STRIPE;
+            if(s % BLOCK == BLOCK - 1)
+            {
+                const __m128i* sk =
+                    reinterpret_cast<const __m128i*>(key + BLOCK);
+                for(size_t i = 0; i < LANES / 2; ++i)
+                {
+                    __m128i v = _mm_xor_si128(a[i], _mm_srli_epi64(a[i], 47));
+                    v = _mm_xor_si128(v, _mm_loadu_si128(sk + i));
+                    // 64 bit multiply by a 32 bit constant
+                    __m128i lo = _mm_mul_epu32(v, prime);
+                    __m128i hi = _mm_mul_epu32(_mm_srli_epi64(v, 32), prime);
+                    a[i] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+                }
+            }
+        }
+        for(size_t i = 0; i < LANES / 2; ++i)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(acc) + i, a[i]);
+        }
+    }
+#elif defined(taapp_HASH_AVX2)
+    static inline void accumulate_simd(
+        unsigned long long* acc,
+        const unsigned char* p,
+        size_t n,
+        const unsigned long long* key)
+    {
+        __m256i a[LANES / 4];
+        for(size_t i = 0; i < LANES / 4; ++i)
+        {
+            a[i] = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(acc) + i);
+        }
+        const __m256i prime = _mm256_set1_epi32(static_cast<int>(SCRAMBLE));
+        for(size_t s = 0; s < n; ++s)
+        {
+            const __m256i* k =
+                reinterpret_cast<const __m256i*>(key + (s % BLOCK));
+            const __m256i* d = reinterpret_cast<const __m256i*>(p);
+            for(size_t i = 0; i < LANES / 4; ++i)
+            {
+                __m256i dv = _mm256_loadu_si256(d + i);
+                __m256i dk =
+                    _mm256_xor_si256(dv, _mm256_loadu_si256(k + i));
+                __m256i hi =
+                    _mm256_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1));
+                __m256i product = _mm256_mul_epu32(dk, hi);
+                // each lane adds the data of its neighbour
+                __m256i swapped =
+                    _mm256_shuffle_epi32(dv, _MM_SHUFFLE(1, 0, 3, 2));
+                a[i] = _mm256_add_epi64(
+                    a[i],
+                    _mm256_add_epi64(product, swapped));
+            }
+            p += STRIPE;
+            if(s % BLOCK == BLOCK - 1)
+            {
+                const __m256i* sk =
+                    reinterpret_cast<const __m256i*>(key + BLOCK);
+                for(size_t i = 0; i < LANES / 4; ++i)
+                {
+                    __m256i v =
+                        _mm256_xor_si256(a[i], _mm256_srli_epi64(a[i], 47));
+                    v = _mm256_xor_si256(v, _mm256_loadu_si256(sk + i));
+                    // 64 bit multiply by a 32 bit constant
+                    __m256i lo = _mm256_mul_epu32(v, prime);
+                    __m256i hi =
+                        _mm256_mul_epu32(_mm256_srli_epi64(v, 32), prime);
+                    a[i] = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+                }
+            }
+        }
+        for(size_t i = 0; i < LANES / 4; ++i)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc) + i, a[i]);
+        }
+    }
+#else
+    static inline void accumulate_simd(
+        unsigned long long* acc,
+        const unsigned char* p,
+        size_t n,
+        const unsigned long long* key)
+    {
+        accumulate_scalar(acc, p, n, key);
+    }
+#endif
+
+    // the lanes xored with the data, offset by the mixed seed
+    static inline void make_key(unsigned long long* key, unsigned long long s)
+    {
+        for(size_t i = 0; i < KEY_LANES; ++i)
+        {
+            key[i] = (P1 * (2 * i + 1)) + s;
+        }
+    }
+
+    static unsigned long long hash_long(
+        const unsigned char* p,
+        size_t len,
+        unsigned long long seed)
+    {
+        unsigned long long key[KEY_LANES];
+        make_key(key, seed);
+        unsigned long long acc[LANES] = { P0, P1, P2, P3, P0, P1, P2, P3 };
+        // the last 1 to 64 bytes go into a final, possibly overlapping,
+        // stripe
+        size_t n = (len - 1) / STRIPE;
+        accumulate_simd(acc, p, n, key);
+        accumulate_simd(acc, p + len - STRIPE, 1, key + 1);
+        unsigned long long h = len * P0;
+        for(size_t i = 0; i < LANES; i += 2)
+        {
+            h += mix(acc[i] ^ key[i], acc[i + 1] ^ key[i + 1]);
+        }
+        return mix(h ^ P2, seed ^ P3);
+    }
+};
+
+/**
+ * @brief mixes every bit of x into every bit of the result
+ * @details the splitmix64 finalizer. it is a bijection, so distinct
+ * integers never collide before the bucket index is taken.
+ */
+inline unsigned long long hash_mix(unsigned long long x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+// hashes len bytes at p
+inline size_t hash_bytes(const void* p, size_t len)
+{
+    return static_cast<size_t>(byte_hash::hash(p, len, 0));
+}
+
+// merges the hash h of a key's next member into the hash seed of the rest
+inline size_t hash_combine(size_t seed, size_t h)
+{
+    return static_cast<size_t>(hash_mix(
+        (static_cast<unsigned long long>(seed) * 0x9e3779b97f4a7c15ull) ^ h));
+}
+
+/**
+ * @brief the default hash functor of the hash maps
+ * @details defined for the integer, floating point and pointer types, and
+ * for pairs of those. other keys must supply their own functor.
+ */
+template<typename T> struct hash;
+
+#define taapp_HASH_INTEGER(T) \
+    template<> struct hash<T> \
+    { \
+        inline size_t operator()(T v) const \
+        { \
+            return static_cast<size_t>( \
+                hash_mix(static_cast<unsigned long long>(v))); \
+        } \
+    };
+
+taapp_HASH_INTEGER(bool)
+taapp_HASH_INTEGER(char)
+taapp_HASH_INTEGER(signed char)
+taapp_HASH_INTEGER(unsigned char)
+taapp_HASH_INTEGER(wchar_t)
+taapp_HASH_INTEGER(short)
+taapp_HASH_INTEGER(unsigned short)
+taapp_HASH_INTEGER(int)
+taapp_HASH_INTEGER(unsigned int)
+taapp_HASH_INTEGER(long)
+taapp_HASH_INTEGER(unsigned long)
+taapp_HASH_INTEGER(long long)
+taapp_HASH_INTEGER(unsigned long long)
+
+#undef taapp_HASH_INTEGER
+
+template<> struct hash<float>
+{
+    inline size_t operator()(float v) const
+    {
+        // 0.0 and -0.0 compare equal, so they must hash alike
+        return (v == 0.0f) ? 0 : hash_bytes(&v, sizeof(v));
+    }
+};
+
+template<> struct hash<double>
+{
+    inline size_t operator()(double v) const
+    {
+        return (v == 0.0) ? 0 : hash_bytes(&v, sizeof(v));
+    }
+};
+
+template<typename T> struct hash<T*>
+{
+    inline size_t operator()(const T* p) const
+    {
+        return static_cast<size_t>(hash_mix(
+            static_cast<unsigned long long>(reinterpret_cast<size_t>(p))));
+    }
+};
+
+template<typename T, typename U> struct hash<pair<T, U> >
+{
+    inline size_t operator()(const pair<T, U>& v) const
+    {
+        return hash_combine(hash<T>()(v.first), hash<U>()(v.second));
+    }
+};
+
+// hashes the characters of a nul terminated string
+struct string_hash
+{
+    inline size_t operator()(const char* s) const
+    {
+        return hash_bytes(s, strlen(s));
+    }
+};
+
+// the default key comparison functor of the hash maps
+template<typename T> struct equal_to
+{
+    inline bool operator()(const T& a, const T& b) const
+    {
+        return a == b;
+    }
+};
+
+// compares the characters of nul terminated strings
+struct string_equal
+{
+    inline bool operator()(const char* a, const char* b) const
+    {
+        return strcmp(a, b) == 0;
+    }
+};
+
+}
+
+#endif // taapp_HASH_H_
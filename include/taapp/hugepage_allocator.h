@@ -0,0 +1,316 @@
+/**
+ * @brief     C++ allocator template backed by transparent huge pages
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_HUGEPAGE_ALLOCATOR_H_
+#define taapp_HUGEPAGE_ALLOCATOR_H_
+
+#include "allocator_traits.h"
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace taapp
+{
+
+/**
+ * @brief allocator that places large buffers on transparent huge pages
+ * @details Requests of at least Threshold bytes are served from anonymous
+ * mappings that are aligned to and sized in multiples of 2 MB, and the
+ * kernel is advised with MADV_HUGEPAGE to back them with huge pages. A
+ * random access pattern over a large vector or hash table bucket array then
+ * needs one TLB entry per 2 MB instead of one per 4 KB. Smaller requests go
+ * to malloc. On platforms other than Linux every request goes to malloc.
+ */
+template<typename T, size_t Threshold = 2097152> class hugepage_allocator
+{
+public:
+
+    enum
+    {
+        HUGEPAGE_SIZE = 2097152
+    };
+
+    template<typename U> struct rebind
+    {
+        typedef hugepage_allocator<U, Threshold> other;
+    };
+
+    inline hugepage_allocator()
+#ifndef NDEBUG
+        : counter_(0)
+#endif
+    {
+    }
+
+#ifndef NDEBUG
+    inline hugepage_allocator(const hugepage_allocator&) : counter_(0)
+    {
+    }
+#endif
+
+    template<typename U>
+    inline hugepage_allocator(const hugepage_allocator<U, Threshold>&)
+#ifndef NDEBUG
+        : counter_(0)
+#endif
+    {
+    }
+
+#ifndef NDEBUG
+    ~hugepage_allocator()
+    {
+        assert(counter_ == 0);
+    }
+#endif
+
+    inline bool operator==(const hugepage_allocator&) const
+    {
+        return true;
+    }
+
+    inline bool operator!=(const hugepage_allocator&) const
+    {
+        return false;
+    }
+
+    // exchanges the state of two instances, so that each keeps counting
+    // the blocks it handed out
+    inline void swap(hugepage_allocator& other)
+    {
+#ifndef NDEBUG
+        int counter = counter_;
+        counter_ = other.counter_;
+        other.counter_ = counter;
+#endif
+    }
+
+    // allocate but don't initialize num elements of type T
+    inline T* allocate (size_t n, const void* = 0)
+    {
+        size_t size = sizeof(T) * n;
+        T* t = static_cast<T*>(is_mapped(size) ? map(size) : malloc(size));
+#ifndef NDEBUG
+        ++counter_;
+#endif
+        return t;
+    }
+
+    // resize storage p from oldn to n elements, preserving its contents
+    T* reallocate(void* p, size_t oldn, size_t n)
+    {
+        size_t oldsize = sizeof(T) * oldn;
+        size_t size = sizeof(T) * n;
+        void* t;
+        if(p == NULL)
+        {
+            t = is_mapped(size) ? map(size) : malloc(size);
+#ifndef NDEBUG
+            ++counter_;
+#endif
+        }
+        else if(!is_mapped(oldsize) && !is_mapped(size))
+        {
+            t = realloc(p, size);
+        }
+        else if(is_mapped(oldsize) &&
+                is_mapped(size) &&
+                remap(p, oldsize, size))
+        {
+            // resized in place, so the alignment is preserved
+            t = p;
+        }
+        else
+        {
+            t = is_mapped(size) ? map(size) : malloc(size);
+            if(t != NULL)
+            {
+                memcpy(t, p, (oldsize < size) ? oldsize : size);
+                release(p, oldsize);
+            }
+        }
+        return static_cast<T*>(t);
+    }
+
+    // number of elements that fit in storage p allocated for n elements
+    inline size_t usable_size(T* p, size_t n)
+    {
+        size_t size = sizeof(T) * n;
+        if(is_mapped(size))
+        {
+            // the rest of the last page is part of the mapping
+            size = round_size(size);
+        }
+        else
+        {
+            // the heap block must not grow into the mapped range, since the
+            // size passed to deallocate decides how it is released
+            size = heap_usable_size(p, size);
+            if(is_mapped(size))
+            {
+                size = Threshold - 1;
+            }
+        }
+        return size / sizeof(T);
+    }
+
+    // initialize elements of allocated storage p with value v
+    inline void construct (T* p, const T& v)
+    {
+        new(static_cast<void*>(p)) constructor(v);
+    }
+
+    // destroy but do not deallocate elements of initialized storage p
+    inline void destroy (T* p)
+    {
+        p->~T();
+    }
+
+    // deallocate storage p of deleted elements
+    inline void deallocate(T* p, size_t n)
+    {
+#ifndef NDEBUG
+        --counter_;
+#endif
+        release(p, sizeof(T) * n);
+    }
+
+private:
+
+#ifndef NDEBUG
+    int counter_;
+#endif
+
+    // define a custom placement new operator to remove dependency on
+    // the std <new> header
+    class constructor
+    {
+    public:
+        T t_;
+
+        inline constructor(const T& t) : t_(t)
+        {
+        }
+
+        inline void* operator new (size_t size, void* ptr)
+        {
+            return ptr;
+        }
+
+        inline void operator delete (void *, void *)
+        {
+        }
+    };
+
+    static inline size_t round_size(size_t size)
+    {
+        const size_t mask = HUGEPAGE_SIZE - 1;
+        return (size + mask) & ~mask;
+    }
+
+#if defined(__linux__)
+    static inline bool is_mapped(size_t size)
+    {
+        return size >= Threshold;
+    }
+
+    static void* map(size_t size)
+    {
+        size = round_size(size);
+        // over allocate by one huge page so an aligned region can be carved
+        // out, then unmap the unaligned head and the unused tail
+        size_t mapsize = size + HUGEPAGE_SIZE;
+        char* p = static_cast<char*>(mmap(
+            NULL,
+            mapsize,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1,
+            0));
+        if(p == MAP_FAILED)
+        {
+            return NULL;
+        }
+        char* aligned = reinterpret_cast<char*>(round_size(
+            reinterpret_cast<size_t>(p)));
+        size_t head = static_cast<size_t>(aligned - p);
+        if(head > 0)
+        {
+            munmap(p, head);
+        }
+        munmap(aligned + size, mapsize - head - size);
+#ifdef MADV_HUGEPAGE
+        madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+        return aligned;
+    }
+
+    // attempts to resize a mapping without moving it
+    static bool remap(void* p, size_t oldsize, size_t size)
+    {
+        oldsize = round_size(oldsize);
+        size = round_size(size);
+        if(size <= oldsize)
+        {
+            if(size < oldsize)
+            {
+                munmap(static_cast<char*>(p) + size, oldsize - size);
+            }
+            return true;
+        }
+        // mremap without MREMAP_MAYMOVE only succeeds if the pages after the
+        // mapping are free, which keeps the region aligned
+        void* t = mremap(p, oldsize, size, 0);
+        if(t == MAP_FAILED)
+        {
+            return false;
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(p, size, MADV_HUGEPAGE);
+#endif
+        return true;
+    }
+
+    static void release(void* p, size_t size)
+    {
+        if(is_mapped(size))
+        {
+            munmap(p, round_size(size));
+        }
+        else
+        {
+            free(p);
+        }
+    }
+#else
+    static inline bool is_mapped(size_t)
+    {
+        return false;
+    }
+
+    static inline void* map(size_t size)
+    {
+        return malloc(size);
+    }
+
+    static inline bool remap(void*, size_t, size_t)
+    {
+        return false;
+    }
+
+    static inline void release(void* p, size_t)
+    {
+        free(p);
+    }
+#endif
+};
+
+}
+
+#endif // taapp_HUGEPAGE_ALLOCATOR_H_
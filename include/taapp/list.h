@@ -7,6 +7,8 @@
 #ifndef taapp_LIST_H_
 #define taapp_LIST_H_
 
+#include "allocator_traits.h"
+#include "compressed_pair.h"
 #include <cstddef>
 #include <cassert>
 
@@ -62,13 +64,13 @@ public:
 
         inline iterator& operator--()
         {
-            node_ = node_->node.tprev;
+            node_ = node_->node.tprev();
             return *this;
         }
 
         inline iterator& operator++()
         {
-            node_ = node_->node.tnext;
+            node_ = node_->node.tnext();
             return *this;
         }
 
@@ -148,13 +150,13 @@ public:
 
         inline const_iterator& operator--()
         {
-            node_ = node_->node.tprev;
+            node_ = node_->node.tprev();
             return *this;
         }
 
         inline const_iterator& operator++()
         {
-            node_ = node_->node.tnext;
+            node_ = node_->node.tnext();
             return *this;
         }
 
@@ -180,8 +182,15 @@ public:
 
     list()
     {
-        anchor_.aprev = &anchor_;
-        anchor_.anext = &anchor_;
+        anchor().aprev = &anchor();
+        anchor().anext = &anchor();
+    }
+
+    // constructs an empty list whose nodes come from a copy of a
+    explicit list(const Allocator& a) : anchor_(anode(), allocator_type(a))
+    {
+        anchor().aprev = &anchor();
+        anchor().anext = &anchor();
     }
 
     ~list()
@@ -191,49 +200,65 @@ public:
 
     inline const T& back() const
     {
-        return anchor_.tprev->value;
+        return anchor().tprev()->value;
     }
 
     inline T& back()
     {
-        return anchor_.tprev->value;
+        return anchor().tprev()->value;
     }
 
     inline const_iterator begin() const
     {
-        return const_iterator(anchor_.tnext);
+        return const_iterator(anchor().tnext());
     }
 
     inline iterator begin()
     {
-        return iterator(anchor_.tnext);
+        return iterator(anchor().tnext());
     }
 
-    inline void clear()
+    void clear()
     {
-        tnode* n = anchor_.tnext;
-        while(static_cast<void*>(n) != static_cast<void*>(&anchor_))
+        if(traits::HAS_RELEASE_ALL && TRIVIAL_DESTRUCTOR)
+        {
+            // the allocator frees every node without walking the list
+            traits::release_all(alloc());
+        }
+        else
         {
-            tnode* next = n->node.tnext;
-            n->value.~T();
-            allocator_.deallocate(n, 1);
-            n = next;
+            tnode* chain = NULL;
+            size_t count = 0;
+            tnode* n = anchor().tnext();
+            while(static_cast<void*>(n) != static_cast<void*>(&anchor()))
+            {
+                tnode* next = n->node.tnext();
+                n->value.~T();
+                traits::set_chain_next(n, chain);
+                chain = n;
+                ++count;
+                n = next;
+            }
+            // return all of the nodes to the allocator at once
+            traits::deallocate_chain(alloc(), chain, count);
         }
+        anchor().aprev = &anchor();
+        anchor().anext = &anchor();
     }
 
     inline bool empty() const
     {
-        return anchor_.anext == &anchor_;
+        return anchor().anext == &anchor();
     }
 
     inline const_iterator end() const
     {
-        return const_iterator(reinterpret_cast<const tnode*>(&anchor_));
+        return const_iterator(reinterpret_cast<const tnode*>(&anchor()));
     }
 
     inline iterator end()
     {
-        return iterator(reinterpret_cast<tnode*>(&anchor_));
+        return iterator(reinterpret_cast<tnode*>(&anchor()));
     }
 
     inline iterator erase(iterator pos)
@@ -243,18 +268,24 @@ public:
         n->node.aprev->anext = n->node.anext;
         n->node.anext->aprev = n->node.aprev;
         n->value.~T();
-        allocator_.deallocate(n, 1);
+        alloc().deallocate(n, 1);
         return pos;
     }
 
     inline const T& front() const
     {
-        return anchor_.tnext->value;
+        return anchor().tnext()->value;
     }
 
     inline T& front()
     {
-        return anchor_.tnext->value;
+        return anchor().tnext()->value;
+    }
+
+    // a copy of the allocator the list was constructed with
+    inline Allocator get_allocator() const
+    {
+        return Allocator(anchor_.second());
     }
 
     /**
@@ -264,7 +295,7 @@ public:
      */
     iterator insert(iterator pos, const T& t)
     {
-        tnode* n = allocator_.allocate(1);
+        tnode* n = alloc().allocate(1);
         tnode* p = pos.node_;
         new(static_cast<void*>(&n->value)) constructor(t);
         n->node.aprev = p->node.aprev;
@@ -274,78 +305,154 @@ public:
         return iterator(n);
     }
 
+    /**
+     * @brief inserts copies of the items in [first, last) before pos.
+     * @details returns an iterator to the first inserted item, or pos if the
+     * range is empty. the nodes for the whole range are allocated in one
+     * call if the allocator supports allocate_bulk. if that returns fewer
+     * nodes than the range holds, the rest are allocated one at a time.
+     */
+    iterator insert(iterator pos, const T* first, const T* last)
+    {
+        tnode* p = pos.node_;
+        anode* head = p->node.aprev;
+        anode* prev = head;
+        tnode* chain = traits::allocate_chain(
+            alloc(),
+            static_cast<size_t>(last - first));
+        while(first != last)
+        {
+            tnode* n = chain;
+            if(n != NULL)
+            {
+                chain = traits::chain_next(chain);
+            }
+            else
+            {
+                n = alloc().allocate(1);
+            }
+            new(static_cast<void*>(&n->value)) constructor(*first);
+            n->node.aprev = prev;
+            prev->anext = &n->node;
+            prev = &n->node;
+            ++first;
+        }
+        prev->anext = &p->node;
+        p->node.aprev = prev;
+        return iterator(head->tnext());
+    }
+
     inline void pop_back()
     {
-        tnode* n = anchor_.tprev;
-        n->node.aprev->anext = &anchor_;
-        anchor_.aprev = n->node.aprev;
+        tnode* n = anchor().tprev();
+        n->node.aprev->anext = &anchor();
+        anchor().aprev = n->node.aprev;
         n->value.~T();
-        allocator_.deallocate(n, 1);
+        alloc().deallocate(n, 1);
     }
 
     inline void pop_front()
     {
-        tnode* n = anchor_.tnext;
-        n->node.anext->aprev = &anchor_;
-        anchor_.anext = n->node.anext;
+        tnode* n = anchor().tnext();
+        n->node.anext->aprev = &anchor();
+        anchor().anext = n->node.anext;
         n->value.~T();
-        allocator_.deallocate(n, 1);
+        alloc().deallocate(n, 1);
     }
 
     inline void push_back(const T& t)
     {
-        tnode* n = allocator_.allocate(1);
+        tnode* n = alloc().allocate(1);
         new(static_cast<void*>(&n->value)) constructor(t);
-        n->node.aprev = anchor_.aprev;
-        n->node.anext = &anchor_;
-        anchor_.aprev->anext = &n->node;
-        anchor_.aprev = &n->node;
+        n->node.aprev = anchor().aprev;
+        n->node.anext = &anchor();
+        anchor().aprev->anext = &n->node;
+        anchor().aprev = &n->node;
     }
 
     inline void push_front(const T& t)
     {
-        tnode* n = allocator_.allocate(1);
+        tnode* n = alloc().allocate(1);
         new(static_cast<void*>(&n->value)) constructor(t);
-        n->node.anext = anchor_.anext;
-        n->node.aprev = &anchor_;
-        anchor_.anext->aprev = &n->node;
-        anchor_.anext = &n->node;
+        n->node.anext = anchor().anext;
+        n->node.aprev = &anchor();
+        anchor().anext->aprev = &n->node;
+        anchor().anext = &n->node;
     }
 
     /**
-     * @details undefined behavior if this allocator != other allocator
+     * @brief moves the items of other in front of pos, leaving other empty
+     * @details the nodes are relinked if the allocators compare equal.
+     * otherwise the nodes belong to other's allocator, so the items are
+     * copied into nodes from this list's allocator and other is cleared.
      */
     void splice(iterator pos, list& other)
     {
         tnode* p = pos.node_;
-        assert(allocator_ == other.allocator_);
-        // insert the other list into this one (in front of pos)
-        p->node.aprev->anext = other.anchor_.anext;
-        other.anchor_.anext->aprev = p->node.aprev;
-        p->node.aprev = other.anchor_.aprev;
-        other.anchor_.aprev->anext = &p->node;
-        // clear the other list
-        other.anchor_.aprev = &other.anchor_;
-        other.anchor_.anext = &other.anchor_;
+        if(alloc() == other.alloc())
+        {
+            // insert the other list into this one (in front of pos)
+            p->node.aprev->anext = other.anchor().anext;
+            other.anchor().anext->aprev = p->node.aprev;
+            p->node.aprev = other.anchor().aprev;
+            other.anchor().aprev->anext = &p->node;
+            // clear the other list
+            other.anchor().aprev = &other.anchor();
+            other.anchor().anext = &other.anchor();
+        }
+        else
+        {
+            tnode* n = other.anchor().tnext();
+            while(static_cast<void*>(n) != static_cast<void*>(&other.anchor()))
+            {
+                insert(pos, n->value);
+                n = n->node.tnext();
+            }
+            other.clear();
+        }
+    }
+
+    /**
+     * @brief exchanges the items and allocators of this list and other
+     * @details constant time. no nodes are copied or reallocated, and
+     * iterators remain valid but refer to the other list.
+     */
+    void swap(list& other)
+    {
+        bool isempty = empty();
+        bool otherempty = other.empty();
+        anode a = anchor();
+        anchor() = other.anchor();
+        other.anchor() = a;
+        relink_anchor(otherempty);
+        other.relink_anchor(isempty);
+        traits::swap(alloc(), other.alloc());
     }
 
 private:
 
+    struct anode;
+    struct tnode;
+
+    // plain pointers, or relative_ptr if the allocator's memory can move
+    typedef typename pointer_traits<Allocator>::template rebind<anode>::other
+        anode_ptr;
+
     struct anode
     {
-        union
+        anode_ptr aprev;
+        anode_ptr anext;
+
+        // the neighbors of this node viewed as the tnodes that contain them
+        inline tnode* tprev() const
         {
-            struct
-            {
-                struct list::anode* aprev;
-                struct list::anode* anext;
-            };
-            struct
-            {
-                struct list::tnode* tprev;
-                struct list::tnode* tnext;
-            };
-        };
+            return reinterpret_cast<tnode*>(static_cast<anode*>(aprev));
+        }
+
+        inline tnode* tnext() const
+        {
+            return reinterpret_cast<tnode*>(static_cast<anode*>(anext));
+        }
     };
 
     struct tnode
@@ -355,6 +462,13 @@ private:
     };
 
     typedef typename Allocator::template rebind<tnode>::other allocator_type;
+    typedef allocator_traits<allocator_type, tnode> traits;
+
+    enum
+    {
+        // nodes need not be visited to destroy their values
+        TRIVIAL_DESTRUCTOR = __has_trivial_destructor(T) | !__is_class(T)
+    };
     typedef int OffsetTest[(offsetof(tnode, node) == 0) * 2 - 1];
 
     // define a custom placement new operator to remove dependency on
@@ -380,8 +494,38 @@ private:
         }
     };
 
-    anode anchor_;
-    allocator_type allocator_;
+    // the allocator takes no space when it is empty
+    compressed_pair<anode, allocator_type> anchor_;
+
+    inline anode& anchor()
+    {
+        return anchor_.first();
+    }
+
+    inline const anode& anchor() const
+    {
+        return anchor_.first();
+    }
+
+    inline allocator_type& alloc()
+    {
+        return anchor_.second();
+    }
+
+    // points the end nodes back at the anchor after it has been exchanged
+    inline void relink_anchor(bool isempty)
+    {
+        if(isempty)
+        {
+            anchor().aprev = &anchor();
+            anchor().anext = &anchor();
+        }
+        else
+        {
+            anchor().anext->aprev = &anchor();
+            anchor().aprev->anext = &anchor();
+        }
+    }
 
 private:
     // noncopyable
@@ -0,0 +1,674 @@
+/**
+ * @brief     C++ lock-free split ordered hash map template implemenation
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_LOCKFREE_UNORDERED_MAP_H_
+#define taapp_LOCKFREE_UNORDERED_MAP_H_
+
+#include "allocator.h"
+#include "atomic.h"
+#include "compressed_pair.h"
+#include "epoch.h"
+#include "hash.h"
+#include "pair.h"
+#include "thread.h"
+#include "vector.h"
+#include <cassert>
+#include <cstddef>
+
+namespace taapp
+{
+
+/**
+ * @brief hash map for concurrent lookups that take no locks
+ * @details The items are kept in a single lock-free linked list sorted in
+ * split order, the bit reversal of their hashes, so that the items of every
+ * bucket are contiguous. Each bucket points at a dummy node in the list.
+ * When the table doubles, a new bucket is initialized on first use by
+ * inserting its dummy after the dummy of its parent bucket, the same index
+ * with its top bit cleared; no item ever moves and no global lock is
+ * taken. The bucket array is a directory of segments that double in size,
+ * so growing the table never copies it.
+ *
+ * find, contains and visit only load pointers and announce themselves in
+ * an epoch (see epoch.h); they take no locks and perform no atomic
+ * read-modify-write operations. A lookup that lands in a bucket that is
+ * not initialized yet starts from the nearest initialized parent instead
+ * of initializing it. insert and erase link and unlink nodes with compare
+ * and swap. Erased nodes are kept until no reader can reach them. Values
+ * cannot be modified once inserted.
+ *
+ * Writers call the allocators while holding a spinlock, so any allocator
+ * in this library may be used. The map may be destroyed only when no other
+ * thread is using it.
+ */
+template<
+    typename Key,
+    typename T,
+    typename Hash = hash<Key>,
+    typename Pred = equal_to<Key>,
+    typename Alloc = allocator<pair<Key, T> > >
+class lockfree_unordered_map
+{
+public:
+
+    typedef pair<Key, T> value_type;
+
+    lockfree_unordered_map() : size_(FIRST_SEGMENT), count_(0)
+    {
+        lock_.locked_ = 0;
+        for(size_t i = 0; i < SEGMENTS; ++i)
+        {
+            segments_[i] = NULL;
+        }
+        // bucket 0 heads the whole list
+        slot* s = add_segment(0);
+        lnode* head = dummy_alloc().allocate(1);
+        head->next = NULL;
+        head->key = 0;
+        s[0] = head;
+    }
+
+    ~lockfree_unordered_map()
+    {
+        retired* r = retired_.begin();
+        retired* rend = retired_.end();
+        while(r != rend)
+        {
+            free_node(r->node);
+            ++r;
+        }
+        lnode* n = segments_[0][0];
+        while(n != NULL)
+        {
+            lnode* next = unmarked(n->next);
+            if(is_regular(n->key))
+            {
+                free_node(reinterpret_cast<tnode*>(n));
+            }
+            else
+            {
+                dummy_alloc().deallocate(n, 1);
+            }
+            n = next;
+        }
+        for(size_t i = 0; i < SEGMENTS; ++i)
+        {
+            if(segments_[i] != NULL)
+            {
+                segment_alloc().deallocate(segments_[i], segment_size(i));
+            }
+        }
+    }
+
+    // the number of buckets the table has grown to
+    inline size_t bucket_count() const
+    {
+        return atomic_load(&size_);
+    }
+
+    inline bool contains(const Key& k) const
+    {
+        epoch::guard g;
+        return lookup(k) != NULL;
+    }
+
+    /**
+     * @brief removes k. returns true if it was present
+     * @details the node is unlinked at once and freed after every lookup
+     * that might still be reading it has finished.
+     */
+    bool erase(const Key& k)
+    {
+        epoch::guard g;
+        size_t h = hasher()(k);
+        size_t key = regular_key(h);
+        lnode* head = get_bucket(h & (atomic_load(&size_) - 1));
+        lnode* prev;
+        lnode* curr;
+        for(;;)
+        {
+            if(!search(head, key, &k, prev, curr))
+            {
+                return false;
+            }
+            lnode* next = atomic_load(&curr->next);
+            if(is_marked(next))
+            {
+                // another thread is erasing it; search again to unlink it
+                continue;
+            }
+            if(atomic_compare_exchange(&curr->next, next, marked(next)))
+            {
+                break;
+            }
+        }
+        // the node is logically erased; try to unlink it as well
+        atomic_fetch_add(&count_, static_cast<size_t>(-1));
+        lnode* expected = curr;
+        if(atomic_compare_exchange(&prev->next, expected, unmarked_next(curr)))
+        {
+            retire(curr);
+        }
+        else
+        {
+            // a search unlinks and retires every marked node it passes
+            search(head, key, &k, prev, curr);
+        }
+        return true;
+    }
+
+    // copies the value of k to out. returns false if k is absent
+    bool find(const Key& k, T& out) const
+    {
+        epoch::guard g;
+        const tnode* n = lookup(k);
+        if(n != NULL)
+        {
+            out = n->value.second;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief inserts v if its key is absent. returns true if it was inserted
+     * @details the table doubles when it holds more than MAX_LOAD items
+     * per bucket.
+     */
+    bool insert(const value_type& v)
+    {
+        epoch::guard g;
+        size_t h = hasher()(v.first);
+        size_t size = atomic_load(&size_);
+        lnode* head = get_bucket(h & (size - 1));
+        lock_.lock();
+        tnode* n = node_alloc().allocate(1);
+        lock_.unlock();
+        n->node.next = NULL;
+        n->node.key = regular_key(h);
+        new(static_cast<void*>(&n->value)) constructor(v);
+        if(insert_node(head, &n->node, &v.first) != &n->node)
+        {
+            // the key is already present. n was never visible to others
+            scoped_lock<spinlock> lock(lock_);
+            free_node(n);
+            return false;
+        }
+        size_t count = atomic_fetch_add(&count_, static_cast<size_t>(1));
+        if(count + 1 > size * MAX_LOAD && size < MAX_BUCKETS)
+        {
+            size_t expected = size;
+            atomic_compare_exchange(&size_, expected, size * 2);
+        }
+        return true;
+    }
+
+    // the number of items. may be stale while other threads modify the map
+    inline size_t size() const
+    {
+        return atomic_load(&count_);
+    }
+
+    /**
+     * @brief calls f(v) with the value_type v of k
+     * @details f runs inside the lookup's epoch, so v stays valid until f
+     * returns even if k is erased meanwhile. returns false if k is absent.
+     */
+    template<typename F> bool visit(const Key& k, F& f) const
+    {
+        epoch::guard g;
+        const tnode* n = lookup(k);
+        if(n != NULL)
+        {
+            f(n->value);
+            return true;
+        }
+        return false;
+    }
+
+#ifndef taapp_LOCKFREE_UNORDERED_MAP_INTERNAL_API
+private:
+#endif // taapp_LOCKFREE_UNORDERED_MAP_INTERNAL_API
+
+    // a link in the split ordered list. dummy nodes are only an lnode
+    struct lnode
+    {
+        // the low bit marks this node as erased
+        lnode* volatile next;
+        // the split order key
+        size_t key;
+    };
+
+    struct tnode
+    {
+        lnode node;
+        value_type value;
+    };
+
+    // a bucket's dummy, or NULL until it is initialized. always accessed
+    // through the atomic functions
+    typedef lnode* slot;
+
+    // a node unlinked in epoch, waiting to be freed
+    struct retired
+    {
+        tnode* node;
+        size_t epoch;
+    };
+
+    typedef typename Alloc::template rebind<tnode>::other node_allocator;
+    typedef typename Alloc::template rebind<lnode>::other dummy_allocator;
+    typedef typename Alloc::template rebind<slot>::other segment_allocator;
+    typedef typename Alloc::template rebind<retired>::other retired_allocator;
+
+    enum
+    {
+        CACHE_LINE = 64,
+        // average items per bucket before the table doubles
+        MAX_LOAD = 2,
+        // segment 0 holds the first FIRST_SEGMENT buckets, and every later
+        // segment as many buckets as all of the ones before it
+        FIRST_BITS = 6,
+        FIRST_SEGMENT = 1 << FIRST_BITS,
+        SEGMENTS = 26,
+        // erased nodes collected before trying to free them
+        RECLAIM_BATCH = 64
+    };
+
+    static const size_t MAX_BUCKETS =
+        static_cast<size_t>(FIRST_SEGMENT) << (SEGMENTS - 1);
+
+    // define a custom placement new operator to remove dependency on
+    // the std <new> header
+    class constructor
+    {
+    public:
+        value_type t_;
+
+        inline constructor(const value_type& t) : t_(t)
+        {
+        }
+
+        inline void* operator new (size_t size, void* ptr)
+        {
+            return ptr;
+        }
+
+        inline void operator delete (void *, void *)
+        {
+        }
+    };
+
+    // frees nodes in batches once the epoch has moved past them
+    struct reclaim_safe
+    {
+        lockfree_unordered_map* map;
+        size_t current;
+
+        inline bool operator()(const retired& r) const
+        {
+            if(epoch::is_safe(r.epoch, current))
+            {
+                map->free_node(r.node);
+                return true;
+            }
+            return false;
+        }
+    };
+
+    slot* volatile segments_[SEGMENTS];
+    // read by every lookup, so kept off the line written by every insert
+    volatile size_t size_;
+    char pad_[CACHE_LINE];
+    volatile size_t count_;
+    // guards the allocators and retired_
+    spinlock lock_;
+    vector<retired, retired_allocator> retired_;
+    // the functors and allocators, which take no space when they are empty
+    struct functors :
+        compressed_member<Hash, 0>,
+        compressed_member<Pred, 1>,
+        compressed_member<node_allocator, 2>,
+        compressed_member<dummy_allocator, 3>,
+        compressed_member<segment_allocator, 4>
+    {
+        inline const Hash& hasher() const
+        {
+            return compressed_member<Hash, 0>::get();
+        }
+
+        inline const Pred& equals() const
+        {
+            return compressed_member<Pred, 1>::get();
+        }
+
+        inline node_allocator& node_alloc()
+        {
+            return compressed_member<node_allocator, 2>::get();
+        }
+
+        inline dummy_allocator& dummy_alloc()
+        {
+            return compressed_member<dummy_allocator, 3>::get();
+        }
+
+        inline segment_allocator& segment_alloc()
+        {
+            return compressed_member<segment_allocator, 4>::get();
+        }
+    };
+
+    functors functors_;
+
+    inline const Hash& hasher() const
+    {
+        return functors_.hasher();
+    }
+
+    inline const Pred& equals() const
+    {
+        return functors_.equals();
+    }
+
+    inline node_allocator& node_alloc()
+    {
+        return functors_.node_alloc();
+    }
+
+    inline dummy_allocator& dummy_alloc()
+    {
+        return functors_.dummy_alloc();
+    }
+
+    inline segment_allocator& segment_alloc()
+    {
+        return functors_.segment_alloc();
+    }
+
+    static inline bool is_marked(lnode* p)
+    {
+        return (reinterpret_cast<size_t>(p) & 1) != 0;
+    }
+
+    static inline lnode* marked(lnode* p)
+    {
+        return reinterpret_cast<lnode*>(reinterpret_cast<size_t>(p) | 1);
+    }
+
+    static inline lnode* unmarked(lnode* p)
+    {
+        return reinterpret_cast<lnode*>(
+            reinterpret_cast<size_t>(p) & ~static_cast<size_t>(1));
+    }
+
+    static inline lnode* unmarked_next(const lnode* n)
+    {
+        return unmarked(atomic_load(&n->next));
+    }
+
+    static inline size_t reverse_bits(size_t x)
+    {
+        const size_t m1 = ~static_cast<size_t>(0) / 3;
+        const size_t m2 = ~static_cast<size_t>(0) / 5;
+        const size_t m4 = ~static_cast<size_t>(0) / 17;
+        const size_t m8 = ~static_cast<size_t>(0) / 257;
+        const size_t m16 = ~static_cast<size_t>(0) / 65537;
+        x = ((x >> 1) & m1) | ((x & m1) << 1);
+        x = ((x >> 2) & m2) | ((x & m2) << 2);
+        x = ((x >> 4) & m4) | ((x & m4) << 4);
+        x = ((x >> 8) & m8) | ((x & m8) << 8);
+        x = ((x >> 16) & m16) | ((x & m16) << 16);
+        if(sizeof(size_t) > 4)
+        {
+            x = (x >> 16 >> 16) | (x << 16 << 16);
+        }
+        return x;
+    }
+
+    // items sort after the dummy of their bucket, which has the low bit clear
+    static inline size_t regular_key(size_t h)
+    {
+        return reverse_bits(h) | 1;
+    }
+
+    static inline bool is_regular(size_t key)
+    {
+        return (key & 1) != 0;
+    }
+
+    // the index of the highest set bit of b, which must not be 0
+    static inline size_t highest_bit(size_t b)
+    {
+#if defined(__GNUC__)
+        return sizeof(unsigned long long) * 8 - 1 -
+            __builtin_clzll(static_cast<unsigned long long>(b));
+#else
+        size_t i = 0;
+        while(b >>= 1)
+        {
+            ++i;
+        }
+        return i;
+#endif
+    }
+
+    // the bucket whose dummy precedes the dummy of bucket b in the list
+    static inline size_t parent_bucket(size_t b)
+    {
+        return b ^ (static_cast<size_t>(1) << highest_bit(b));
+    }
+
+    static inline size_t segment_of(size_t b)
+    {
+        return (b < FIRST_SEGMENT) ? 0 : highest_bit(b) - FIRST_BITS + 1;
+    }
+
+    static inline size_t segment_start(size_t s)
+    {
+        return (s == 0) ? 0 : static_cast<size_t>(FIRST_SEGMENT) << (s - 1);
+    }
+
+    static inline size_t segment_size(size_t s)
+    {
+        return (s == 0) ?
+            static_cast<size_t>(FIRST_SEGMENT) :
+            static_cast<size_t>(FIRST_SEGMENT) << (s - 1);
+    }
+
+    // allocates segment s with every bucket uninitialized, if it is missing
+    slot* add_segment(size_t s)
+    {
+        scoped_lock<spinlock> lock(lock_);
+        slot* seg = atomic_load(&segments_[s]);
+        if(seg == NULL)
+        {
+            size_t count = segment_size(s);
+            seg = segment_alloc().allocate(count);
+            for(size_t i = 0; i < count; ++i)
+            {
+                seg[i] = NULL;
+            }
+            atomic_store(&segments_[s], seg);
+        }
+        return seg;
+    }
+
+    // the dummy of bucket b, inserting it and any missing parents
+    lnode* get_bucket(size_t b)
+    {
+        size_t s = segment_of(b);
+        slot* seg = atomic_load(&segments_[s]);
+        if(seg == NULL)
+        {
+            seg = add_segment(s);
+        }
+        slot* dst = &seg[b - segment_start(s)];
+        lnode* d = atomic_load(dst);
+        if(d == NULL)
+        {
+            lnode* parent = get_bucket(parent_bucket(b));
+            lock_.lock();
+            d = dummy_alloc().allocate(1);
+            lock_.unlock();
+            d->next = NULL;
+            d->key = reverse_bits(b);
+            lnode* actual = insert_node(parent, d, NULL);
+            if(actual != d)
+            {
+                // another thread inserted the same dummy first
+                lock_.lock();
+                dummy_alloc().deallocate(d, 1);
+                lock_.unlock();
+                d = actual;
+            }
+            atomic_store(dst, d);
+        }
+        return d;
+    }
+
+    // the dummy of bucket b, or of its nearest initialized parent. does not
+    // write, so lookups may use it
+    const lnode* find_bucket(size_t b) const
+    {
+        for(;;)
+        {
+            size_t s = segment_of(b);
+            const slot* seg = atomic_load(&segments_[s]);
+            if(seg != NULL)
+            {
+                const lnode* d = atomic_load(&seg[b - segment_start(s)]);
+                if(d != NULL)
+                {
+                    return d;
+                }
+            }
+            // bucket 0 is always initialized
+            b = parent_bucket(b);
+        }
+    }
+
+    // the node holding k, or NULL. the caller must be inside an epoch
+    const tnode* lookup(const Key& k) const
+    {
+        size_t h = hasher()(k);
+        size_t key = regular_key(h);
+        const lnode* n = find_bucket(h & (atomic_load(&size_) - 1));
+        n = unmarked_next(n);
+        while(n != NULL && n->key <= key)
+        {
+            lnode* next = atomic_load(&n->next);
+            if(n->key == key &&
+                !is_marked(next) &&
+                equals()(k, reinterpret_cast<const tnode*>(n)->value.first))
+            {
+                return reinterpret_cast<const tnode*>(n);
+            }
+            n = unmarked(next);
+        }
+        return NULL;
+    }
+
+    /**
+     * @brief finds the position of key in the list after head
+     * @details on return prev links to curr, which is the node holding the
+     * dummy key or the key k, or else the first node sorting after them.
+     * returns true if curr holds it. marked nodes passed on the way are
+     * unlinked and retired.
+     */
+    bool search(
+        lnode* head,
+        size_t key,
+        const Key* k,
+        lnode*& prev,
+        lnode*& curr)
+    {
+    retry:
+        prev = head;
+        curr = unmarked_next(prev);
+        while(curr != NULL)
+        {
+            lnode* next = atomic_load(&curr->next);
+            if(is_marked(next))
+            {
+                lnode* expected = curr;
+                if(!atomic_compare_exchange(
+                    &prev->next,
+                    expected,
+                    unmarked(next)))
+                {
+                    goto retry;
+                }
+                retire(curr);
+                curr = unmarked(next);
+                continue;
+            }
+            if(curr->key > key)
+            {
+                return false;
+            }
+            if(curr->key == key &&
+                (k == NULL ||
+                    equals()(
+                        *k,
+                        reinterpret_cast<tnode*>(curr)->value.first)))
+            {
+                return true;
+            }
+            prev = curr;
+            curr = next;
+        }
+        return false;
+    }
+
+    // links n into the list after head, unless a node with its key, or with
+    // k, is present. returns n, or the node that was already present
+    lnode* insert_node(lnode* head, lnode* n, const Key* k)
+    {
+        lnode* prev;
+        lnode* curr;
+        for(;;)
+        {
+            if(search(head, n->key, k, prev, curr))
+            {
+                return curr;
+            }
+            atomic_store_relaxed(&n->next, curr);
+            lnode* expected = curr;
+            if(atomic_compare_exchange(&prev->next, expected, n))
+            {
+                return n;
+            }
+        }
+    }
+
+    // queues an unlinked node to be freed once no reader can reach it
+    void retire(lnode* n)
+    {
+        scoped_lock<spinlock> lock(lock_);
+        retired r = { reinterpret_cast<tnode*>(n), epoch::now() };
+        retired_.push_back(r);
+        if(retired_.size() % RECLAIM_BATCH == 0)
+        {
+            reclaim_safe pred = { this, epoch::try_advance() };
+            retired_.erase_if(pred);
+        }
+    }
+
+    void free_node(tnode* n)
+    {
+        n->value.~value_type();
+        node_alloc().deallocate(n, 1);
+    }
+
+private:
+    // noncopyable
+    lockfree_unordered_map(const lockfree_unordered_map&);
+    lockfree_unordered_map& operator=(const lockfree_unordered_map&);
+};
+
+}
+
+#endif // taapp_LOCKFREE_UNORDERED_MAP_H_
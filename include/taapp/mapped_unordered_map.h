@@ -0,0 +1,401 @@
+/**
+ * @brief     C++ read only hash map template served from a mapped file
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_MAPPED_UNORDERED_MAP_H_
+#define taapp_MAPPED_UNORDERED_MAP_H_
+
+#include "compressed_pair.h"
+#include "hash.h"
+#include "pair.h"
+#include "unordered_map.h"
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace taapp
+{
+
+/**
+ * @brief hash map file that is looked up in place
+ * @details write stores the items of an unordered_map in a file as an open
+ * addressed table, and open maps such a file read only and serves find
+ * straight from the mapped pages. Nothing is read or rebuilt when the file
+ * is opened, so opening takes the same time at any size, and pages are
+ * only read from disk as lookups touch them. Every process that maps the
+ * file shares the same pages of the page cache.
+ *
+ * The file holds a header, one control byte per slot and the slots, each
+ * at an offset from the start of the file, so it may be mapped at any
+ * address. A control byte is 0 for an empty slot, or the top bit and 7
+ * more bits of the key's hash, so most slots of a probe are rejected
+ * without reading their key. Slots are probed linearly and at most 3 in 4
+ * of them are used.
+ *
+ * Key and T are copied to the file byte for byte, so they must be
+ * trivially copyable and must not hold pointers. The file is read on the
+ * machine that wrote it, or one with the same byte order and type sizes,
+ * and with the same Hash; open checks the type sizes and the hashes of the
+ * first few keys and fails if they do not match. Memory mapped files are only
+ * supported on POSIX systems; elsewhere write and open fail.
+ */
+template<
+    typename Key,
+    typename T,
+    typename Hash = hash<Key>,
+    typename Pred = equal_to<Key> >
+class mapped_unordered_map
+{
+public:
+
+    typedef pair<Key, T> value_type;
+
+    mapped_unordered_map() : header_(NULL)
+    {
+    }
+
+    ~mapped_unordered_map()
+    {
+        close();
+    }
+
+    // the number of slots in the table
+    inline size_t bucket_count() const
+    {
+        return (header_ != NULL) ? static_cast<size_t>(header_->capacity) : 0;
+    }
+
+    // unmaps the file
+    void close()
+    {
+        if(header_ != NULL)
+        {
+#if defined(__unix__) || defined(__APPLE__)
+            munmap(
+                const_cast<header*>(header_),
+                static_cast<size_t>(header_->file_size));
+#endif
+            header_ = NULL;
+        }
+    }
+
+    inline bool contains(const Key& k) const
+    {
+        return find(k) != NULL;
+    }
+
+    // the item with key k, or NULL if k is absent
+    const value_type* find(const Key& k) const
+    {
+        if(header_ == NULL)
+        {
+            return NULL;
+        }
+        unsigned long long h = hash_mix(hasher()(k));
+        size_t mask = static_cast<size_t>(header_->capacity) - 1;
+        const unsigned char* controls = control_bytes();
+        const value_type* slots = slot_values();
+        unsigned char t = tag(h);
+        size_t i = static_cast<size_t>(h) & mask;
+        // no key is further than max_probe slots from its home slot, which
+        // also bounds the probe of a damaged file
+        for(size_t n = 0; n <= header_->max_probe; ++n)
+        {
+            unsigned char c = controls[i];
+            if(c == t && equals()(k, slots[i].first))
+            {
+                return slots + i;
+            }
+            if(c == EMPTY)
+            {
+                break;
+            }
+            i = (i + 1) & mask;
+        }
+        return NULL;
+    }
+
+    inline bool is_open() const
+    {
+        return header_ != NULL;
+    }
+
+    /**
+     * @brief maps the file at path read only
+     * @details returns false if the file cannot be mapped, was not written
+     * by a mapped_unordered_map of the same types, or is truncated.
+     */
+    bool open(const char* path)
+    {
+        close();
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path, O_RDONLY);
+        if(fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        if(fstat(fd, &st) != 0 ||
+            static_cast<size_t>(st.st_size) < sizeof(header))
+        {
+            ::close(fd);
+            return false;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        void* p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED)
+        {
+            return false;
+        }
+        header_ = static_cast<const header*>(p);
+        if(!is_valid(size))
+        {
+            munmap(p, size);
+            header_ = NULL;
+            return false;
+        }
+        return true;
+#else
+        (void) path;
+        return false;
+#endif
+    }
+
+    // the number of items in the file
+    inline size_t size() const
+    {
+        return (header_ != NULL) ? static_cast<size_t>(header_->size) : 0;
+    }
+
+    /**
+     * @brief writes the items of map to a new file at path
+     * @details an existing file is truncated, so a file that other
+     * processes have mapped should be replaced by writing a new one and
+     * renaming it over the old. returns false if the file cannot be
+     * created or mapped.
+     */
+    template<typename H, typename P, typename A, bool O>
+    bool write(
+        const char* path,
+        const unordered_map<Key, T, H, P, A, O>& map) const
+    {
+        // the items are copied to the file byte for byte
+        typedef int TrivialCheck[
+            (__has_trivial_copy(Key) && __has_trivial_copy(T)) * 2 - 1];
+        (void) sizeof(TrivialCheck);
+#if defined(__unix__) || defined(__APPLE__)
+        size_t capacity = MIN_CAPACITY;
+        while(capacity * MAX_LOAD_NUM < map.size() * MAX_LOAD_DEN)
+        {
+            capacity *= 2;
+        }
+        size_t controls = round_up(sizeof(header));
+        size_t slots = round_up(controls + capacity);
+        size_t file_size = slots + capacity * sizeof(value_type);
+        int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0)
+        {
+            return false;
+        }
+        if(ftruncate(fd, static_cast<off_t>(file_size)) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(
+            NULL,
+            file_size,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED,
+            fd,
+            0);
+        ::close(fd);
+        if(p == MAP_FAILED)
+        {
+            return false;
+        }
+        // the file was just extended, so it reads as zeros: every control
+        // byte is EMPTY and every pad byte is 0
+        header* hdr = static_cast<header*>(p);
+        hdr->magic = MAGIC;
+        hdr->version = VERSION;
+        hdr->key_size = sizeof(Key);
+        hdr->value_size = sizeof(T);
+        hdr->slot_size = sizeof(value_type);
+        hdr->size = map.size();
+        hdr->capacity = capacity;
+        hdr->controls = controls;
+        hdr->slots = slots;
+        hdr->file_size = file_size;
+        unsigned char* cbytes = static_cast<unsigned char*>(p) + controls;
+        value_type* svalues = reinterpret_cast<value_type*>(
+            static_cast<unsigned char*>(p) + slots);
+        typedef typename unordered_map<Key, T, H, P, A, O>::const_iterator
+            map_iterator;
+        map_iterator itr = map.begin();
+        map_iterator itrend = map.end();
+        while(itr != itrend)
+        {
+            unsigned long long h = hash_mix(hasher()(itr->first));
+            size_t i = static_cast<size_t>(h) & (capacity - 1);
+            unsigned int probe = 0;
+            while(cbytes[i] != EMPTY)
+            {
+                i = (i + 1) & (capacity - 1);
+                ++probe;
+            }
+            hdr->max_probe = (probe > hdr->max_probe) ? probe : hdr->max_probe;
+            cbytes[i] = tag(h);
+            // copy the members alone, so the padding between them stays 0
+            memcpy(&svalues[i].first, &itr->first, sizeof(Key));
+            memcpy(&svalues[i].second, &itr->second, sizeof(T));
+            ++itr;
+        }
+        return munmap(p, file_size) == 0;
+#else
+        (void) path;
+        (void) map;
+        return false;
+#endif
+    }
+
+#ifndef taapp_MAPPED_UNORDERED_MAP_INTERNAL_API
+private:
+#endif // taapp_MAPPED_UNORDERED_MAP_INTERNAL_API
+
+    enum
+    {
+        MAGIC = 0x6d706174, // "tapm"
+        VERSION = 1,
+        EMPTY = 0,
+        // the sections of the file start on cache line boundaries
+        ALIGNMENT = 64,
+        MIN_CAPACITY = 16,
+        // at most 3 in 4 slots are used, which keeps linear probes short
+        MAX_LOAD_NUM = 3,
+        MAX_LOAD_DEN = 4,
+        // keys looked up by open to check the hash. one is not enough, since
+        // many hashes agree on a key such as 0
+        CHECK_KEYS = 4
+    };
+
+    // stored at the start of the file. the sections are offsets from it
+    struct header
+    {
+        unsigned int magic;
+        unsigned int version;
+        unsigned int key_size;
+        unsigned int value_size;
+        unsigned int slot_size;
+        // the longest distance of a key from its home slot
+        unsigned int max_probe;
+        unsigned long long size;
+        // the number of slots, a power of two
+        unsigned long long capacity;
+        unsigned long long controls;
+        unsigned long long slots;
+        unsigned long long file_size;
+    };
+
+    const header* header_;
+    compressed_pair<Hash, Pred> functors_;
+
+    inline const Hash& hasher() const
+    {
+        return functors_.first();
+    }
+
+    inline const Pred& equals() const
+    {
+        return functors_.second();
+    }
+
+    static inline size_t round_up(size_t size)
+    {
+        return (size + ALIGNMENT - 1) & ~static_cast<size_t>(ALIGNMENT - 1);
+    }
+
+    // a full control byte: the top bit, and 7 hash bits the index skips
+    static inline unsigned char tag(unsigned long long h)
+    {
+        return static_cast<unsigned char>(0x80 | (h >> 57));
+    }
+
+    inline const unsigned char* control_bytes() const
+    {
+        return reinterpret_cast<const unsigned char*>(header_) +
+            header_->controls;
+    }
+
+    inline const value_type* slot_values() const
+    {
+        return reinterpret_cast<const value_type*>(
+            reinterpret_cast<const unsigned char*>(header_) + header_->slots);
+    }
+
+    // checks the header against the file and the types, and that the first
+    // few keys are found where they were stored
+    bool is_valid(size_t file_size) const
+    {
+        const header& h = *header_;
+        unsigned long long capacity = h.capacity;
+        // the fields are bounded by the file size before any arithmetic on
+        // them, so that a damaged header cannot wrap a sum around
+        if(h.magic != MAGIC ||
+            h.version != VERSION ||
+            h.key_size != sizeof(Key) ||
+            h.value_size != sizeof(T) ||
+            h.slot_size != sizeof(value_type) ||
+            h.file_size != file_size ||
+            capacity < MIN_CAPACITY ||
+            capacity > file_size ||
+            (capacity & (capacity - 1)) != 0 ||
+            h.size > capacity ||
+            h.size * MAX_LOAD_DEN > capacity * MAX_LOAD_NUM ||
+            h.slots > file_size ||
+            h.slots % ALIGNMENT != 0 ||
+            h.controls < sizeof(header) ||
+            h.controls % ALIGNMENT != 0 ||
+            h.controls > h.slots ||
+            capacity > h.slots - h.controls ||
+            h.max_probe >= capacity ||
+            (file_size - h.slots) / sizeof(value_type) < capacity)
+        {
+            return false;
+        }
+        const unsigned char* controls = control_bytes();
+        const value_type* slots = slot_values();
+        size_t checked = 0;
+        for(size_t i = 0; i < capacity && checked < CHECK_KEYS; ++i)
+        {
+            if(controls[i] != EMPTY)
+            {
+                if(find(slots[i].first) != slots + i)
+                {
+                    return false;
+                }
+                ++checked;
+            }
+        }
+        return true;
+    }
+
+private:
+    // noncopyable
+    mapped_unordered_map(const mapped_unordered_map&);
+    mapped_unordered_map& operator=(const mapped_unordered_map&);
+};
+
+}
+
+#endif // taapp_MAPPED_UNORDERED_MAP_H_
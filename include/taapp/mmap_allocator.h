@@ -0,0 +1,276 @@
+/**
+ * @brief     C++ allocator template backed by anonymous memory mappings
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_MMAP_ALLOCATOR_H_
+#define taapp_MMAP_ALLOCATOR_H_
+
+#include "allocator_traits.h"
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace taapp
+{
+
+/**
+ * @brief allocator that grows large buffers by remapping pages
+ * @details Requests of at least Threshold bytes are served from anonymous
+ * mmap regions, and reallocate grows or shrinks them with mremap. The kernel
+ * moves the pages in the page tables rather than copying them, so growing
+ * a huge vector of trivial types costs O(pages) instead of O(bytes).
+ * Smaller requests go to malloc. On platforms other than Linux every request
+ * goes to malloc.
+ */
+template<typename T, size_t Threshold = 1048576> class mmap_allocator
+{
+public:
+
+    template<typename U> struct rebind
+    {
+        typedef mmap_allocator<U, Threshold> other;
+    };
+
+    inline mmap_allocator()
+#ifndef NDEBUG
+        : counter_(0)
+#endif
+    {
+    }
+
+#ifndef NDEBUG
+    inline mmap_allocator(const mmap_allocator&) : counter_(0)
+    {
+    }
+#endif
+
+    template<typename U>
+    inline mmap_allocator(const mmap_allocator<U, Threshold>&)
+#ifndef NDEBUG
+        : counter_(0)
+#endif
+    {
+    }
+
+#ifndef NDEBUG
+    ~mmap_allocator()
+    {
+        assert(counter_ == 0);
+    }
+#endif
+
+    inline bool operator==(const mmap_allocator&) const
+    {
+        return true;
+    }
+
+    inline bool operator!=(const mmap_allocator&) const
+    {
+        return false;
+    }
+
+    // exchanges the state of two instances, so that each keeps counting
+    // the blocks it handed out
+    inline void swap(mmap_allocator& other)
+    {
+#ifndef NDEBUG
+        int counter = counter_;
+        counter_ = other.counter_;
+        other.counter_ = counter;
+#endif
+    }
+
+    // allocate but don't initialize num elements of type T
+    inline T* allocate (size_t n, const void* = 0)
+    {
+        size_t size = sizeof(T) * n;
+        T* t = static_cast<T*>(is_mapped(size) ? map(size) : malloc(size));
+#ifndef NDEBUG
+        ++counter_;
+#endif
+        return t;
+    }
+
+    // resize storage p from oldn to n elements, preserving its contents
+    T* reallocate(void* p, size_t oldn, size_t n)
+    {
+        size_t oldsize = sizeof(T) * oldn;
+        size_t size = sizeof(T) * n;
+        void* t;
+        if(p == NULL)
+        {
+            t = is_mapped(size) ? map(size) : malloc(size);
+#ifndef NDEBUG
+            ++counter_;
+#endif
+        }
+        else if(!is_mapped(oldsize) && !is_mapped(size))
+        {
+            t = realloc(p, size);
+        }
+#if defined(__linux__)
+        else if(is_mapped(oldsize) && is_mapped(size))
+        {
+            t = mremap(
+                p,
+                round_size(oldsize),
+                round_size(size),
+                MREMAP_MAYMOVE);
+            if(t == MAP_FAILED)
+            {
+                t = NULL;
+            }
+        }
+#endif
+        else
+        {
+            // the buffer is moving between the heap and a mapping
+            t = is_mapped(size) ? map(size) : malloc(size);
+            if(t != NULL)
+            {
+                memcpy(t, p, (oldsize < size) ? oldsize : size);
+                release(p, oldsize);
+            }
+        }
+        return static_cast<T*>(t);
+    }
+
+    // number of elements that fit in storage p allocated for n elements
+    inline size_t usable_size(T* p, size_t n)
+    {
+        size_t size = sizeof(T) * n;
+        if(is_mapped(size))
+        {
+            // the rest of the last page is part of the mapping
+            size = round_size(size);
+        }
+        else
+        {
+            // the heap block must not grow into the mapped range, since the
+            // size passed to deallocate decides how it is released
+            size = heap_usable_size(p, size);
+            if(is_mapped(size))
+            {
+                size = Threshold - 1;
+            }
+        }
+        return size / sizeof(T);
+    }
+
+    // initialize elements of allocated storage p with value v
+    inline void construct (T* p, const T& v)
+    {
+        new(static_cast<void*>(p)) constructor(v);
+    }
+
+    // destroy but do not deallocate elements of initialized storage p
+    inline void destroy (T* p)
+    {
+        p->~T();
+    }
+
+    // deallocate storage p of deleted elements
+    inline void deallocate(T* p, size_t n)
+    {
+#ifndef NDEBUG
+        --counter_;
+#endif
+        release(p, sizeof(T) * n);
+    }
+
+private:
+
+#ifndef NDEBUG
+    int counter_;
+#endif
+
+    // define a custom placement new operator to remove dependency on
+    // the std <new> header
+    class constructor
+    {
+    public:
+        T t_;
+
+        inline constructor(const T& t) : t_(t)
+        {
+        }
+
+        inline void* operator new (size_t size, void* ptr)
+        {
+            return ptr;
+        }
+
+        inline void operator delete (void *, void *)
+        {
+        }
+    };
+
+#if defined(__linux__)
+    static inline bool is_mapped(size_t size)
+    {
+        return size >= Threshold;
+    }
+
+    static inline size_t round_size(size_t size)
+    {
+        static const size_t pagesize =
+            static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return (size + pagesize - 1) & ~(pagesize - 1);
+    }
+
+    static void* map(size_t size)
+    {
+        void* p = mmap(
+            NULL,
+            round_size(size),
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1,
+            0);
+        return (p != MAP_FAILED) ? p : NULL;
+    }
+
+    static void release(void* p, size_t size)
+    {
+        if(is_mapped(size))
+        {
+            munmap(p, round_size(size));
+        }
+        else
+        {
+            free(p);
+        }
+    }
+#else
+    static inline bool is_mapped(size_t)
+    {
+        return false;
+    }
+
+    static inline size_t round_size(size_t size)
+    {
+        return size;
+    }
+
+    static inline void* map(size_t size)
+    {
+        return malloc(size);
+    }
+
+    static inline void release(void* p, size_t)
+    {
+        free(p);
+    }
+#endif
+};
+
+}
+
+#endif // taapp_MMAP_ALLOCATOR_H_
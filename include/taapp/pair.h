@@ -22,6 +22,14 @@ template <typename T, typename U> struct pair
     U second;
 };
 
+// exchanges a and b through a copy, as std::swap does
+template<typename T> inline void swap(T& a, T& b)
+{
+    T t(a);
+    a = b;
+    b = t;
+}
+
 }
 
 #endif // taapp_PAIR_H_
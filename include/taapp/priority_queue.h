@@ -7,6 +7,7 @@
 #ifndef taapp_PRIORITY_QUEUE_H_
 #define taapp_PRIORITY_QUEUE_H_
 
+#include "compressed_pair.h"
 #include <cassert>
 #include <cstddef>
 
@@ -24,23 +25,23 @@ public:
 
     inline bool empty() const
     {
-        return container_.empty();
+        return container().empty();
     }
 
     void pop()
     {
-        assert(container_.size() > 0);
-        T node(container_.back());
-        container_.pop_back();
-        if(container_.size() > 0)
+        assert(container().size() > 0);
+        T node(container().back());
+        container().pop_back();
+        if(container().size() > 0)
         {
             ptrdiff_t index = 0;
             ptrdiff_t childindex = (index << 1) + 1;
-            ptrdiff_t end = container_.size();
+            ptrdiff_t end = container().size();
 
             T* child;
             T* rightchild;
-            T* heap = container_.begin();
+            T* heap = container().begin();
             // replace the item at the front of the heap
             // with the item at the end of the heap
             *heap = node;
@@ -53,7 +54,7 @@ public:
                     rightchild = heap + (childindex+1);
                     // choose the greater of either left child or right child
                     // if((*child) < (*rightchild))
-                    if(compare_(*child, *rightchild))
+                    if(compare()(*child, *rightchild))
                     {
                         ++childindex;
                         child = rightchild;
@@ -62,7 +63,7 @@ public:
                 // if the node is less than the child, swap them
                 // (moving the child closer to the front of the queue)
                 // if(node < (*child))
-                if(compare_(node, *child))
+                if(compare()(node, *child))
                 {
                     heap[index] = *child;
                     heap[childindex] = node;
@@ -80,11 +81,11 @@ public:
 
     void push(const T& n)
     {
-        ptrdiff_t index = container_.size();
+        ptrdiff_t index = container().size();
         ptrdiff_t parentindex = (index-1) >> 1;
 
-        container_.push_back(n);
-        T* heap = container_.begin();
+        container().push_back(n);
+        T* heap = container().begin();
         T* node = heap + index;
 
         T* parent;
@@ -94,7 +95,7 @@ public:
             // if the parent is less than node, swap them
             // (moving node closer to the front of the queue)
             // if((*parent) < (*node))
-            if(compare_(*parent, *node))
+            if(compare()(*parent, *node))
             {
                 *node = *parent;
                 node = parent;
@@ -111,20 +112,35 @@ public:
 
     inline size_t size() const
     {
-        return container_.size();
+        return container().size();
     }
 
     inline const T& top()
     {
-        return container_.front();
+        return container().front();
     }
 
 #ifndef taapp_PRIORITY_QUEUE_INTERNAL_API
 private:
 #endif // taapp_PRIORITY_QUEUE_INTERNAL_API
 
-    Container container_;
-    Compare compare_;
+    // the functor takes no space when it is empty
+    compressed_pair<Container, Compare> container_;
+
+    inline Container& container()
+    {
+        return container_.first();
+    }
+
+    inline const Container& container() const
+    {
+        return container_.first();
+    }
+
+    inline Compare& compare()
+    {
+        return container_.second();
+    }
 
 private:
     // noncopyable
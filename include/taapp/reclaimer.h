@@ -0,0 +1,301 @@
+/**
+ * @brief     C++ background container destruction implemenation
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_RECLAIMER_H_
+#define taapp_RECLAIMER_H_
+
+#include "thread.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+
+namespace taapp
+{
+
+template<typename Key, typename T, typename Compare, typename Allocator>
+class map;
+
+template<typename Key, typename Compare, typename Allocator> class set;
+
+template<
+    typename Key,
+    typename T,
+    typename Hash,
+    typename Pred,
+    typename Alloc,
+    bool Ordered>
+class unordered_map;
+
+/**
+ * @brief destroys containers on a background thread
+ * @details reclaim(c) swaps the contents of c into a container owned by the
+ * reclaimer and queues it, so the caller gets back an empty container in
+ * constant time while the nodes are destroyed and freed on the reclaimer's
+ * thread. It works with list, map, set and unordered_map, and with any
+ * other container that provides swap() and a constructor taking its
+ * allocator.
+ *
+ * The values' destructors run on the reclaimer's thread, and the allocator
+ * must allow blocks to be freed on a thread other than the one that
+ * allocated them. allocator, the malloc based allocators and
+ * thread_cache_allocator do. slab_allocator does as well, because swap()
+ * moves the whole allocator instance along with the nodes. file_allocator
+ * does not, since its arena is not thread safe. The container handed back
+ * keeps copies of its own functors, so stateful comparators and hashers
+ * survive being reclaimed.
+ */
+class reclaimer
+{
+public:
+
+    reclaimer() :
+        head_(NULL),
+        tail_(NULL),
+        pending_(0),
+        running_(false),
+        stopping_(false)
+    {
+    }
+
+    ~reclaimer()
+    {
+        stop();
+    }
+
+    // starts the background thread. returns false if it failed to start
+    bool start()
+    {
+        scoped_lock<mutex> lock(mutex_);
+        assert(!running_);
+        running_ = thread_.start(&reclaimer::run, this);
+        return running_;
+    }
+
+    // destroys every queued container, then stops the background thread
+    void stop()
+    {
+        mutex_.lock();
+        if(!running_ || stopping_)
+        {
+            mutex_.unlock();
+            return;
+        }
+        stopping_ = true;
+        queued_.signal();
+        mutex_.unlock();
+        thread_.join();
+        mutex_.lock();
+        running_ = false;
+        stopping_ = false;
+        mutex_.unlock();
+    }
+
+    /**
+     * @brief empties c in constant time, destroying its items later
+     * @details if the background thread is not running or is stopping, or
+     * the reclaimer cannot allocate its own copy of the container, the items
+     * are destroyed immediately instead.
+     */
+    template<typename C> void reclaim(C& c)
+    {
+        // the job is queued under the lock, so stop() either sees it before
+        // the thread exits or this sees stopping_ and destroys c here
+        mutex_.lock();
+        void* p = NULL;
+        if(running_ && !stopping_)
+        {
+            p = malloc(sizeof(container_job<C>));
+        }
+        if(p == NULL)
+        {
+            mutex_.unlock();
+            empty_container<C> empty(c);
+            empty.swap(c);
+            return;
+        }
+        container_job<C>* j = new(p) container_job<C>(c);
+        j->c_.swap(c);
+        if(tail_ != NULL)
+        {
+            tail_->next = j;
+        }
+        else
+        {
+            head_ = j;
+        }
+        tail_ = j;
+        ++pending_;
+        queued_.signal();
+        mutex_.unlock();
+    }
+
+    // waits until every container queued so far has been destroyed
+    void flush()
+    {
+        mutex_.lock();
+        while(pending_ != 0)
+        {
+            idle_.wait(mutex_);
+        }
+        mutex_.unlock();
+    }
+
+    // the number of containers waiting to be destroyed
+    size_t pending()
+    {
+        scoped_lock<mutex> lock(mutex_);
+        return pending_;
+    }
+
+#ifndef taapp_RECLAIMER_INTERNAL_API
+private:
+#endif // taapp_RECLAIMER_INTERNAL_API
+
+    // an empty container with the allocator of like. swap() exchanges the
+    // functors too, so the containers that have them take copies of like's
+    template<typename C> struct empty_container : public C
+    {
+        inline explicit empty_container(const C& like) :
+            C(like.get_allocator())
+        {
+        }
+    };
+
+    template<typename Key, typename T, typename Compare, typename Allocator>
+    struct empty_container<map<Key, T, Compare, Allocator> > :
+        public map<Key, T, Compare, Allocator>
+    {
+        typedef map<Key, T, Compare, Allocator> base;
+
+        inline explicit empty_container(const base& like) :
+            base(like.key_comp(), like.get_allocator())
+        {
+        }
+    };
+
+    template<typename Key, typename Compare, typename Allocator>
+    struct empty_container<set<Key, Compare, Allocator> > :
+        public set<Key, Compare, Allocator>
+    {
+        typedef set<Key, Compare, Allocator> base;
+
+        inline explicit empty_container(const base& like) :
+            base(like.key_comp(), like.get_allocator())
+        {
+        }
+    };
+
+    template<
+        typename Key,
+        typename T,
+        typename Hash,
+        typename Pred,
+        typename Alloc,
+        bool Ordered>
+    struct empty_container<
+        unordered_map<Key, T, Hash, Pred, Alloc, Ordered> > :
+        public unordered_map<Key, T, Hash, Pred, Alloc, Ordered>
+    {
+        typedef unordered_map<Key, T, Hash, Pred, Alloc, Ordered> base;
+
+        inline explicit empty_container(const base& like) :
+            base(like.hash_function(), like.key_eq(), like.get_allocator())
+        {
+            base::max_load_factor(like.max_load_factor());
+        }
+    };
+
+    struct job
+    {
+        job* next;
+        void (*destroy)(job* j);
+    };
+
+    // a queued container. defines a custom placement new operator to
+    // remove dependency on the std <new> header
+    template<typename C> struct container_job : public job
+    {
+        empty_container<C> c_;
+
+        inline explicit container_job(const C& like) : c_(like)
+        {
+            next = NULL;
+            destroy = &container_job::destroy_job;
+        }
+
+        static void destroy_job(job* j)
+        {
+            static_cast<container_job*>(j)->~container_job();
+            free(j);
+        }
+
+        inline void* operator new (size_t size, void* ptr)
+        {
+            return ptr;
+        }
+
+        inline void operator delete (void *, void *)
+        {
+        }
+    };
+
+    mutex mutex_;
+    condition queued_;
+    condition idle_;
+    thread thread_;
+    job* head_;
+    job* tail_;
+    size_t pending_;
+    bool running_;
+    bool stopping_;
+
+    static void run(void* arg)
+    {
+        static_cast<reclaimer*>(arg)->drain();
+    }
+
+    // destroys queued containers until stop() is called
+    void drain()
+    {
+        mutex_.lock();
+        for(;;)
+        {
+            while(head_ == NULL && !stopping_)
+            {
+                queued_.wait(mutex_);
+            }
+            job* j = head_;
+            if(j == NULL)
+            {
+                break;
+            }
+            head_ = NULL;
+            tail_ = NULL;
+            mutex_.unlock();
+            size_t count = 0;
+            while(j != NULL)
+            {
+                job* next = j->next;
+                j->destroy(j);
+                j = next;
+                ++count;
+            }
+            mutex_.lock();
+            pending_ -= count;
+            idle_.broadcast();
+        }
+        mutex_.unlock();
+    }
+
+private:
+    // noncopyable
+    reclaimer(const reclaimer&);
+    reclaimer& operator=(const reclaimer&);
+};
+
+}
+
+#endif // taapp_RECLAIMER_H_
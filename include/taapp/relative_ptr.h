@@ -0,0 +1,97 @@
+/**
+ * @brief     C++ self relative pointer template implemenation
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_RELATIVE_PTR_H_
+#define taapp_RELATIVE_PTR_H_
+
+#include <cstddef>
+
+namespace taapp
+{
+
+/**
+ * @brief pointer stored as an offset from its own address
+ * @details A structure linked with relative pointers remains valid when the
+ * memory holding it is mapped at a different base address, as long as every
+ * target lives in the same mapping. An offset of 0 refers to the pointer
+ * itself, so NULL is encoded as 1, which no aligned object can occupy.
+ * Copying a relative_ptr copies the address it refers to, not its offset.
+ */
+template<typename T> class relative_ptr
+{
+public:
+
+    inline relative_ptr()
+    {
+        set(NULL);
+    }
+
+    inline relative_ptr(T* p)
+    {
+        set(p);
+    }
+
+    inline relative_ptr(const relative_ptr& p)
+    {
+        set(p.get());
+    }
+
+    inline relative_ptr& operator=(T* p)
+    {
+        set(p);
+        return *this;
+    }
+
+    inline relative_ptr& operator=(const relative_ptr& p)
+    {
+        set(p.get());
+        return *this;
+    }
+
+    inline T* get() const
+    {
+        return (offset_ == NULL_OFFSET) ?
+            NULL :
+            reinterpret_cast<T*>(
+                const_cast<char*>(reinterpret_cast<const char*>(this)) +
+                    offset_);
+    }
+
+    inline operator T*() const
+    {
+        return get();
+    }
+
+    inline T& operator*() const
+    {
+        return *get();
+    }
+
+    inline T* operator->() const
+    {
+        return get();
+    }
+
+private:
+
+    enum
+    {
+        NULL_OFFSET = 1
+    };
+
+    ptrdiff_t offset_;
+
+    inline void set(T* p)
+    {
+        offset_ = (p == NULL) ?
+            static_cast<ptrdiff_t>(NULL_OFFSET) :
+            reinterpret_cast<char*>(p) - reinterpret_cast<char*>(this);
+    }
+};
+
+}
+
+#endif // taapp_RELATIVE_PTR_H_
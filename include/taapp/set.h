@@ -7,6 +7,8 @@
 #ifndef taapp_SET_H_
 #define taapp_SET_H_
 
+#include "allocator_traits.h"
+#include "compressed_pair.h"
 #include "pair.h"
 #include <cassert>
 #include <cstddef>
@@ -222,7 +224,24 @@ public:
         friend class set;
     };
 
-    set() : root_(0), size_(0)
+    set() : root_(0), size_()
+    {
+    }
+
+    // constructs an empty set whose nodes come from a copy of a
+    explicit set(const Allocator& a) :
+        root_(0),
+        size_(0, compressed_pair<Compare, allocator_type>(
+            Compare(),
+            allocator_type(a)))
+    {
+    }
+
+    set(const Compare& c, const Allocator& a) :
+        root_(0),
+        size_(0, compressed_pair<Compare, allocator_type>(
+            c,
+            allocator_type(a)))
     {
     }
 
@@ -257,39 +276,51 @@ public:
 
     void clear()
     {
-        rbnode* n = root_;
-        while(n != NULL)
+        if(traits::HAS_RELEASE_ALL && TRIVIAL_DESTRUCTOR)
         {
-            if(n->left != NULL)
-            {
-                n = n->left;
-            }
-            else if(n->right != NULL)
-            {
-                n = n->right;
-            }
-            else
+            // the allocator frees every node without walking the tree
+            traits::release_all(alloc());
+        }
+        else
+        {
+            rbnode* chain = NULL;
+            rbnode* n = root_;
+            while(n != NULL)
             {
-                // n is a leaf
-                rbnode* parent = n->parent;
-                n->value.~Key();
-                allocator_.deallocate(n, 1);
-                if(parent != NULL)
+                if(n->left != NULL)
                 {
-                    if(parent->left == n)
-                    {
-                        parent->left = NULL;
-                    }
-                    else
+                    n = n->left;
+                }
+                else if(n->right != NULL)
+                {
+                    n = n->right;
+                }
+                else
+                {
+                    // n is a leaf
+                    rbnode* parent = n->parent;
+                    n->value.~Key();
+                    if(parent != NULL)
                     {
-                        parent->right = NULL;
+                        if(parent->left == n)
+                        {
+                            parent->left = NULL;
+                        }
+                        else
+                        {
+                            parent->right = NULL;
+                        }
                     }
+                    traits::set_chain_next(n, chain);
+                    chain = n;
+                    n = parent;
                 }
-                n = parent;
             }
+            // return all of the nodes to the allocator at once
+            traits::deallocate_chain(alloc(), chain, size_.first());
         }
         root_ = NULL;
-        size_ = 0;
+        size_.first() = 0;
     }
 
     inline bool empty() const
@@ -392,13 +423,13 @@ public:
         }
 
         // clean up
-        --size_;
+        --size_.first();
         if(root_ != NULL)
         {
             root_->color = BLACK;
         }
         n->value.~Key();
-        allocator_.deallocate(n, 1);
+        alloc().deallocate(n, 1);
 
         return itr;
     }
@@ -408,11 +439,11 @@ public:
         rbnode* n = root_;
         while(n != NULL)
         {
-            if(compare_(t, n->value))
+            if(compare()(t, n->value))
             {
                 n = n->left;
             }
-            else if(compare_(n->value, t))
+            else if(compare()(n->value, t))
             {
                 n = n->right;
             }
@@ -424,23 +455,164 @@ public:
         return iterator(n);
     }
 
+    // a copy of the allocator the set was constructed with
+    inline Allocator get_allocator() const
+    {
+        return Allocator(size_.second().second());
+    }
+
     inline pair<iterator, bool> insert(const Key& t)
+    {
+        rbnode* chain = NULL;
+        return insert_unique(t, chain);
+    }
+
+    /**
+     * @brief inserts the values in the range [first, last)
+     * @details if the allocator supports allocate_bulk, the nodes for the
+     * whole range are allocated in one call, and any left unused by
+     * duplicate keys are returned in one call.
+     */
+    void insert(const Key* first, const Key* last)
+    {
+        size_t count = static_cast<size_t>(last - first);
+        rbnode* chain = traits::HAS_ALLOCATE_BULK ?
+            traits::allocate_chain(alloc(), count) :
+            NULL;
+        while(first != last)
+        {
+            insert_unique(*first, chain);
+            ++first;
+        }
+        if(chain != NULL)
+        {
+            // the chain may have come back short, so count what is left
+            traits::deallocate_chain(
+                alloc(),
+                chain,
+                traits::chain_length(chain));
+        }
+    }
+
+    // a copy of the comparison functor the set was constructed with
+    inline Compare key_comp() const
+    {
+        return size_.second().first();
+    }
+
+    inline size_t size() const
+    {
+        return size_.first();
+    }
+
+    /**
+     * @brief exchanges the items, functor and allocator of this set and other
+     * @details constant time. no nodes are copied or reallocated, and
+     * iterators remain valid but refer to the other set.
+     */
+    void swap(set& other)
+    {
+        taapp::swap(root_, other.root_);
+        taapp::swap(size_.first(), other.size_.first());
+        taapp::swap(compare(), other.compare());
+        traits::swap(alloc(), other.alloc());
+    }
+
+#ifndef taapp_SET_INTERNAL_API
+private:
+#endif // taapp_SET_INTERNAL_API
+
+    enum Colors
+    {
+        BLACK = false,
+        RED = true
+    };
+
+    enum Directions
+    {
+        LEFT = false,
+        RIGHT = true
+    };
+
+    // define a custom placement new operator to remove dependency on
+    // the std <new> header. cannot use allocator version because it expects
+    // type tnode. could add constructor to rbnode that accepts Key, but want
+    // rbnode to remain POD if possible; so construction is done here
+    class constructor
+    {
+    public:
+        Key t_;
+
+        inline constructor(const Key& t) : t_(t)
+        {
+        }
+
+        inline void* operator new (size_t size, void* ptr)
+        {
+            return ptr;
+        }
+
+        inline void operator delete (void *, void *)
+        {
+        }
+    };
+    
+    struct rbnode;
+
+    // plain pointers, or relative_ptr if the allocator's memory can move
+    typedef typename pointer_traits<Allocator>::template rebind<rbnode>::other
+        node_ptr;
+
+    struct rbnode
+    {
+        Key value;
+        bool color;
+        node_ptr parent;
+        node_ptr left;
+        node_ptr right;
+    };   
+
+    typedef typename Allocator::template rebind<rbnode>::other allocator_type;
+    typedef allocator_traits<allocator_type, rbnode> traits;
+
+    enum
+    {
+        // nodes need not be visited to destroy their values
+        TRIVIAL_DESTRUCTOR = __has_trivial_destructor(Key) | !__is_class(Key)
+    };
+
+    node_ptr root_;
+    // the functor and allocator take no space when they are empty
+    compressed_pair<size_t, compressed_pair<Compare, allocator_type> > size_;
+
+    inline Compare& compare()
+    {
+        return size_.second().first();
+    }
+
+    inline allocator_type& alloc()
+    {
+        return size_.second().second();
+    }
+
+    // inserts t, taking the node from chain if it is not empty
+    pair<iterator, bool> insert_unique(const Key& t, rbnode*& chain)
     {
         rbnode* pos = root_;
         rbnode* n = NULL;
 
         // try to find a duplicate
-        rbnode** child_link = &pos;
-        while(*child_link != NULL)
+        rbnode* next = pos;
+        while(next != NULL)
         {
-            pos = *child_link;
-            if(compare_(t, pos->value))
+            pos = next;
+            if(compare()(t, pos->value))
             {
-                child_link = &pos->left;
+                next = pos->left;
             }
-            else if(compare_(pos->value, t))
+            else if(compare()(pos->value, t))
             {
-                child_link = &pos->right;
+                next = pos->right;
             }
             else
             {
@@ -452,7 +624,15 @@ public:
         if(n == NULL)
         {
             // need to insert a new value
-            n = allocator_.allocate(1);
+            if(chain != NULL)
+            {
+                n = chain;
+                chain = traits::chain_next(chain);
+            }
+            else
+            {
+                n = alloc().allocate(1);
+            }
             new(static_cast<void*>(&n->value)) constructor(t);
             n->color = RED;
             n->left = NULL;
@@ -467,11 +647,16 @@ public:
             else
             {
                // standard BST insertion
-                rbnode*  parent = pos;
-                bool less = compare_(n->value, parent->value);
-                child_link = less ? &parent->left : &parent->right;
+                rbnode* parent = pos;
+                if(compare()(n->value, parent->value))
+                {
+                    parent->left = n;
+                }
+                else
+                {
+                    parent->right = n;
+                }
                 n->parent = parent;
-                *child_link = n;
 
                 // Walk back up the tree and re-balance
                 rbnode* child = parent;
@@ -495,72 +680,12 @@ public:
                 }
             }
             root_->color = BLACK;
-            ++size_;
+            ++size_.first();
         }
         pair<iterator, bool> result = { iterator(n), n != pos };
         return result;
     }
 
-    inline size_t size() const
-    {
-        return size_;
-    }
-
-#ifndef taapp_SET_INTERNAL_API
-private:
-#endif // taapp_SET_INTERNAL_API
-
-    enum Colors
-    {
-        BLACK = false,
-        RED = true
-    };
-
-    enum Directions
-    {
-        LEFT = false,
-        RIGHT = true
-    };
-
-    // define a custom placement new operator to remove dependency on
-    // the std <new> header. cannot use allocator version because it expects
-    // type tnode. could add constructor to rbnode that accepts Key, but want
-    // rbnode to remain POD if possible; so construction is done here
-    class constructor
-    {
-    public:
-        Key t_;
-
-        inline constructor(const Key& t) : t_(t)
-        {
-        }
-
-        inline void* operator new (size_t size, void* ptr)
-        {
-            return ptr;
-        }
-
-        inline void operator delete (void *, void *)
-        {
-        }
-    };
-    
-    struct rbnode
-    {
-        Key value;
-        bool color;
-        rbnode* parent;
-        rbnode* left;
-        rbnode* right;
-    };   
-
-    typedef typename Allocator::template rebind<rbnode>::other allocator_type;
-
-    rbnode* root_;
-    size_t size_;
-    Compare compare_;
-    allocator_type allocator_;
-
     template<bool Direction>
     rbnode* balance_erase(rbnode* root, rbnode* child)
     {
@@ -0,0 +1,309 @@
+/**
+ * @brief     C++ per instance slab allocator template implemenation
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_SLAB_ALLOCATOR_H_
+#define taapp_SLAB_ALLOCATOR_H_
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+namespace taapp
+{
+
+/**
+ * @brief allocator that carves single elements out of slabs it owns
+ * @details Each instance keeps its own chain of SlabSize byte slabs and a
+ * free list of returned elements. Since a container holds its own rebound
+ * copy of the allocator, its nodes are packed together in slabs that no
+ * other container shares. release_all() frees the slabs at once, which lets
+ * list, map, set and unordered_map clear trivially destructible values
+ * without visiting each node. Requests for more than one element, such as
+ * bucket arrays, go to malloc.
+ *
+ * Copies start with no slabs, and an instance only compares equal to
+ * itself, because memory from one instance cannot be freed by another.
+ */
+template<typename T, size_t SlabSize = 65536> class slab_allocator
+{
+public:
+
+    template<typename U> struct rebind
+    {
+        typedef slab_allocator<U, SlabSize> other;
+    };
+
+    inline slab_allocator() :
+#ifndef NDEBUG
+        counter_(0),
+#endif
+        slabs_(NULL),
+        free_(NULL),
+        bump_(NULL),
+        bumpend_(NULL)
+    {
+    }
+
+    inline slab_allocator(const slab_allocator&) :
+#ifndef NDEBUG
+        counter_(0),
+#endif
+        slabs_(NULL),
+        free_(NULL),
+        bump_(NULL),
+        bumpend_(NULL)
+    {
+    }
+
+    template<typename U>
+    inline slab_allocator(const slab_allocator<U, SlabSize>&) :
+#ifndef NDEBUG
+        counter_(0),
+#endif
+        slabs_(NULL),
+        free_(NULL),
+        bump_(NULL),
+        bumpend_(NULL)
+    {
+    }
+
+    ~slab_allocator()
+    {
+        assert(counter_ == 0);
+        free_slabs();
+    }
+
+    inline bool operator==(const slab_allocator& a) const
+    {
+        return this == &a;
+    }
+
+    inline bool operator!=(const slab_allocator& a) const
+    {
+        return this != &a;
+    }
+
+    // exchanges the slabs of two instances, along with the blocks in them
+    void swap(slab_allocator& other)
+    {
+#ifndef NDEBUG
+        int counter = counter_;
+        counter_ = other.counter_;
+        other.counter_ = counter;
+#endif
+        slab* slabs = slabs_;
+        slabs_ = other.slabs_;
+        other.slabs_ = slabs;
+        free_block* f = free_;
+        free_ = other.free_;
+        other.free_ = f;
+        char* bump = bump_;
+        bump_ = other.bump_;
+        other.bump_ = bump;
+        char* bumpend = bumpend_;
+        bumpend_ = other.bumpend_;
+        other.bumpend_ = bumpend;
+    }
+
+    // allocate but don't initialize num elements of type T
+    inline T* allocate (size_t n, const void* = 0)
+    {
+        void* p;
+        if(n != 1)
+        {
+            p = malloc(sizeof(T) * n);
+        }
+        else if(free_ != NULL)
+        {
+            p = free_;
+            free_ = free_->next;
+        }
+        else if(bump_ != bumpend_)
+        {
+            p = bump_;
+            bump_ += STRIDE;
+        }
+        else
+        {
+            p = refill();
+        }
+#ifndef NDEBUG
+        ++counter_;
+#endif
+        return static_cast<T*>(p);
+    }
+
+    // resize storage p from oldn to n elements, preserving its contents
+    T* reallocate(void* p, size_t oldn, size_t n)
+    {
+        if(p != NULL && oldn != 1 && n != 1)
+        {
+            return static_cast<T*>(realloc(p, sizeof(T) * n));
+        }
+        T* t = allocate(n);
+        if(t != NULL && p != NULL)
+        {
+            memcpy(t, p, sizeof(T) * ((oldn < n) ? oldn : n));
+            deallocate(static_cast<T*>(p), oldn);
+        }
+        return t;
+    }
+
+    // initialize elements of allocated storage p with value v
+    inline void construct (T* p, const T& v)
+    {
+        new(static_cast<void*>(p)) constructor(v);
+    }
+
+    // destroy but do not deallocate elements of initialized storage p
+    inline void destroy (T* p)
+    {
+        p->~T();
+    }
+
+    // deallocate storage p of deleted elements
+    inline void deallocate(T* p, size_t n)
+    {
+#ifndef NDEBUG
+        --counter_;
+#endif
+        if(n != 1)
+        {
+            free(p);
+        }
+        else if(p != NULL)
+        {
+            free_block* b = reinterpret_cast<free_block*>(p);
+            b->next = free_;
+            free_ = b;
+        }
+    }
+
+    /**
+     * @brief frees every slab at once
+     * @details all single elements from this instance become invalid.
+     * blocks of more than one element are not affected and must still be
+     * deallocated individually.
+     */
+    void release_all()
+    {
+        free_slabs();
+        free_ = NULL;
+        bump_ = NULL;
+        bumpend_ = NULL;
+#ifndef NDEBUG
+        counter_ = 0;
+#endif
+    }
+
+    // the number of slabs currently held
+    size_t slab_count() const
+    {
+        size_t count = 0;
+        for(slab* s = slabs_; s != NULL; s = s->next)
+        {
+            ++count;
+        }
+        return count;
+    }
+
+#ifndef taapp_SLAB_ALLOCATOR_INTERNAL_API
+private:
+#endif // taapp_SLAB_ALLOCATOR_INTERNAL_API
+
+    struct free_block
+    {
+        free_block* next;
+    };
+
+    // slab header, padded so the elements after it are aligned for malloc
+    struct slab
+    {
+        union
+        {
+            slab* next;
+            double align_;
+            char pad_[16];
+        };
+    };
+
+    enum
+    {
+        // elements hold the free list link once they are returned
+        STRIDE = (sizeof(T) < sizeof(free_block)) ?
+            sizeof(free_block) :
+            sizeof(T),
+        CAPACITY = (SlabSize > sizeof(slab) + STRIDE) ?
+            (SlabSize - sizeof(slab)) / STRIDE :
+            1
+    };
+
+    // define a custom placement new operator to remove dependency on
+    // the std <new> header
+    class constructor
+    {
+    public:
+        T t_;
+
+        inline constructor(const T& t) : t_(t)
+        {
+        }
+
+        inline void* operator new (size_t size, void* ptr)
+        {
+            return ptr;
+        }
+
+        inline void operator delete (void *, void *)
+        {
+        }
+    };
+
+#ifndef NDEBUG
+    int counter_;
+#endif
+    slab* slabs_;
+    free_block* free_;
+    char* bump_;
+    char* bumpend_;
+
+    // starts a new slab and returns its first element
+    void* refill()
+    {
+        slab* s = static_cast<slab*>(
+            malloc(sizeof(slab) + STRIDE * CAPACITY));
+        if(s == NULL)
+        {
+            return NULL;
+        }
+        s->next = slabs_;
+        slabs_ = s;
+        char* p = reinterpret_cast<char*>(s + 1);
+        bump_ = p + STRIDE;
+        bumpend_ = p + STRIDE * CAPACITY;
+        return p;
+    }
+
+    void free_slabs()
+    {
+        slab* s = slabs_;
+        while(s != NULL)
+        {
+            slab* next = s->next;
+            free(s);
+            s = next;
+        }
+        slabs_ = NULL;
+    }
+
+private:
+    // assignment would leave two instances owning the same slabs
+    slab_allocator& operator=(const slab_allocator&);
+};
+
+}
+
+#endif // taapp_SLAB_ALLOCATOR_H_
@@ -0,0 +1,437 @@
+/**
+ * @brief     C++ instrumented allocator template implemenation
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_STATS_ALLOCATOR_H_
+#define taapp_STATS_ALLOCATOR_H_
+
+#include "allocator.h"
+#include "allocator_traits.h"
+#include "atomic.h"
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+namespace taapp
+{
+
+/**
+ * @brief a snapshot of the allocations made through a stats_allocator tag
+ * @details size_histogram[k] counts allocations of more than 2^(k-1) and at
+ * most 2^k bytes. Reallocations are counted by their new size. bytes counts
+ * the usable size of each block when the allocator reports one, which may
+ * exceed the size requested.
+ */
+struct allocator_stats
+{
+    enum
+    {
+        SIZE_CLASSES = sizeof(size_t) * 8
+    };
+
+    size_t bytes;
+    size_t peak_bytes;
+    size_t live_allocations;
+    size_t allocations;
+    size_t reallocations;
+    size_t size_histogram[SIZE_CLASSES];
+};
+
+/**
+ * @brief allocation counters shared by every stats_allocator with tag Tag
+ * @details Each thread updates its own block of counters with plain
+ * relaxed stores, so recording an allocation costs a handful of
+ * uncontended writes and never a locked instruction. snapshot() sums the
+ * blocks of all threads. The byte total is also published to a shared
+ * counter whenever a thread's unpublished change exceeds FLUSH_BYTES,
+ * which is where the peak is tracked; the reported peak may therefore
+ * trail the true peak by up to FLUSH_BYTES per thread.
+ *
+ * The counts of a thread that exits stay in the totals, since the memory it
+ * allocated may still be live. On POSIX systems its block is released when
+ * it exits and adopted by the next thread that allocates, so there are
+ * never more blocks than threads alive at once. On Windows blocks are not
+ * recycled.
+ */
+template<typename Tag> class stats_counters
+{
+public:
+
+    enum
+    {
+        FLUSH_BYTES = 65536
+    };
+
+    static void snapshot(allocator_stats& s)
+    {
+        memset(&s, 0, sizeof(s));
+        ptrdiff_t bytes = 0;
+        ptrdiff_t live = 0;
+        block* b = atomic_load(&head());
+        while(b != NULL)
+        {
+            bytes += atomic_load_relaxed(&b->bytes);
+            live += atomic_load_relaxed(&b->live);
+            s.allocations += atomic_load_relaxed(&b->allocations);
+            s.reallocations += atomic_load_relaxed(&b->reallocations);
+            for(size_t i = 0; i < allocator_stats::SIZE_CLASSES; ++i)
+            {
+                s.size_histogram[i] +=
+                    atomic_load_relaxed(&b->size_histogram[i]);
+            }
+            b = b->next;
+        }
+        s.bytes = static_cast<size_t>(bytes);
+        s.live_allocations = static_cast<size_t>(live);
+        s.peak_bytes = atomic_load_relaxed(&peak());
+        if(s.peak_bytes < s.bytes)
+        {
+            s.peak_bytes = s.bytes;
+        }
+    }
+
+    // starts tracking a new peak from the current total
+    static void reset_peak()
+    {
+        allocator_stats s;
+        snapshot(s);
+        atomic_store(&peak(), s.bytes);
+    }
+
+    static inline void record_allocate(size_t size)
+    {
+        block* b = local();
+        add(&b->live, 1);
+        add(&b->allocations, 1);
+        add(&b->size_histogram[size_class(size)], 1);
+        add_bytes(b, static_cast<ptrdiff_t>(size));
+    }
+
+    static inline void record_reallocate(size_t oldsize, size_t size)
+    {
+        block* b = local();
+        add(&b->reallocations, 1);
+        add(&b->size_histogram[size_class(size)], 1);
+        add_bytes(
+            b,
+            static_cast<ptrdiff_t>(size) - static_cast<ptrdiff_t>(oldsize));
+    }
+
+    static inline void record_deallocate(size_t size)
+    {
+        block* b = local();
+        add(&b->live, -1);
+        add_bytes(b, -static_cast<ptrdiff_t>(size));
+    }
+
+#ifndef taapp_STATS_ALLOCATOR_INTERNAL_API
+private:
+#endif // taapp_STATS_ALLOCATOR_INTERNAL_API
+
+    struct block
+    {
+        block* next;
+        // net counts may go negative when memory is freed by another thread
+        volatile ptrdiff_t bytes;
+        volatile ptrdiff_t live;
+        volatile size_t allocations;
+        volatile size_t reallocations;
+        volatile size_t size_histogram[allocator_stats::SIZE_CLASSES];
+        // bytes not yet added to the shared total, only used by the owner
+        ptrdiff_t unflushed;
+        // nonzero while a thread owns the block
+        volatile int inuse;
+    };
+
+    // only the owning thread writes to its block, so no atomic
+    // read-modify-write is needed; relaxed accesses keep readers untorn
+    template<typename T, typename U>
+    static inline void add(volatile T* p, U v)
+    {
+        atomic_store_relaxed(p, static_cast<T>(atomic_load_relaxed(p) + v));
+    }
+
+    static inline void add_bytes(block* b, ptrdiff_t v)
+    {
+        add(&b->bytes, v);
+        b->unflushed += v;
+        if(b->unflushed > FLUSH_BYTES || b->unflushed < -FLUSH_BYTES)
+        {
+            flush(b);
+        }
+    }
+
+    static void flush(block* b)
+    {
+        ptrdiff_t total = atomic_fetch_add(&flushed(), b->unflushed);
+        total += b->unflushed;
+        b->unflushed = 0;
+        size_t p = atomic_load_relaxed(&peak());
+        while(total > 0 && static_cast<size_t>(total) > p)
+        {
+            if(atomic_compare_exchange(&peak(), p, static_cast<size_t>(total)))
+            {
+                break;
+            }
+        }
+    }
+
+    static inline size_t size_class(size_t size)
+    {
+        size_t k = 0;
+        if(size > 1)
+        {
+#if defined(__GNUC__)
+            k = sizeof(unsigned long) * 8 -
+                __builtin_clzl(static_cast<unsigned long>(size - 1));
+#else
+            --size;
+            while(size != 0)
+            {
+                ++k;
+                size >>= 1;
+            }
+#endif
+        }
+        return (k < allocator_stats::SIZE_CLASSES) ?
+            k : allocator_stats::SIZE_CLASSES - 1;
+    }
+
+    static inline block*& current()
+    {
+        static taapp_THREAD_LOCAL block* b = NULL;
+        return b;
+    }
+
+    static inline block* local()
+    {
+        block* b = current();
+        return (b != NULL) ? b : attach();
+    }
+
+    // claims a released block, or adds a new one to the list
+    static block* attach()
+    {
+        block* b = atomic_load(&head());
+        while(b != NULL)
+        {
+            int expected = 0;
+            if(atomic_load_relaxed(&b->inuse) == 0 &&
+                atomic_compare_exchange(&b->inuse, expected, 1))
+            {
+                break;
+            }
+            b = b->next;
+        }
+        if(b == NULL)
+        {
+            b = static_cast<block*>(calloc(1, sizeof(block)));
+            if(b == NULL)
+            {
+                abort();
+            }
+            b->inuse = 1;
+            block* h = atomic_load_relaxed(&head());
+            do
+            {
+                b->next = h;
+            }
+            while(!atomic_compare_exchange(&head(), h, b));
+        }
+#if !defined(_WIN32)
+        pthread_setspecific(exit_key(), b);
+#endif
+        current() = b;
+        return b;
+    }
+
+#if !defined(_WIN32)
+    // publishes the exiting thread's bytes and releases its block
+    static void detach(void* p)
+    {
+        block* b = static_cast<block*>(p);
+        current() = NULL;
+        flush(b);
+        atomic_store(&b->inuse, 0);
+    }
+
+    static void create_exit_key()
+    {
+        pthread_key_create(&exit_key_storage(), &stats_counters::detach);
+    }
+
+    static inline pthread_key_t& exit_key_storage()
+    {
+        static pthread_key_t key;
+        return key;
+    }
+
+    static inline pthread_key_t exit_key()
+    {
+        static pthread_once_t once = PTHREAD_ONCE_INIT;
+        pthread_once(&once, &stats_counters::create_exit_key);
+        return exit_key_storage();
+    }
+#endif
+
+    static inline block* volatile& head()
+    {
+        static block* volatile h = NULL;
+        return h;
+    }
+
+    static inline volatile ptrdiff_t& flushed()
+    {
+        static volatile ptrdiff_t f = 0;
+        return f;
+    }
+
+    static inline volatile size_t& peak()
+    {
+        static volatile size_t p = 0;
+        return p;
+    }
+};
+
+/**
+ * @brief allocator wrapper that records allocation statistics
+ * @details Every allocation made through Allocator is counted in the
+ * stats_counters of Tag, including those of node and bucket allocators
+ * obtained through rebind. Giving each container family its own tag type
+ * shows which containers hold memory at runtime, e.g.
+ * @code
+ * struct session_tag {};
+ * typedef stats_allocator<int, allocator<int>, session_tag> session_alloc;
+ * allocator_stats s;
+ * session_alloc::snapshot(s);
+ * @endcode
+ */
+template<typename T, typename Allocator = allocator<T>, typename Tag = void>
+class stats_allocator
+{
+public:
+
+    typedef stats_counters<Tag> counters;
+
+    template<typename U> struct rebind
+    {
+        typedef stats_allocator<
+            U,
+            typename Allocator::template rebind<U>::other,
+            Tag> other;
+    };
+
+    inline stats_allocator()
+    {
+    }
+
+    // wraps a copy of allocator a
+    inline explicit stats_allocator(const Allocator& a) : allocator_(a)
+    {
+    }
+
+    template<typename U, typename A>
+    inline stats_allocator(const stats_allocator<U, A, Tag>& a) :
+        allocator_(a.allocator_)
+    {
+    }
+
+    inline bool operator==(const stats_allocator& a) const
+    {
+        return allocator_ == a.allocator_;
+    }
+
+    inline bool operator!=(const stats_allocator& a) const
+    {
+        return allocator_ != a.allocator_;
+    }
+
+    inline void swap(stats_allocator& other)
+    {
+        allocator_traits<Allocator, T>::swap(allocator_, other.allocator_);
+    }
+
+    static inline void snapshot(allocator_stats& s)
+    {
+        counters::snapshot(s);
+    }
+
+    // allocate but don't initialize num elements of type T
+    inline T* allocate (size_t n, const void* hint = 0)
+    {
+        T* t = allocator_.allocate(n, hint);
+        if(t != NULL)
+        {
+            counters::record_allocate(usable_bytes(t, n));
+        }
+        return t;
+    }
+
+    // resize storage p from oldn to n elements, preserving its contents
+    inline T* reallocate(void* p, size_t oldn, size_t n)
+    {
+        size_t oldbytes =
+            (p != NULL) ? usable_bytes(static_cast<T*>(p), oldn) : 0;
+        T* t = allocator_.reallocate(p, oldn, n);
+        if(t != NULL)
+        {
+            if(p == NULL)
+            {
+                counters::record_allocate(usable_bytes(t, n));
+            }
+            else
+            {
+                counters::record_reallocate(oldbytes, usable_bytes(t, n));
+            }
+        }
+        return t;
+    }
+
+    // number of elements that fit in storage p allocated for n elements
+    inline size_t usable_size(T* p, size_t n)
+    {
+        return allocator_traits<Allocator, T>::usable_size(allocator_, p, n);
+    }
+
+    // initialize elements of allocated storage p with value v
+    inline void construct (T* p, const T& v)
+    {
+        allocator_.construct(p, v);
+    }
+
+    // destroy but do not deallocate elements of initialized storage p
+    inline void destroy (T* p)
+    {
+        allocator_.destroy(p);
+    }
+
+    // deallocate storage p of deleted elements
+    inline void deallocate(T* p, size_t n)
+    {
+        counters::record_deallocate(usable_bytes(p, n));
+        allocator_.deallocate(p, n);
+    }
+
+private:
+    Allocator allocator_;
+
+    // blocks are counted by their usable size, so the count is the same
+    // whether a container frees a block with the size it requested or
+    // with the larger size usable_size reported
+    inline size_t usable_bytes(T* p, size_t n)
+    {
+        return sizeof(T) * usable_size(p, n);
+    }
+
+    template<typename U, typename A, typename G> friend class stats_allocator;
+};
+
+}
+
+#endif // taapp_STATS_ALLOCATOR_H_
@@ -0,0 +1,376 @@
+/**
+ * @brief     minimal thread and synchronization primitives
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_THREAD_H_
+#define taapp_THREAD_H_
+
+#include <cassert>
+#include <cstddef>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+namespace taapp
+{
+
+/**
+ * @brief non-recursive mutual exclusion lock
+ */
+class mutex
+{
+public:
+
+    mutex()
+    {
+#if defined(_WIN32)
+        InitializeCriticalSection(&cs_);
+#else
+        pthread_mutex_init(&mutex_, NULL);
+#endif
+    }
+
+    ~mutex()
+    {
+#if defined(_WIN32)
+        DeleteCriticalSection(&cs_);
+#else
+        pthread_mutex_destroy(&mutex_);
+#endif
+    }
+
+    inline void lock()
+    {
+#if defined(_WIN32)
+        EnterCriticalSection(&cs_);
+#else
+        pthread_mutex_lock(&mutex_);
+#endif
+    }
+
+    inline bool try_lock()
+    {
+#if defined(_WIN32)
+        return TryEnterCriticalSection(&cs_) != 0;
+#else
+        return pthread_mutex_trylock(&mutex_) == 0;
+#endif
+    }
+
+    inline void unlock()
+    {
+#if defined(_WIN32)
+        LeaveCriticalSection(&cs_);
+#else
+        pthread_mutex_unlock(&mutex_);
+#endif
+    }
+
+private:
+
+#if defined(_WIN32)
+    CRITICAL_SECTION cs_;
+#else
+    pthread_mutex_t mutex_;
+#endif
+
+    friend class condition;
+
+    // noncopyable
+    mutex(const mutex&);
+    mutex& operator=(const mutex&);
+};
+
+/**
+ * @brief lock that admits many readers or a single writer
+ * @details readers call lock_shared and unlock_shared, and writers call
+ * lock and unlock. The lock is not recursive and cannot be upgraded.
+ */
+class rwlock
+{
+public:
+
+    rwlock()
+    {
+#if defined(_WIN32)
+        InitializeSRWLock(&lock_);
+#else
+        pthread_rwlock_init(&lock_, NULL);
+#endif
+    }
+
+    ~rwlock()
+    {
+#if !defined(_WIN32)
+        pthread_rwlock_destroy(&lock_);
+#endif
+    }
+
+    inline void lock()
+    {
+#if defined(_WIN32)
+        AcquireSRWLockExclusive(&lock_);
+#else
+        pthread_rwlock_wrlock(&lock_);
+#endif
+    }
+
+    inline void unlock()
+    {
+#if defined(_WIN32)
+        ReleaseSRWLockExclusive(&lock_);
+#else
+        pthread_rwlock_unlock(&lock_);
+#endif
+    }
+
+    inline void lock_shared()
+    {
+#if defined(_WIN32)
+        AcquireSRWLockShared(&lock_);
+#else
+        pthread_rwlock_rdlock(&lock_);
+#endif
+    }
+
+    inline void unlock_shared()
+    {
+#if defined(_WIN32)
+        ReleaseSRWLockShared(&lock_);
+#else
+        pthread_rwlock_unlock(&lock_);
+#endif
+    }
+
+private:
+
+#if defined(_WIN32)
+    SRWLOCK lock_;
+#else
+    pthread_rwlock_t lock_;
+#endif
+
+    // noncopyable
+    rwlock(const rwlock&);
+    rwlock& operator=(const rwlock&);
+};
+
+/**
+ * @brief holds a lock for the lifetime of the scope
+ * @details Lock may be any type with lock() and unlock() members.
+ */
+template<typename Lock> class scoped_lock
+{
+public:
+
+    inline explicit scoped_lock(Lock& l) : lock_(l)
+    {
+        lock_.lock();
+    }
+
+    inline ~scoped_lock()
+    {
+        lock_.unlock();
+    }
+
+private:
+    Lock& lock_;
+
+    // noncopyable
+    scoped_lock(const scoped_lock&);
+    scoped_lock& operator=(const scoped_lock&);
+};
+
+/**
+ * @brief holds a shared lock for the lifetime of the scope
+ * @details Lock may be any type with lock_shared() and unlock_shared()
+ * members.
+ */
+template<typename Lock> class shared_lock
+{
+public:
+
+    inline explicit shared_lock(Lock& l) : lock_(l)
+    {
+        lock_.lock_shared();
+    }
+
+    inline ~shared_lock()
+    {
+        lock_.unlock_shared();
+    }
+
+private:
+    Lock& lock_;
+
+    // noncopyable
+    shared_lock(const shared_lock&);
+    shared_lock& operator=(const shared_lock&);
+};
+
+/**
+ * @brief condition variable used together with taapp::mutex
+ * @details as with the native primitives, wait may return spuriously, so
+ * the predicate must be rechecked in a loop.
+ */
+class condition
+{
+public:
+
+    condition()
+    {
+#if defined(_WIN32)
+        InitializeConditionVariable(&cv_);
+#else
+        pthread_cond_init(&cv_, NULL);
+#endif
+    }
+
+    ~condition()
+    {
+#if !defined(_WIN32)
+        pthread_cond_destroy(&cv_);
+#endif
+    }
+
+    inline void broadcast()
+    {
+#if defined(_WIN32)
+        WakeAllConditionVariable(&cv_);
+#else
+        pthread_cond_broadcast(&cv_);
+#endif
+    }
+
+    inline void signal()
+    {
+#if defined(_WIN32)
+        WakeConditionVariable(&cv_);
+#else
+        pthread_cond_signal(&cv_);
+#endif
+    }
+
+    // m must be locked by the caller; it is locked again on return
+    inline void wait(mutex& m)
+    {
+#if defined(_WIN32)
+        SleepConditionVariableCS(&cv_, &m.cs_, INFINITE);
+#else
+        pthread_cond_wait(&cv_, &m.mutex_);
+#endif
+    }
+
+private:
+
+#if defined(_WIN32)
+    CONDITION_VARIABLE cv_;
+#else
+    pthread_cond_t cv_;
+#endif
+
+    // noncopyable
+    condition(const condition&);
+    condition& operator=(const condition&);
+};
+
+/**
+ * @brief a joinable thread of execution
+ * @details the thread must be joined before the object is destroyed.
+ */
+class thread
+{
+public:
+
+    typedef void (*function)(void* arg);
+
+    thread() : started_(false)
+    {
+    }
+
+    ~thread()
+    {
+        assert(!started_);
+    }
+
+    // starts func(arg) on a new thread. returns false if it failed to start
+    bool start(function func, void* arg)
+    {
+        assert(!started_);
+        func_ = func;
+        arg_ = arg;
+#if defined(_WIN32)
+        handle_ = CreateThread(NULL, 0, &thread::entry, this, 0, NULL);
+        started_ = handle_ != NULL;
+#else
+        started_ = pthread_create(&handle_, NULL, &thread::entry, this) == 0;
+#endif
+        return started_;
+    }
+
+    // the number of processors available to run threads, at least 1
+    static size_t hardware_concurrency()
+    {
+#if defined(_WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return (info.dwNumberOfProcessors > 0) ?
+            static_cast<size_t>(info.dwNumberOfProcessors) :
+            1;
+#else
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
+        return (count > 0) ? static_cast<size_t>(count) : 1;
+#endif
+    }
+
+    // waits for the thread function to return
+    void join()
+    {
+        assert(started_);
+#if defined(_WIN32)
+        WaitForSingleObject(handle_, INFINITE);
+        CloseHandle(handle_);
+#else
+        pthread_join(handle_, NULL);
+#endif
+        started_ = false;
+    }
+
+private:
+    function func_;
+    void* arg_;
+    bool started_;
+#if defined(_WIN32)
+    HANDLE handle_;
+
+    static DWORD WINAPI entry(LPVOID p)
+    {
+        thread* t = static_cast<thread*>(p);
+        t->func_(t->arg_);
+        return 0;
+    }
+#else
+    pthread_t handle_;
+
+    static void* entry(void* p)
+    {
+        thread* t = static_cast<thread*>(p);
+        t->func_(t->arg_);
+        return NULL;
+    }
+#endif
+
+    // noncopyable
+    thread(const thread&);
+    thread& operator=(const thread&);
+};
+
+}
+
+#endif // taapp_THREAD_H_
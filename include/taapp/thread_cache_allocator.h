@@ -0,0 +1,574 @@
+/**
+ * @brief     C++ thread caching allocator template implemenation
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taapp_THREAD_CACHE_ALLOCATOR_H_
+#define taapp_THREAD_CACHE_ALLOCATOR_H_
+
+#include "allocator_traits.h"
+#include "atomic.h"
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace taapp
+{
+
+/**
+ * @brief per-thread cache of small blocks
+ * @details Blocks of up to MAX_SIZE bytes are rounded up to a multiple of
+ * GRANULE and carved from SLAB_SIZE slabs, each of which serves a single
+ * size class and belongs to a single cache. A slab is aligned to its size,
+ * so the owner of any block is found by masking its address. Allocation
+ * and frees by the owning thread touch only that thread's free lists and
+ * take no locks. A block freed by any other thread is pushed onto the
+ * owner's lock-free remote free stack, which the owner drains in one atomic
+ * exchange when a free list runs dry.
+ *
+ * Caches are never destroyed, since other threads may still hold blocks
+ * they own. When a thread exits, its cache is parked on an orphan list and
+ * adopted by the next thread that needs one, so a pool of short lived
+ * threads reuses the same memory. On Windows caches are not recycled.
+ */
+class thread_cache
+{
+public:
+
+    enum
+    {
+        GRANULE = 16,
+        MAX_SIZE = 256,
+        SIZE_CLASSES = MAX_SIZE / GRANULE,
+        SLAB_SIZE = 65536
+    };
+
+    // returns the calling thread's cache, creating or adopting one if needed
+    static inline thread_cache* get()
+    {
+        thread_cache* c = current();
+        return (c != NULL) ? c : attach();
+    }
+
+    // allocates a block of 1 to MAX_SIZE bytes
+    inline void* allocate(size_t size)
+    {
+        size_t c = size_class(size);
+        free_block* b = free_[c];
+        if(b != NULL)
+        {
+            free_[c] = b->next;
+            return b;
+        }
+        return refill(c);
+    }
+
+    /**
+     * @brief allocates n blocks of size bytes in one call
+     * @details the blocks are linked through their first word and the chain
+     * is terminated by NULL. returns NULL if memory is exhausted.
+     */
+    void* allocate_bulk(size_t size, size_t n)
+    {
+        size_t c = size_class(size);
+        free_block* chain = NULL;
+        while(n > 0)
+        {
+            free_block* b = free_[c];
+            if(b != NULL)
+            {
+                free_[c] = b->next;
+            }
+            else
+            {
+                b = static_cast<free_block*>(refill(c));
+                if(b == NULL)
+                {
+                    deallocate_bulk(chain);
+                    return NULL;
+                }
+            }
+            b->next = chain;
+            chain = b;
+            --n;
+        }
+        return chain;
+    }
+
+    // frees a chain of blocks linked through their first word
+    static void deallocate_bulk(void* chain)
+    {
+        free_block* b = static_cast<free_block*>(chain);
+        while(b != NULL)
+        {
+            free_block* next = b->next;
+            deallocate(b);
+            b = next;
+        }
+    }
+
+    // frees a block allocated by any thread's cache
+    static inline void deallocate(void* p)
+    {
+        slab* s = slab_of(p);
+        thread_cache* c = s->owner;
+        free_block* b = static_cast<free_block*>(p);
+        if(c == current())
+        {
+            b->next = c->free_[s->sizeclass];
+            c->free_[s->sizeclass] = b;
+        }
+        else
+        {
+            c->push_remote(b);
+        }
+    }
+
+#ifndef taapp_THREAD_CACHE_INTERNAL_API
+private:
+#endif // taapp_THREAD_CACHE_INTERNAL_API
+
+    enum
+    {
+        CACHE_LINE = 64,
+        SLAB_HEADER = CACHE_LINE
+    };
+
+    struct free_block
+    {
+        free_block* next;
+    };
+
+    // occupies the first SLAB_HEADER bytes of every slab
+    struct slab
+    {
+        thread_cache* owner;
+        size_t sizeclass;
+    };
+
+    // owned by the thread using the cache
+    free_block* free_[SIZE_CLASSES];
+    char* bump_[SIZE_CLASSES];
+    char* bumpend_[SIZE_CLASSES];
+    thread_cache* nextorphan_;
+    // written by other threads, so kept off the owner's cache lines
+    char pad_[CACHE_LINE];
+    free_block* volatile remote_;
+    char pad2_[CACHE_LINE - sizeof(free_block*)];
+
+    static inline size_t size_class(size_t size)
+    {
+        assert(size <= MAX_SIZE);
+        return (size > 0) ? (size - 1) / GRANULE : 0;
+    }
+
+    static inline slab* slab_of(void* p)
+    {
+        return reinterpret_cast<slab*>(
+            reinterpret_cast<size_t>(p) & ~static_cast<size_t>(SLAB_SIZE - 1));
+    }
+
+    static inline thread_cache*& current()
+    {
+        static taapp_THREAD_LOCAL thread_cache* cache = NULL;
+        return cache;
+    }
+
+    static inline spinlock& orphan_lock()
+    {
+        static spinlock lock = { 0 };
+        return lock;
+    }
+
+    static inline thread_cache*& orphans()
+    {
+        static thread_cache* head = NULL;
+        return head;
+    }
+
+    static thread_cache* attach()
+    {
+        thread_cache* c;
+        orphan_lock().lock();
+        c = orphans();
+        if(c != NULL)
+        {
+            orphans() = c->nextorphan_;
+        }
+        orphan_lock().unlock();
+        if(c == NULL)
+        {
+            c = static_cast<thread_cache*>(aligned_malloc(
+                sizeof(thread_cache),
+                CACHE_LINE));
+            if(c == NULL)
+            {
+                return NULL;
+            }
+            memset(c, 0, sizeof(*c));
+        }
+#if !defined(_WIN32)
+        pthread_setspecific(exit_key(), c);
+#endif
+        current() = c;
+        return c;
+    }
+
+#if !defined(_WIN32)
+    static void detach(void* p)
+    {
+        thread_cache* c = static_cast<thread_cache*>(p);
+        // frees made later during thread teardown must go through the remote
+        // stack, since the cache may be adopted by another thread right away
+        current() = NULL;
+        orphan_lock().lock();
+        c->nextorphan_ = orphans();
+        orphans() = c;
+        orphan_lock().unlock();
+    }
+
+    static void create_exit_key()
+    {
+        pthread_key_create(&exit_key_storage(), &thread_cache::detach);
+    }
+
+    static inline pthread_key_t& exit_key_storage()
+    {
+        static pthread_key_t key;
+        return key;
+    }
+
+    static inline pthread_key_t exit_key()
+    {
+        static pthread_once_t once = PTHREAD_ONCE_INIT;
+        pthread_once(&once, &thread_cache::create_exit_key);
+        return exit_key_storage();
+    }
+#endif
+
+    static inline void* aligned_malloc(size_t size, size_t alignment)
+    {
+#if defined(_WIN32)
+        return _aligned_malloc(size, alignment);
+#else
+        void* p;
+        return (posix_memalign(&p, alignment, size) == 0) ? p : NULL;
+#endif
+    }
+
+    void drain_remote()
+    {
+        free_block* b = atomic_exchange(&remote_, static_cast<free_block*>(0));
+        while(b != NULL)
+        {
+            free_block* next = b->next;
+            size_t c = slab_of(b)->sizeclass;
+            b->next = free_[c];
+            free_[c] = b;
+            b = next;
+        }
+    }
+
+    void push_remote(free_block* b)
+    {
+        free_block* head = atomic_load_relaxed(&remote_);
+        do
+        {
+            b->next = head;
+        }
+        while(!atomic_compare_exchange(&remote_, head, b));
+    }
+
+    // slow path of allocate, taken when the free list of class c is empty
+    void* refill(size_t c)
+    {
+        if(atomic_load_relaxed(&remote_) != NULL)
+        {
+            drain_remote();
+            free_block* b = free_[c];
+            if(b != NULL)
+            {
+                free_[c] = b->next;
+                return b;
+            }
+        }
+        size_t size = (c + 1) * GRANULE;
+        if(static_cast<size_t>(bumpend_[c] - bump_[c]) < size)
+        {
+            slab* s = static_cast<slab*>(aligned_malloc(SLAB_SIZE, SLAB_SIZE));
+            if(s == NULL)
+            {
+                return NULL;
+            }
+            s->owner = this;
+            s->sizeclass = c;
+            bump_[c] = reinterpret_cast<char*>(s) + SLAB_HEADER;
+            bumpend_[c] = reinterpret_cast<char*>(s) + SLAB_SIZE;
+        }
+        void* p = bump_[c];
+        bump_[c] += size;
+        return p;
+    }
+};
+
+/**
+ * @brief allocator that serves small blocks from per-thread caches
+ * @details Node allocations of containers owned by different threads never
+ * contend on a shared lock. Any instance may free a block allocated by any
+ * other instance on any thread. Requests larger than thread_cache::MAX_SIZE
+ * bytes, such as vector buffers and hash table bucket arrays, go to malloc.
+ */
+template<typename T> class thread_cache_allocator
+{
+public:
+
+    template<typename U> struct rebind
+    {
+        typedef thread_cache_allocator<U> other;
+    };
+
+    inline thread_cache_allocator()
+#ifndef NDEBUG
+        : counter_(0)
+#endif
+    {
+    }
+
+#ifndef NDEBUG
+    inline thread_cache_allocator(const thread_cache_allocator&) : counter_(0)
+    {
+    }
+#endif
+
+    template<typename U>
+    inline thread_cache_allocator(const thread_cache_allocator<U>&)
+#ifndef NDEBUG
+        : counter_(0)
+#endif
+    {
+    }
+
+#ifndef NDEBUG
+    ~thread_cache_allocator()
+    {
+        assert(counter_ == 0);
+    }
+#endif
+
+    inline bool operator==(const thread_cache_allocator&) const
+    {
+        return true;
+    }
+
+    inline bool operator!=(const thread_cache_allocator&) const
+    {
+        return false;
+    }
+
+    // exchanges the state of two instances, so that each keeps counting
+    // the blocks it handed out
+    inline void swap(thread_cache_allocator& other)
+    {
+#ifndef NDEBUG
+        int counter = counter_;
+        counter_ = other.counter_;
+        other.counter_ = counter;
+#endif
+    }
+
+    // allocate but don't initialize num elements of type T
+    inline T* allocate (size_t n, const void* = 0)
+    {
+        size_t size = sizeof(T) * n;
+        T* t = static_cast<T*>(is_cached(size) ?
+            thread_cache::get()->allocate(size) :
+            malloc(size));
+#ifndef NDEBUG
+        ++counter_;
+#endif
+        return t;
+    }
+
+    // allocate n blocks of one T each, linked through their first word
+    T* allocate_bulk(size_t n)
+    {
+        typedef allocator_traits<thread_cache_allocator, T> traits;
+        T* chain = NULL;
+        if(is_cached(sizeof(T)))
+        {
+            chain = static_cast<T*>(
+                thread_cache::get()->allocate_bulk(sizeof(T), n));
+        }
+        else
+        {
+            for(size_t i = 0; i < n; ++i)
+            {
+                T* t = static_cast<T*>(malloc(sizeof(T)));
+                if(t == NULL)
+                {
+                    while(chain != NULL)
+                    {
+                        t = traits::chain_next(chain);
+                        free(chain);
+                        chain = t;
+                    }
+                    return NULL;
+                }
+                traits::set_chain_next(t, chain);
+                chain = t;
+            }
+        }
+#ifndef NDEBUG
+        if(chain != NULL)
+        {
+            counter_ += static_cast<int>(n);
+        }
+#endif
+        return chain;
+    }
+
+    // resize storage p from oldn to n elements, preserving its contents
+    T* reallocate(void* p, size_t oldn, size_t n)
+    {
+        size_t oldsize = sizeof(T) * oldn;
+        size_t size = sizeof(T) * n;
+        void* t;
+        if(p == NULL)
+        {
+            t = allocate(n);
+        }
+        else if(!is_cached(oldsize) && !is_cached(size))
+        {
+            t = realloc(p, size);
+        }
+        else
+        {
+            t = is_cached(size) ?
+                thread_cache::get()->allocate(size) :
+                malloc(size);
+            if(t != NULL)
+            {
+                memcpy(t, p, (oldsize < size) ? oldsize : size);
+                release(p, oldsize);
+            }
+        }
+        return static_cast<T*>(t);
+    }
+
+    // number of elements that fit in storage p allocated for n elements
+    inline size_t usable_size(T* p, size_t n)
+    {
+        size_t size = sizeof(T) * n;
+        if(is_cached(size))
+        {
+            // blocks are rounded up to their size class
+            size = (size > 0) ?
+                (size + thread_cache::GRANULE - 1) &
+                    ~static_cast<size_t>(thread_cache::GRANULE - 1) :
+                thread_cache::GRANULE;
+        }
+        else
+        {
+            size = heap_usable_size(p, size);
+        }
+        return size / sizeof(T);
+    }
+
+    // initialize elements of allocated storage p with value v
+    inline void construct (T* p, const T& v)
+    {
+        new(static_cast<void*>(p)) constructor(v);
+    }
+
+    // destroy but do not deallocate elements of initialized storage p
+    inline void destroy (T* p)
+    {
+        p->~T();
+    }
+
+    // deallocate a chain of n blocks from allocate_bulk or allocate(1)
+    void deallocate_bulk(T* chain, size_t n)
+    {
+        typedef allocator_traits<thread_cache_allocator, T> traits;
+#ifndef NDEBUG
+        counter_ -= static_cast<int>(n);
+#endif
+        if(is_cached(sizeof(T)))
+        {
+            thread_cache::deallocate_bulk(chain);
+        }
+        else
+        {
+            while(chain != NULL)
+            {
+                T* next = traits::chain_next(chain);
+                free(chain);
+                chain = next;
+            }
+        }
+    }
+
+    // deallocate storage p of deleted elements
+    inline void deallocate(T* p, size_t n)
+    {
+#ifndef NDEBUG
+        --counter_;
+#endif
+        release(p, sizeof(T) * n);
+    }
+
+private:
+
+#ifndef NDEBUG
+    int counter_;
+#endif
+
+    // define a custom placement new operator to remove dependency on
+    // the std <new> header
+    class constructor
+    {
+    public:
+        T t_;
+
+        inline constructor(const T& t) : t_(t)
+        {
+        }
+
+        inline void* operator new (size_t size, void* ptr)
+        {
+            return ptr;
+        }
+
+        inline void operator delete (void *, void *)
+        {
+        }
+    };
+
+    static inline bool is_cached(size_t size)
+    {
+        return size <= thread_cache::MAX_SIZE;
+    }
+
+    static inline void release(void* p, size_t size)
+    {
+        if(!is_cached(size))
+        {
+            free(p);
+        }
+        else if(p != NULL)
+        {
+            thread_cache::deallocate(p);
+        }
+    }
+};
+
+}
+
+#endif // taapp_THREAD_CACHE_ALLOCATOR_H_
@@ -7,23 +7,81 @@
 #ifndef taapp_UNORDERED_MAP_H_
 #define taapp_UNORDERED_MAP_H_
 
+#include "allocator.h"
+#include "allocator_traits.h"
+#include "compressed_pair.h"
+#include "hash.h"
 #include "pair.h"
 #include <cassert>
 #include <cstddef>
 
+#ifdef taapp_UNORDERED_MAP_COUNT_PROBES
+#include "atomic.h"
+#endif
+
 namespace taapp
 {
 
+/**
+ * @brief the shape of a hash map's buckets, as reported by stats()
+ * @details the probes counted are the items whose keys are compared. a
+ * long max_chain or probes_hit far above 1 + load_factor / 2 points at a
+ * poor hash; probes_miss near the load factor with short chains points at
+ * a table that is merely full.
+ */
+struct hash_stats
+{
+    enum
+    {
+        HISTOGRAM = 16
+    };
+
+    size_t size;
+    size_t bucket_count;
+    size_t empty_buckets;
+    size_t max_chain;
+    // the mean length of the chains that are not empty
+    float mean_chain;
+    // buckets holding i items. the last entry counts longer chains too
+    size_t histogram[HISTOGRAM];
+    // expected probes of a find that succeeds, for a key chosen uniformly
+    float probes_hit;
+    // expected probes of a find that fails, the mean length of every chain
+    float probes_miss;
+    // lookups and their probes counted while the map was used, if it was
+    // compiled with taapp_UNORDERED_MAP_COUNT_PROBES. zero otherwise
+    size_t counted_hits;
+    size_t counted_hit_probes;
+    size_t counted_misses;
+    size_t counted_miss_probes;
+};
+
 /**
  * @brief hash map
  * @details This class is a subset of std::tr1::unordered_map. It is
- * implemented as a table of double ended linked lists.
+ * implemented as a table of singly linked lists: each bucket is a single
+ * pointer to the head of its chain, and erase finds the predecessor of the
+ * erased item by walking its chain, in the same walk that finds the key
+ * when erasing by key. Hash and Pred default to the functors in hash.h.
+ *
+ * If Ordered is true, every item is also linked into one list in the order
+ * it was inserted, which costs two more pointers per item. Iteration then
+ * follows that list, so begin() and operator++ take constant time however
+ * many buckets are empty, and items are visited in insertion order.
+ * Assigning to an existing key keeps its place.
+ *
+ * If taapp_UNORDERED_MAP_COUNT_PROBES is defined, each map counts the
+ * lookups it performs and the items each compares, for stats() to report.
+ * The macro must be defined alike in every translation unit. The counts are
+ * kept with relaxed atomic adds, since const lookups may run concurrently,
+ * as they do under the shared lock of concurrent_unordered_map.
  */
 template<typename Key,
          typename T,
-         typename Hash,
-         typename Pred,
-         typename Alloc>
+         typename Hash = hash<Key>,
+         typename Pred = equal_to<Key>,
+         typename Alloc = allocator<pair<Key, T> >,
+         bool Ordered = false>
 class unordered_map
 {
 public:
@@ -70,26 +128,10 @@ public:
 
         inline iterator& operator++()
         {
-            struct unordered_map::tnode* n = node_;
-            n = n->node.tnext;
-            if(static_cast<const void*>(n)==static_cast<const void*>(bucket_))
-            {
-                struct unordered_map::anode* b = bucket_;
-                struct unordered_map::anode* bend = bucketend_;
-                n = NULL;
-                ++b;
-                while(b != bend)
-                {
-                    if(b->anext != b)
-                    {
-                        n = b->tnext;
-                        break;
-                    }
-                    ++b;
-                }
-                bucket_ = b;
-            }
-            node_ = n;
+            node_ = unordered_map::order_list::advance(
+                node_,
+                bucket_,
+                bucketend_);
             return *this;
         }
 
@@ -106,13 +148,13 @@ public:
     private:
 
         struct unordered_map::tnode* node_;
-        struct unordered_map::anode* bucket_;
-        struct unordered_map::anode* bucketend_;
+        struct unordered_map::bucket* bucket_;
+        struct unordered_map::bucket* bucketend_;
 
         inline explicit iterator(
             struct unordered_map::tnode* node,
-            struct unordered_map::anode* bucket,
-            struct unordered_map::anode* bucketend)
+            struct unordered_map::bucket* bucket,
+            struct unordered_map::bucket* bucketend)
             :
             node_(node),
             bucket_(bucket),
@@ -121,15 +163,15 @@ public:
         }
 
         inline explicit iterator(
-            struct unordered_map::anode* bucket,
-            struct unordered_map::anode* bucketend)
+            struct unordered_map::bucket* bucket,
+            struct unordered_map::bucket* bucketend)
         {
             node_ = NULL;
             while(bucket != bucketend)
             {
-                if(bucket->anext != bucket)
+                node_ = bucket->head;
+                if(node_ != NULL)
                 {
-                    node_ = bucket->tnext;
                     break;
                 }
                 ++bucket;
@@ -205,28 +247,12 @@ public:
             return *this;
         }
 
-        inline iterator& operator++()
+        inline const_iterator& operator++()
         {
-            const struct unordered_map::tnode* n = node_;
-            n = n->tnext;
-            if(static_cast<const void*>(n)==static_cast<const void*>(bucket_))
-            {
-                const struct unordered_map::anode* b = bucket_;
-                const struct unordered_map::anode* bend = bucketend_;
-                n = NULL;
-                ++b;
-                while(b != bend)
-                {
-                    if(b->anext != b)
-                    {
-                        n = b->tnext;
-                        break;
-                    }
-                    ++b;
-                }
-                bucket_ = b;
-            }
-            node_ = n;
+            node_ = unordered_map::order_list::advance(
+                node_,
+                bucket_,
+                bucketend_);
             return *this;
         }
 
@@ -243,13 +269,13 @@ public:
     private:
 
         const struct unordered_map::tnode* node_;
-        const struct unordered_map::anode* bucket_;
-        const struct unordered_map::anode* bucketend_;
+        const struct unordered_map::bucket* bucket_;
+        const struct unordered_map::bucket* bucketend_;
 
         inline explicit const_iterator(
             const struct unordered_map::tnode* node,
-            const struct unordered_map::anode* bucket,
-            const struct unordered_map::anode* bucketend)
+            const struct unordered_map::bucket* bucket,
+            const struct unordered_map::bucket* bucketend)
             :
             node_(node),
             bucket_(bucket),
@@ -258,15 +284,15 @@ public:
         }
 
         inline explicit const_iterator(
-            const struct unordered_map::anode* bucket,
-            const struct unordered_map::anode* bucketend)
+            const struct unordered_map::bucket* bucket,
+            const struct unordered_map::bucket* bucketend)
         {
             node_ = NULL;
             while(bucket != bucketend)
             {
-                if(bucket->anext != bucket)
+                node_ = bucket->head;
+                if(node_ != NULL)
                 {
-                    node_ = bucket->tnext;
                     break;
                 }
                 ++bucket;
@@ -279,7 +305,27 @@ public:
     };
 
     unordered_map() :
-        buckets_(NULL), numbuckets_(0), size_(0), max_load_factor_(1.0f)
+        buckets_(NULL),
+        numbuckets_(0),
+        size_(0, order_list()),
+        functors_()
+    {
+    }
+
+    // constructs an empty map whose nodes and buckets come from copies of a
+    explicit unordered_map(const Alloc& a) :
+        buckets_(NULL),
+        numbuckets_(0),
+        size_(0, order_list()),
+        functors_(Hash(), Pred(), a)
+    {
+    }
+
+    unordered_map(const Hash& h, const Pred& eq, const Alloc& a) :
+        buckets_(NULL),
+        numbuckets_(0),
+        size_(0, order_list()),
+        functors_(h, eq, a)
     {
     }
 
@@ -288,39 +334,72 @@ public:
         if(buckets_ != NULL)
         {
             clear();
-            bucketallocator_.deallocate(buckets_, numbuckets_);
+            bucket_alloc().deallocate(buckets_, numbuckets_);
         }
     }
 
     const_iterator begin() const
     {
+        if(Ordered)
+        {
+            return const_iterator(order().front(), NULL, NULL);
+        }
         return const_iterator(buckets_, buckets_+numbuckets_);
     }
 
     iterator begin()
     {
+        if(Ordered)
+        {
+            return iterator(order().front(), NULL, NULL);
+        }
         return iterator(buckets_, buckets_+numbuckets_);
     }
 
+    size_t bucket_count() const
+    {
+        return numbuckets_;
+    }
+
+    // the number of items in bucket n
+    size_t bucket_size(size_t n) const
+    {
+        assert(n < numbuckets_);
+        return chain_length(buckets_ + n);
+    }
+
     void clear()
     {
+        // the allocator can free every node without walking the buckets
+        bool release = traits::HAS_RELEASE_ALL && TRIVIAL_DESTRUCTOR;
+        tnode* chain = NULL;
         bucket_type* bitr = buckets_;
         bucket_type* bend = bitr + numbuckets_;
         while(bitr != bend)
         {
-            tnode* n = bitr->tnext;
-            while(static_cast<void*>(n) != static_cast<void*>(bitr))
+            tnode* n = bitr->head;
+            while(!release && n != NULL)
             {
-                tnode* next = n->node.tnext;
+                tnode* next = n->next;
                 n->value.~value_type();
-                allocator_.deallocate(n, 1);
+                traits::set_chain_next(n, chain);
+                chain = n;
                 n = next;
             }
-            bitr->aprev = bitr;
-            bitr->anext = bitr;
+            bitr->head = NULL;
             ++bitr;
         }
-        size_ = 0;
+        if(release)
+        {
+            traits::release_all(alloc());
+        }
+        else
+        {
+            // return all of the nodes to the allocator at once
+            traits::deallocate_chain(alloc(), chain, size_.first());
+        }
+        size_.first() = 0;
+        order().clear();
     }
 
     const_iterator end() const
@@ -333,23 +412,41 @@ public:
         return iterator();
     }
 
-    inline size_t erase(const Key& k)
+    // walks the chain once, keeping the link to the item so it can be
+    // unlinked without a second walk
+    size_t erase(const Key& k)
     {
-        iterator itr(find(k));
-        bool found = itr.node_ != NULL;
-        if(found)
+        if(buckets_ == NULL)
+        {
+            return 0;
+        }
+        tnode_ptr* link = &get_bucket(k)->head;
+        size_t probes = 0;
+        while(*link != NULL)
         {
-            erase(itr);
+            tnode* n = *link;
+            ++probes;
+            if(equals()(k, n->value.first))
+            {
+                count_lookup(true, probes);
+                *link = n->next;
+                destroy_node(n);
+                return 1;
+            }
+            link = &n->next;
         }
-        return found;
+        count_lookup(false, probes);
+        return 0;
     }
 
     void erase(iterator itr)
     {
-        bucket_erase(itr.bucket_, itr.node_);
-        itr.node_->value.~value_type();
-        allocator_.deallocate(itr.node_, 1);
-        --size_;
+        // ordered iterators forget their bucket once they are advanced
+        bucket_type* b = (itr.bucket_ != NULL) ?
+            itr.bucket_ :
+            get_bucket(itr.node_->value.first);
+        bucket_erase(b, itr.node_);
+        destroy_node(itr.node_);
     }
 
     const_iterator find(const Key& k) const
@@ -358,18 +455,21 @@ public:
         if(buckets_ != NULL)
         {
             const bucket_type* b = get_bucket(k);
-            const tnode* n = b->tnext;
-            while(static_cast<const void*>(n) != static_cast<const void*>(b))
+            const tnode* n = b->head;
+            size_t probes = 0;
+            while(n != NULL)
             {
-                if(equals_(k, n->value.first))
+                ++probes;
+                if(equals()(k, n->value.first))
                 {
                     result.node_ = n;
                     result.bucket_ = b;
                     result.bucketend_ = buckets_ + numbuckets_;
                     break;
                 }
-                n = n->node.tnext;
+                n = n->next;
             }
+            count_lookup(result.node_ != NULL, probes);
         }
         return result;
     }
@@ -380,89 +480,191 @@ public:
         if(buckets_ != NULL)
         {
             bucket_type* b = get_bucket(k);
-            tnode* n = b->tnext;
-            while(static_cast<const void*>(n) != static_cast<const void*>(b))
+            tnode* n = b->head;
+            size_t probes = 0;
+            while(n != NULL)
             {
-                if(equals_(k, n->value.first))
+                ++probes;
+                if(equals()(k, n->value.first))
                 {
                     result.node_ = n;
                     result.bucket_ = b;
                     result.bucketend_ = buckets_ + numbuckets_;
                     break;
                 }
-                n = n->node.tnext;
+                n = n->next;
             }
+            count_lookup(result.node_ != NULL, probes);
         }
         return result;
     }
 
+    /**
+     * @brief finds each of the n keys, storing an iterator for keys[i] in
+     * out[i]
+     * @details the lookups are pipelined so that their cache misses
+     * overlap: while key i is compared, the first node of the bucket for key
+     * i + PREFETCH_DISTANCE and the bucket for key i + 2 * PREFETCH_DISTANCE
+     * are being fetched. this is much faster than calling find() in a loop
+     * when the table does not fit in cache.
+     */
+    void find_many(const Key* keys, size_t n, const_iterator* out) const
+    {
+        find_pipelined(keys, n, out);
+    }
+
+    void find_many(const Key* keys, size_t n, iterator* out)
+    {
+        find_pipelined(keys, n, out);
+    }
+
+    // a copy of the allocator the map was constructed with
+    inline Alloc get_allocator() const
+    {
+        return Alloc(functors_.alloc());
+    }
+
+    // a copy of the hash functor the map was constructed with
+    inline Hash hash_function() const
+    {
+        return hasher();
+    }
+
     pair<iterator, bool> insert(const value_type& v)
     {
-        pair<iterator, bool> result = { find(v.first), false };
-        if(result.first.node_ == NULL)
+        tnode* chain = NULL;
+        return insert_unique(v, chain);
+    }
+
+    /**
+     * @brief inserts the values in the range [first, last)
+     * @details the table is resized once up front to hold the whole range.
+     * if the allocator supports allocate_bulk, the nodes are allocated in
+     * one call, and any left unused by duplicate keys are returned in one
+     * call.
+     */
+    void insert(const value_type* first, const value_type* last)
+    {
+        size_t count = static_cast<size_t>(last - first);
+        size_t mincount = min_bucket_count(size_.first() + count);
+        if(mincount > numbuckets_)
         {
-            // key does not exist in the map
-            if(size_ == 0 || load_factor() >= max_load_factor_)
-            {
-                rehash(calc_table_size(numbuckets_ + 1));
-            }
-            bucket_type* b = get_bucket(v.first);
-            tnode* n = allocator_.allocate(1);
-            new(static_cast<void*>(&n->value)) constructor(v);
-            bucket_push(b, n);
-            result.first.node_ = n;
-            result.first.bucket_ = b;
-            result.first.bucketend_ = buckets_ + numbuckets_;
-            result.second = true;
-            ++size_;
+            rehash(calc_table_size(mincount));
+        }
+        tnode* chain = traits::HAS_ALLOCATE_BULK ?
+            traits::allocate_chain(alloc(), count) :
+            NULL;
+        while(first != last)
+        {
+            insert_unique(*first, chain);
+            ++first;
+        }
+        if(chain != NULL)
+        {
+            // the chain may have come back short, so count what is left
+            traits::deallocate_chain(
+                alloc(),
+                chain,
+                traits::chain_length(chain));
+        }
+    }
+
+    /**
+     * @brief inserts t with key k, or assigns t to the existing value of k
+     * @details the key is hashed once. second is true if k was inserted.
+     */
+    pair<iterator, bool> insert_or_assign(const Key& k, const T& t)
+    {
+        tnode* chain = NULL;
+        pair<iterator, bool> result = find_or_allocate(k, chain);
+        if(result.second)
+        {
+            construct_value(result.first.node_, k, t);
+        }
+        else
+        {
+            result.first.node_->value.second = t;
         }
         return result;
     }
 
+    // a copy of the equality functor the map was constructed with
+    inline Pred key_eq() const
+    {
+        return equals();
+    }
+
     float load_factor() const
     {
-        return static_cast<float>(size_)/static_cast<float>(numbuckets_);
+        float size = static_cast<float>(size_.first());
+        return size / static_cast<float>(numbuckets_);
+    }
+
+    inline float max_load_factor() const
+    {
+        return functors_.max_load_factor;
     }
 
     void max_load_factor(float z)
     {
-        max_load_factor_ = z;
-        if(load_factor() > max_load_factor_)
+        functors_.max_load_factor = z;
+        if(load_factor() > functors_.max_load_factor)
         {
             rehash(calc_table_size(numbuckets_ + 1));
         }
     }
 
+    // the value of k, default constructed and inserted if k is absent
+    T& operator[](const Key& k)
+    {
+        return try_emplace(k).first->second;
+    }
+
+    /**
+     * @brief sets the number of buckets in the table to count
+     * @details count is raised if necessary to keep load_factor() within
+     * max_load_factor(), so the table shrinks if count is less than the
+     * current bucket count. an empty table releases its buckets entirely on
+     * rehash(0).
+     */
     void rehash(size_t count)
     {
         bucket_type* oldbuckets = buckets_;
         size_t oldnumbuckets = numbuckets_;
-        if(count > oldnumbuckets)
+        size_t mincount = min_bucket_count();
+        if(count < mincount)
         {
-            buckets_ = bucketallocator_.allocate(count);
+            count = mincount;
+        }
+        if(count != oldnumbuckets)
+        {
+            buckets_ = NULL;
             numbuckets_ = count;
-            // initialize the new buckets
-            bucket_type* b = buckets_;
-            bucket_type* bend = buckets_ + count;
-            while(b != bend)
+            if(count > 0)
             {
-                b->aprev = b;
-                b->anext = b;
-                ++b;
+                buckets_ = bucket_alloc().allocate(count);
+                // initialize the new buckets
+                bucket_type* b = buckets_;
+                bucket_type* bend = buckets_ + count;
+                while(b != bend)
+                {
+                    b->head = NULL;
+                    ++b;
+                }
             }
-            if(size_ > 0)
+            if(size_.first() > 0)
             {
                 bucket_type* b = oldbuckets;
                 bucket_type* bend = oldbuckets + oldnumbuckets;
                 while(b != bend)
                 {
                     // move everything from the old table to the new one
-                    while(b->anext != b) 
+                    tnode* n = b->head;
+                    while(n != NULL)
                     {
-                        tnode* n = b->tnext;
-                        bucket_erase(b, n);
-                        bucket_type* newbucket = get_bucket(n->value.first);
-                        bucket_push(newbucket, n);
+                        tnode* next = n->next;
+                        bucket_push(get_bucket(n->value.first), n);
+                        n = next;
                     }
                     ++b;
                 }
@@ -470,53 +672,200 @@ public:
             if(oldnumbuckets > 0)
             {
                 // free the old memory
-                bucketallocator_.deallocate(oldbuckets, oldnumbuckets);
+                bucket_alloc().deallocate(oldbuckets, oldnumbuckets);
             }
         }
     }
 
+    /**
+     * @brief shrinks the table to the smallest size that satisfies
+     * max_load_factor()
+     * @details intended to return memory after a burst of inserts has been
+     * erased. an empty map releases its buckets entirely.
+     */
+    void shrink_to_fit()
+    {
+        rehash((size_.first() > 0) ? calc_table_size(min_bucket_count()) : 0);
+    }
+
+    // zeroes the lookup counts reported by stats()
+    void reset_probe_counts()
+    {
+#ifdef taapp_UNORDERED_MAP_COUNT_PROBES
+        atomic_store_relaxed(&probe_counts_.hits, size_t(0));
+        atomic_store_relaxed(&probe_counts_.hit_probes, size_t(0));
+        atomic_store_relaxed(&probe_counts_.misses, size_t(0));
+        atomic_store_relaxed(&probe_counts_.miss_probes, size_t(0));
+#endif
+    }
+
     size_t size() const
     {
-        return size_;
+        return size_.first();
+    }
+
+    /**
+     * @brief reports the chain lengths of the buckets in out
+     * @details walks every bucket, so it takes time proportional to
+     * bucket_count() + size().
+     */
+    void stats(hash_stats& out) const
+    {
+        out.size = size_.first();
+        out.bucket_count = numbuckets_;
+        out.empty_buckets = 0;
+        out.max_chain = 0;
+        for(size_t i = 0; i < hash_stats::HISTOGRAM; ++i)
+        {
+            out.histogram[i] = 0;
+        }
+        // a hit on the item at position p of its chain takes p probes
+        double hitprobes = 0.0;
+        const bucket_type* b = buckets_;
+        const bucket_type* bend = buckets_ + numbuckets_;
+        while(b != bend)
+        {
+            size_t length = chain_length(b);
+            out.empty_buckets += (length == 0);
+            out.max_chain = (length > out.max_chain) ? length : out.max_chain;
+            ++out.histogram[(length < hash_stats::HISTOGRAM) ?
+                length :
+                hash_stats::HISTOGRAM - 1];
+            hitprobes += 0.5 * static_cast<double>(length) * (length + 1);
+            ++b;
+        }
+        size_t used = numbuckets_ - out.empty_buckets;
+        out.mean_chain = (used > 0) ?
+            static_cast<float>(size_.first()) / static_cast<float>(used) :
+            0.0f;
+        out.probes_hit = (size_.first() > 0) ?
+            static_cast<float>(
+                hitprobes / static_cast<double>(size_.first())) :
+            0.0f;
+        out.probes_miss = (numbuckets_ > 0) ? load_factor() : 0.0f;
+#ifdef taapp_UNORDERED_MAP_COUNT_PROBES
+        out.counted_hits = atomic_load_relaxed(&probe_counts_.hits);
+        out.counted_hit_probes =
+            atomic_load_relaxed(&probe_counts_.hit_probes);
+        out.counted_misses = atomic_load_relaxed(&probe_counts_.misses);
+        out.counted_miss_probes =
+            atomic_load_relaxed(&probe_counts_.miss_probes);
+#else
+        out.counted_hits = 0;
+        out.counted_hit_probes = 0;
+        out.counted_misses = 0;
+        out.counted_miss_probes = 0;
+#endif
+    }
+
+    /**
+     * @brief exchanges the items, functors and allocators of this map and
+     * other
+     * @details constant time. no nodes or buckets are copied or
+     * reallocated, and iterators remain valid but refer to the other map.
+     */
+    void swap(unordered_map& other)
+    {
+        taapp::swap(buckets_, other.buckets_);
+        taapp::swap(numbuckets_, other.numbuckets_);
+        taapp::swap(size_, other.size_);
+        taapp::swap(
+            functors_.max_load_factor,
+            other.functors_.max_load_factor);
+        taapp::swap(hasher(), other.hasher());
+        taapp::swap(equals(), other.equals());
+        traits::swap(alloc(), other.alloc());
+        allocator_traits<bucket_allocator, bucket_type>::swap(
+            bucket_alloc(),
+            other.bucket_alloc());
+    }
+
+    /**
+     * @brief inserts a default constructed value with key k if k is absent
+     * @details the key is hashed once, and the value is only constructed
+     * when it is inserted. second is true if k was inserted.
+     */
+    pair<iterator, bool> try_emplace(const Key& k)
+    {
+        tnode* chain = NULL;
+        pair<iterator, bool> result = find_or_allocate(k, chain);
+        if(result.second)
+        {
+            new(static_cast<void*>(&result.first.node_->value.first))
+                constructor<Key>(k);
+            new(static_cast<void*>(&result.first.node_->value.second))
+                constructor<T>();
+        }
+        return result;
+    }
+
+    /**
+     * @brief inserts t with key k if k is absent
+     * @details the key is hashed once, and t is only copied when it is
+     * inserted. second is true if k was inserted.
+     */
+    pair<iterator, bool> try_emplace(const Key& k, const T& t)
+    {
+        tnode* chain = NULL;
+        pair<iterator, bool> result = find_or_allocate(k, chain);
+        if(result.second)
+        {
+            construct_value(result.first.node_, k, t);
+        }
+        return result;
     }
 
 #ifndef taapp_UNORDERED_MAP_INTERNAL_API
 private:
 #endif // taapp_UNORDERED_MAP_INTERNAL_API
 
-    struct anode
+    struct tnode;
+
+    // plain pointers, or relative_ptr if the allocator's memory can move
+    typedef typename pointer_traits<Alloc>::template rebind<tnode>::other
+        tnode_ptr;
+
+    // the links of a node in insertion order, if the map is Ordered
+    template<bool O, typename Dummy = void> struct order_links
+    {
+        tnode_ptr older;
+        tnode_ptr newer;
+    };
+
+    template<typename Dummy> struct order_links<false, Dummy>
     {
-        union
-        {
-            struct
-            {
-                struct unordered_map::anode* aprev;
-                struct unordered_map::anode* anext;
-            };
-            struct
-            {
-                struct unordered_map::tnode* tprev;
-                struct unordered_map::tnode* tnext;
-            };
-        };
     };
 
-    struct tnode
+    struct tnode : order_links<Ordered>
     {
-        anode node;
+        tnode_ptr next;
         value_type value;
     };
 
+    // the head of a chain, NULL when the bucket is empty
+    struct bucket
+    {
+        tnode_ptr head;
+    };
+
+    typedef typename pointer_traits<Alloc>::template rebind<bucket>::other
+        bucket_ptr;
+
     // define a custom placement new operator to remove dependency on
     // the std <new> header. cannot use allocator version because it expects
     // type tnode. could add constructor to tnode that accepts value_type,
-    // but want tnode to remain POD if possible; so construction is done here
-    class constructor
+    // but want tnode to remain POD if possible; so construction is done here.
+    // the key and mapped value may also be constructed separately
+    template<typename V> class constructor
     {
     public:
-        value_type t_;
+        V t_;
 
-        inline constructor(const value_type& t) : t_(t)
+        inline constructor() : t_()
+        {
+        }
+
+        inline constructor(const V& t) : t_(t)
         {
         }
 
@@ -530,18 +879,263 @@ private:
         }
     };
 
-    typedef anode bucket_type;
+    typedef bucket bucket_type;
+
+    // the items in insertion order, if the map is Ordered
+    template<bool O, typename Dummy = void> struct order_lists
+    {
+        tnode_ptr head;
+        tnode_ptr tail;
+
+        inline order_lists() : head(NULL), tail(NULL)
+        {
+        }
+
+        // the node after n in iteration order. b is cleared, since
+        // finding the bucket of the next node would take a hash
+        template<typename N, typename B>
+        static inline N* advance(N* n, B*& b, B* bend)
+        {
+            b = NULL;
+            return n->newer;
+        }
+
+        inline void clear()
+        {
+            head = NULL;
+            tail = NULL;
+        }
+
+        inline void erase(tnode* n)
+        {
+            tnode* older = n->older;
+            tnode* newer = n->newer;
+            if(older != NULL)
+            {
+                older->newer = newer;
+            }
+            else
+            {
+                head = newer;
+            }
+            if(newer != NULL)
+            {
+                newer->older = older;
+            }
+            else
+            {
+                tail = older;
+            }
+        }
+
+        inline tnode* front() const
+        {
+            return head;
+        }
+
+        inline void push_back(tnode* n)
+        {
+            n->older = tail;
+            n->newer = NULL;
+            if(tail != NULL)
+            {
+                tail->newer = n;
+            }
+            else
+            {
+                head = n;
+            }
+            tail = n;
+        }
+    };
+
+    // an unordered map iterates bucket by bucket and keeps no list
+    template<typename Dummy> struct order_lists<false, Dummy>
+    {
+        // the node after n, scanning the buckets after b if n is the last
+        // in its chain
+        template<typename N, typename B>
+        static inline N* advance(N* n, B*& b, B* bend)
+        {
+            n = n->next;
+            if(n == NULL)
+            {
+                ++b;
+                while(b != bend)
+                {
+                    n = b->head;
+                    if(n != NULL)
+                    {
+                        break;
+                    }
+                    ++b;
+                }
+            }
+            return n;
+        }
+
+        inline void clear()
+        {
+        }
+
+        inline void erase(tnode*)
+        {
+        }
+
+        inline tnode* front() const
+        {
+            return NULL;
+        }
+
+        inline void push_back(tnode*)
+        {
+        }
+    };
+
+    typedef order_lists<Ordered> order_list;
     typedef typename Alloc::template rebind<tnode>::other allocator_type;
-    typedef typename Alloc::template rebind<anode>::other bucket_allocator;
+    typedef typename Alloc::template rebind<bucket>::other bucket_allocator;
+    typedef allocator_traits<allocator_type, tnode> traits;
 
-    bucket_type* buckets_;
+    enum
+    {
+        // nodes need not be visited to destroy their values
+        TRIVIAL_DESTRUCTOR =
+            __has_trivial_destructor(value_type) | !__is_class(value_type)
+    };
+
+    enum
+    {
+        // lookups find_many keeps between each stage of its pipeline
+        PREFETCH_DISTANCE = 16,
+        // buckets held by the pipeline, a power of two above 2 * distance
+        PREFETCH_RING = 64
+    };
+
+    bucket_ptr buckets_;
     size_t numbuckets_;
-    size_t size_;
-    float max_load_factor_;
-    Hash hasher_;
-    Pred equals_;
-    allocator_type allocator_;
-    bucket_allocator bucketallocator_;
+    // the insertion order list takes no space unless the map is Ordered
+    compressed_pair<size_t, order_list> size_;
+    // the functors and allocators, which take no space when they are empty.
+    // the load factor is kept with them so that they need no padding
+    struct functors :
+        compressed_member<Hash, 0>,
+        compressed_member<Pred, 1>,
+        compressed_member<allocator_type, 2>,
+        compressed_member<bucket_allocator, 3>
+    {
+        float max_load_factor;
+
+        inline functors() : max_load_factor(1.0f)
+        {
+        }
+
+        inline functors(const Hash& h, const Pred& eq, const Alloc& a) :
+            compressed_member<Hash, 0>(h),
+            compressed_member<Pred, 1>(eq),
+            compressed_member<allocator_type, 2>(allocator_type(a)),
+            compressed_member<bucket_allocator, 3>(bucket_allocator(a)),
+            max_load_factor(1.0f)
+        {
+        }
+
+        inline Hash& hasher()
+        {
+            return compressed_member<Hash, 0>::get();
+        }
+
+        inline const Hash& hasher() const
+        {
+            return compressed_member<Hash, 0>::get();
+        }
+
+        inline Pred& equals()
+        {
+            return compressed_member<Pred, 1>::get();
+        }
+
+        inline const Pred& equals() const
+        {
+            return compressed_member<Pred, 1>::get();
+        }
+
+        inline allocator_type& alloc()
+        {
+            return compressed_member<allocator_type, 2>::get();
+        }
+
+        inline const allocator_type& alloc() const
+        {
+            return compressed_member<allocator_type, 2>::get();
+        }
+
+        inline bucket_allocator& bucket_alloc()
+        {
+            return compressed_member<bucket_allocator, 3>::get();
+        }
+    };
+
+    functors functors_;
+#ifdef taapp_UNORDERED_MAP_COUNT_PROBES
+    struct probe_counts
+    {
+        volatile size_t hits;
+        volatile size_t hit_probes;
+        volatile size_t misses;
+        volatile size_t miss_probes;
+
+        inline probe_counts() :
+            hits(0),
+            hit_probes(0),
+            misses(0),
+            miss_probes(0)
+        {
+        }
+    };
+
+    // counted by const lookups too, which may run concurrently
+    mutable probe_counts probe_counts_;
+#endif
+
+    inline Hash& hasher()
+    {
+        return functors_.hasher();
+    }
+
+    inline const Hash& hasher() const
+    {
+        return functors_.hasher();
+    }
+
+    inline Pred& equals()
+    {
+        return functors_.equals();
+    }
+
+    inline const Pred& equals() const
+    {
+        return functors_.equals();
+    }
+
+    inline order_list& order()
+    {
+        return size_.second();
+    }
+
+    inline const order_list& order() const
+    {
+        return size_.second();
+    }
+
+    inline allocator_type& alloc()
+    {
+        return functors_.alloc();
+    }
+
+    inline bucket_allocator& bucket_alloc()
+    {
+        return functors_.bucket_alloc();
+    }
 
     size_t calc_table_size(size_t size)
     {
@@ -567,29 +1161,230 @@ private:
         return *titr;
     }
 
+    // the fewest buckets that keep load_factor() within max_load_factor()
+    size_t min_bucket_count() const
+    {
+        return min_bucket_count(size_.first());
+    }
+
+    size_t min_bucket_count(size_t size) const
+    {
+        float f = static_cast<float>(size) / functors_.max_load_factor;
+        size_t count = static_cast<size_t>(f);
+        if(static_cast<float>(count) < f)
+        {
+            ++count;
+        }
+        return count;
+    }
+
+    // inserts v, taking the node from chain if it is not empty
+    pair<iterator, bool> insert_unique(const value_type& v, tnode*& chain)
+    {
+        pair<iterator, bool> result = find_or_allocate(v.first, chain);
+        if(result.second)
+        {
+            new(static_cast<void*>(&result.first.node_->value))
+                constructor<value_type>(v);
+        }
+        return result;
+    }
+
+    /**
+     * @brief finds k, or links a node for it into the table
+     * @details k is hashed once, and its bucket is walked once. if k is
+     * absent, a node is taken from chain if it is not empty, or allocated,
+     * and second is true. the caller must construct the new node's value.
+     */
+    pair<iterator, bool> find_or_allocate(const Key& k, tnode*& chain)
+    {
+        size_t h = hasher()(k);
+        pair<iterator, bool> result = { iterator(), false };
+        if(numbuckets_ != 0)
+        {
+            bucket_type* b = buckets_ + (h % numbuckets_);
+            tnode* n = b->head;
+            size_t probes = 0;
+            while(n != NULL)
+            {
+                ++probes;
+                if(equals()(k, n->value.first))
+                {
+                    count_lookup(true, probes);
+                    result.first.node_ = n;
+                    result.first.bucket_ = b;
+                    result.first.bucketend_ = buckets_ + numbuckets_;
+                    return result;
+                }
+                n = n->next;
+            }
+            count_lookup(false, probes);
+        }
+        // key does not exist in the map
+        if(numbuckets_ == 0 || load_factor() >= functors_.max_load_factor)
+        {
+            rehash(calc_table_size(numbuckets_ + 1));
+        }
+        bucket_type* b = buckets_ + (h % numbuckets_);
+        tnode* n = chain;
+        if(n != NULL)
+        {
+            chain = traits::chain_next(chain);
+        }
+        else
+        {
+            n = alloc().allocate(1);
+        }
+        bucket_push(b, n);
+        order().push_back(n);
+        result.first.node_ = n;
+        result.first.bucket_ = b;
+        result.first.bucketend_ = buckets_ + numbuckets_;
+        result.second = true;
+        ++size_.first();
+        return result;
+    }
+
+    // constructs the value of a node from find_or_allocate
+    inline void construct_value(tnode* n, const Key& k, const T& t)
+    {
+        new(static_cast<void*>(&n->value.first)) constructor<Key>(k);
+        new(static_cast<void*>(&n->value.second)) constructor<T>(t);
+    }
+
+    // frees n once it has been unlinked from its bucket
+    inline void destroy_node(tnode* n)
+    {
+        order().erase(n);
+        n->value.~value_type();
+        alloc().deallocate(n, 1);
+        --size_.first();
+    }
+
+    // unlinks n, finding its predecessor by walking the chain
     inline void bucket_erase(bucket_type* bucket, tnode* n)
     {
-        n->node.aprev->anext = n->node.anext;
-        n->node.anext->aprev = n->node.aprev;
+        tnode_ptr* link = &bucket->head;
+        while(*link != n)
+        {
+            link = &(*link)->next;
+        }
+        *link = n->next;
     }
 
     // pushes to front of bucket
     inline void bucket_push(bucket_type* bucket, tnode* n)
     {
-        n->node.anext = bucket->anext;
-        n->node.aprev = bucket;
-        bucket->anext->aprev = &n->node;
-        bucket->anext = &n->node;
+        n->next = bucket->head;
+        bucket->head = n;
+    }
+
+    inline size_t chain_length(const bucket_type* b) const
+    {
+        size_t length = 0;
+        const tnode* n = b->head;
+        while(n != NULL)
+        {
+            ++length;
+            n = n->next;
+        }
+        return length;
+    }
+
+    // records a lookup that compared probes items, if counting is enabled
+    inline void count_lookup(bool hit, size_t probes) const
+    {
+#ifdef taapp_UNORDERED_MAP_COUNT_PROBES
+        if(hit)
+        {
+            atomic_fetch_add_relaxed(&probe_counts_.hits, size_t(1));
+            atomic_fetch_add_relaxed(&probe_counts_.hit_probes, probes);
+        }
+        else
+        {
+            atomic_fetch_add_relaxed(&probe_counts_.misses, size_t(1));
+            atomic_fetch_add_relaxed(&probe_counts_.miss_probes, probes);
+        }
+#else
+        (void) hit;
+        (void) probes;
+#endif
+    }
+
+    // hints that p will soon be read
+    static inline void prefetch(const void* p)
+    {
+#if defined(__GNUC__)
+        __builtin_prefetch(p);
+#else
+        (void) p;
+#endif
+    }
+
+    // implements both versions of find_many. Iterator is iterator or
+    // const_iterator, whose members accept the node and bucket either way
+    template<typename Iterator>
+    void find_pipelined(const Key* keys, size_t n, Iterator* out) const
+    {
+        const bucket_type* ring[PREFETCH_RING];
+        const bucket_type* bend = buckets_ + numbuckets_;
+        if(numbuckets_ == 0)
+        {
+            for(size_t i = 0; i < n; ++i)
+            {
+                out[i] = Iterator();
+            }
+            return;
+        }
+        for(size_t i = 0; i < n + 2 * PREFETCH_DISTANCE; ++i)
+        {
+            if(i < n)
+            {
+                // stage 1: hash the key and fetch its bucket
+                const bucket_type* b = get_bucket(keys[i]);
+                ring[i % PREFETCH_RING] = b;
+                prefetch(b);
+            }
+            if(i >= PREFETCH_DISTANCE && i - PREFETCH_DISTANCE < n)
+            {
+                // stage 2: fetch the first node in the bucket
+                size_t k = i - PREFETCH_DISTANCE;
+                prefetch(ring[k % PREFETCH_RING]->head);
+            }
+            if(i >= 2 * PREFETCH_DISTANCE)
+            {
+                // stage 3: compare the keys in the bucket
+                size_t k = i - 2 * PREFETCH_DISTANCE;
+                const bucket_type* b = ring[k % PREFETCH_RING];
+                const tnode* nd = b->head;
+                Iterator result;
+                size_t probes = 0;
+                while(nd != NULL)
+                {
+                    ++probes;
+                    if(equals()(keys[k], nd->value.first))
+                    {
+                        result.node_ = const_cast<tnode*>(nd);
+                        result.bucket_ = const_cast<bucket_type*>(b);
+                        result.bucketend_ = const_cast<bucket_type*>(bend);
+                        break;
+                    }
+                    nd = nd->next;
+                }
+                count_lookup(result.node_ != NULL, probes);
+                out[k] = result;
+            }
+        }
     }
 
     inline const bucket_type* get_bucket(const Key& k) const
     {
-        return buckets_ + (hasher_(k) % numbuckets_);
+        return buckets_ + (hasher()(k) % numbuckets_);
     }
 
     inline bucket_type* get_bucket(const Key& k)
     {
-        return buckets_ + (hasher_(k) % numbuckets_);
+        return buckets_ + (hasher()(k) % numbuckets_);
     }
 
 private:
@@ -7,6 +7,8 @@
 #ifndef taapp_VECTOR_H_
 #define taapp_VECTOR_H_
 
+#include "allocator_traits.h"
+#include "compressed_pair.h"
 #include <cstddef>
 #include <cassert>
 #include <cstring>
@@ -20,7 +22,14 @@ namespace taapp
  * compiler extensions for support of type trait intrisincs and will only
  * build on compilers that provide them. Microsoft Visual C++ provides this
  * support on versions 2005+. GCC provides this support on versions
- * 4.3.03+.
+ * 4.3.03+. Trivial types are grown in place with
+ * Allocator::reallocate(p, old_n, n), which must preserve the contents of p.
+ * Allocators that only provide the older reallocate(p, n) are called with
+ * that instead.
+ * If the allocator reports the usable size of its blocks, the whole block
+ * is used as capacity, which saves reallocations for free. The heap
+ * allocators only report more than was requested when compiled with
+ * taapp_HEAP_USABLE_SIZE (see heap_usable_size).
  */
 template<typename T, typename Allocator> class vector
 {
@@ -29,7 +38,13 @@ public:
     typedef T* iterator;
     typedef const T* const_iterator;
 
-    vector() : begin_(NULL), end_(NULL), capacity_(NULL)
+    vector() : begin_(NULL), end_(NULL), capacity_()
+    {
+    }
+
+    // constructs an empty vector whose buffer comes from a copy of a
+    explicit vector(const Allocator& a) :
+        begin_(NULL), end_(NULL), capacity_(NULL, a)
     {
     }
 
@@ -38,7 +53,7 @@ public:
         if(begin_ != NULL)
         {
             destroy_range(begin_, end_);
-            allocator_.deallocate(begin_, capacity());
+            alloc().deallocate(begin_, capacity());
         }
     }
 
@@ -54,6 +69,47 @@ public:
         return begin_[index];
     }
 
+    /**
+     * @brief appends the elements in [first, last) to the end of the vector
+     * @details the vector grows at most once. the range must not refer to
+     * elements of this vector.
+     */
+    void append(const_iterator first, const_iterator last)
+    {
+        assert(first <= last);
+        assert(first == last || last <= begin_ || first >= end_);
+        size_t n = static_cast<size_t>(last - first);
+        grow(size() + n);
+        copyconstruct_range(end_, end_ + n, first);
+        end_ += n;
+    }
+
+    /**
+     * @brief replaces the contents of the vector with [first, last)
+     * @details the range must not refer to elements of this vector.
+     */
+    void assign(const_iterator first, const_iterator last)
+    {
+        assert(first <= last);
+        assert(first == last || last <= begin_ || first >= end_);
+        size_t n = static_cast<size_t>(last - first);
+        destroy_range(begin_, end_);
+        end_ = begin_;
+        if(n > capacity())
+        {
+            // none of the old contents need to be preserved, so release the
+            // old buffer rather than letting reallocate copy it
+            if(begin_ != NULL)
+            {
+                alloc().deallocate(begin_, capacity());
+            }
+            begin_ = alloc().allocate(n);
+            capacity_.first() = begin_ + usable_size(begin_, n);
+        }
+        copyconstruct_range(begin_, begin_ + n, first);
+        end_ = begin_ + n;
+    }
+
     inline const T& back() const
     {
         return *(end_ - 1);
@@ -76,7 +132,7 @@ public:
 
     inline size_t capacity()
     {
-        return static_cast<size_t>(capacity_ - begin_);
+        return static_cast<size_t>(capacity_.first() - begin_);
     }
 
     inline void clear()
@@ -108,7 +164,7 @@ public:
         if(TRIVIAL_ASSIGN)
         {
             memmove(
-                it,
+                static_cast<void*>(it),
                 it + 1,
                 reinterpret_cast<size_t>(end)-reinterpret_cast<size_t>(it));
         }
@@ -121,10 +177,76 @@ public:
                 ++itr;
             }           
         }
-        allocator_.destroy(end_);
+        alloc().destroy(end_);
         return it;
     }
 
+    /**
+     * @brief removes the elements in the range [first, last)
+     * @details the tail of the vector is shifted down once, regardless of the
+     * number of elements removed.
+     */
+    iterator erase(iterator first, iterator last)
+    {
+        assert(first >= begin_);
+        assert(first <= last);
+        assert(last <= end_);
+        if(first != last)
+        {
+            T* end = first + (end_ - last);
+            assign_range(first, last, end_);
+            destroy_range(end, end_);
+            end_ = end;
+        }
+        return first;
+    }
+
+    /**
+     * @brief removes all elements for which pred returns true
+     * @details survivors are compacted toward the front in a single pass,
+     * moving each run of consecutive survivors at once. pred is evaluated
+     * exactly once per element, in order. returns the number of elements
+     * removed.
+     */
+    template<typename Predicate>
+    size_t erase_if(Predicate pred)
+    {
+        T* dst = begin_;
+        // elements in front of the first removed element stay where they are
+        while(dst != end_ && !pred(*dst))
+        {
+            ++dst;
+        }
+        if(dst != end_)
+        {
+            T* src = dst + 1;
+            while(src != end_)
+            {
+                if(pred(*src))
+                {
+                    ++src;
+                }
+                else
+                {
+                    // find the end of this run of survivors and move the
+                    // whole run down at once
+                    T* run = src;
+                    do
+                    {
+                        ++src;
+                    }
+                    while(src != end_ && !pred(*src));
+                    assign_range(dst, run, src);
+                    dst += src - run;
+                }
+            }
+        }
+        size_t n = static_cast<size_t>(end_ - dst);
+        destroy_range(dst, end_);
+        end_ = dst;
+        return n;
+    }
+
     inline const T& front() const
     {
         return *begin_;
@@ -135,19 +257,31 @@ public:
         return *begin_;
     }
 
+    // a copy of the allocator the vector was constructed with
+    inline Allocator get_allocator() const
+    {
+        return capacity_.second();
+    }
+
     iterator insert(iterator pos, const T& t)
     {
         assert(pos >= begin_);
         assert(pos <= end_);
-        size_t off;
-        off = reinterpret_cast<size_t>(pos) - reinterpret_cast<size_t>(begin_);
+        if(&t >= begin_ && &t < end_)
+        {
+            // t is an element, which resize may free and the shift below
+            // may overwrite, so insert a copy of it
+            T v(t);
+            return insert(pos, v);
+        }
+        size_t off = static_cast<size_t>(pos - begin_);
         resize(size() + 1);
         // resize may invalidate pos, so need to recalculate it
-        pos = reinterpret_cast<T*>(reinterpret_cast<size_t>(begin_)+off);
+        pos = begin_ + off;
         if(TRIVIAL_ASSIGN)
         {
             memmove(
-                pos + 1,
+                static_cast<void*>(pos + 1),
                 pos,
                 reinterpret_cast<size_t>(end_) -
                 reinterpret_cast<size_t>(pos+1));
@@ -165,21 +299,78 @@ public:
         return pos;
     }
 
+    /**
+     * @brief inserts the elements in [first, last) in front of pos
+     * @details the vector grows at most once and the tail is shifted once.
+     * the range must not refer to elements of this vector.
+     */
+    iterator insert(iterator pos, const_iterator first, const_iterator last)
+    {
+        assert(pos >= begin_);
+        assert(pos <= end_);
+        assert(first <= last);
+        assert(first == last || last <= begin_ || first >= end_);
+        size_t n = static_cast<size_t>(last - first);
+        size_t off = static_cast<size_t>(pos - begin_);
+        grow(size() + n);
+        // grow may invalidate pos, so need to recalculate it
+        pos = begin_ + off;
+        T* end = end_ + n;
+        size_t tail = static_cast<size_t>(end_ - pos);
+        if(TRIVIAL_COPY && TRIVIAL_ASSIGN)
+        {
+            memmove(static_cast<void*>(pos + n), pos, tail * sizeof(T));
+            memcpy(static_cast<void*>(pos), first, n * sizeof(T));
+        }
+        else if(n <= tail)
+        {
+            // the last n elements move into uninitialized storage
+            copyconstruct_range(end_, end, end_ - n);
+            // the rest of the tail moves back to front over live elements
+            T* dst = end_;
+            T* src = end_ - n;
+            while(src != pos)
+            {
+                --dst;
+                --src;
+                *dst = *src;
+            }
+            assign_range(pos, first, last);
+        }
+        else
+        {
+            // the inserted range extends past the old end, so the whole tail
+            // and the end of the range go to uninitialized storage
+            copyconstruct_range(end_, pos + n, first + tail);
+            copyconstruct_range(pos + n, end, pos);
+            assign_range(pos, first, first + tail);
+        }
+        end_ = end;
+        return pos;
+    }
+
     void pop_back()
     {
         assert(begin_ != end_);
         --end_;
-        allocator_.destroy(end_);
+        alloc().destroy(end_);
     }
 
     void push_back(const T& t)
     {
-        if(capacity_ == end_)
+        if(capacity_.first() == end_)
         {
+            if(&t >= begin_ && &t < end_)
+            {
+                // t is an element, which reallocate may free
+                T v(t);
+                push_back(v);
+                return;
+            }
             size_t c = capacity();
             reallocate(c, increment_capacity(c));
         }
-        allocator_.construct(end_++, t);
+        alloc().construct(end_++, t);
     }
 
     void reserve(size_t c)
@@ -193,16 +384,7 @@ public:
 
     void resize(size_t size)
     {
-        size_t c = capacity();
-        if(size > c)
-        {
-            size_t new_capacity = increment_capacity(c);
-            if(new_capacity < size)
-            {
-                new_capacity = size;
-            }
-            reallocate(c, new_capacity);
-        }
+        grow(size);
         T* end = begin_ + size;
         construct_range(end_, end);
         destroy_range(end, end_);
@@ -211,27 +393,42 @@ public:
 
     void resize(size_t size, const T& t)
     {
-        size_t c = capacity();
-        if(size > c)
-        {
-            size_t new_capacity = increment_capacity(c);
-            if(new_capacity < size)
-            {
-                new_capacity = size;
-            }
-            reallocate(c, new_capacity);
-        }
+        grow(size);
         T* itr = end_;
         T* end = begin_ + size;
         while(itr < end)
         {
-            allocator_.construct(itr, t);
+            alloc().construct(itr, t);
             ++itr;
         }
         destroy_range(end, end_);
         end_ = end;
     }
 
+    /**
+     * @brief releases any capacity beyond size()
+     * @details an empty vector releases its buffer entirely.
+     */
+    void shrink_to_fit()
+    {
+        size_t c = capacity();
+        size_t sz = size();
+        if(sz < c)
+        {
+            if(sz == 0)
+            {
+                alloc().deallocate(begin_, c);
+                begin_ = NULL;
+                end_ = NULL;
+                capacity_.first() = NULL;
+            }
+            else
+            {
+                reallocate(c, sz);
+            }
+        }
+    }
+
     inline size_t size() const
     {
         return static_cast<size_t>(end_ - begin_);
@@ -263,14 +460,44 @@ private:
 
     T* begin_;
     T* end_;
-    T* capacity_;
-    Allocator allocator_;
+    // the allocator takes no space when it is empty
+    compressed_pair<T*, Allocator> capacity_;
+
+    inline Allocator& alloc()
+    {
+        return capacity_.second();
+    }
     
     inline size_t increment_capacity(size_t c)
     {
         return (c < 64) ? ((c == 0) ? 8 : c << 1) : c + 64;
     }    
 
+    // assigns [begin, end) to dst. the ranges may overlap if dst < begin
+    inline void assign_range(
+        iterator dst,
+        const_iterator begin,
+        const_iterator end)
+    {
+        if(TRIVIAL_ASSIGN)
+        {
+            memmove(
+                static_cast<void*>(dst),
+                begin,
+                reinterpret_cast<size_t>(end) -
+                reinterpret_cast<size_t>(begin));
+        }
+        else
+        {
+            while(begin < end)
+            {
+                *dst = *begin;
+                ++dst;
+                ++begin;
+            }
+        }
+    }
+
     inline void construct_range(
         iterator begin,
         iterator end)
@@ -280,7 +507,7 @@ private:
             T t;
             while(begin < end)
             {
-                allocator_.construct(begin, t);
+                alloc().construct(begin, t);
                 ++begin;
             }
         }
@@ -294,7 +521,7 @@ private:
         if(TRIVIAL_COPY)
         {
             memcpy(
-                begin,
+                static_cast<void*>(begin),
                 src,
                 reinterpret_cast<size_t>(end) -
                 reinterpret_cast<size_t>(begin));
@@ -303,7 +530,7 @@ private:
         {
             while(begin < end)
             {
-                allocator_.construct(begin, *src);
+                alloc().construct(begin, *src);
                 ++begin;
                 ++src;
             }
@@ -316,11 +543,35 @@ private:
         {
             while(begin < end)
             {
-                allocator_.destroy(begin);
+                alloc().destroy(begin);
                 ++begin;
             }
         }
     }
+
+    // number of elements that fit in buffer allocated for n elements
+    inline size_t usable_size(T* buffer, size_t n)
+    {
+        return allocator_traits<Allocator, T>::usable_size(
+            alloc(),
+            buffer,
+            n);
+    }
+
+    // ensures there is capacity for size elements, growing geometrically
+    inline void grow(size_t size)
+    {
+        size_t c = capacity();
+        if(size > c)
+        {
+            size_t new_capacity = increment_capacity(c);
+            if(new_capacity < size)
+            {
+                new_capacity = size;
+            }
+            reallocate(c, new_capacity);
+        }
+    }
     
     void reallocate(
         size_t old_capacity,
@@ -330,21 +581,25 @@ private:
         size_t sz = size();
         if(TRIVIAL_COPY && TRIVIAL_ASSIGN)
         {
-            buffer = allocator_.reallocate(begin_, new_capacity);
+            buffer = allocator_traits<Allocator, T>::reallocate(
+                alloc(),
+                begin_,
+                old_capacity,
+                new_capacity);
         }
         else
         {
-            buffer = allocator_.allocate(new_capacity, begin_);
+            buffer = alloc().allocate(new_capacity, begin_);
             if(begin_ != NULL)
             {
                 copyconstruct_range(buffer, buffer + sz, begin_);
                 destroy_range(begin_, end_);
-                allocator_.deallocate(begin_, old_capacity);
+                alloc().deallocate(begin_, old_capacity);
             }
         }
         begin_ = buffer;
         end_ = buffer + sz;
-        capacity_ = buffer + new_capacity;
+        capacity_.first() = buffer + usable_size(buffer, new_capacity);
     }
 
 private:
@@ -0,0 +1,1051 @@
+/**
+ * @brief     unit test for the taapp allocators
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#if defined(_DEBUG) && defined(_MSC_FULL_VER)
+#define _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#define taapp_STATS_ALLOCATOR_INTERNAL_API
+#define taapp_THREAD_CACHE_INTERNAL_API
+#include <taapp/file_allocator.h>
+#include <taapp/list.h>
+#include <taapp/map.h>
+#include <taapp/reclaimer.h>
+#include <taapp/set.h>
+#include <taapp/slab_allocator.h>
+#include <taapp/stats_allocator.h>
+#include <taapp/thread.h>
+#include <taapp/thread_cache_allocator.h>
+#include <taapp/unordered_map.h>
+#include <taapp/vector.h>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef NDEBUG
+#error asserts are not enabled
+#endif
+
+struct int_less
+{
+    bool operator()(int a, int b) const
+    {
+        return a < b;
+    }
+};
+
+struct int_equal
+{
+    bool operator()(int a, int b) const
+    {
+        return a == b;
+    }
+};
+
+struct int_hash
+{
+    size_t operator()(int a) const
+    {
+        return static_cast<size_t>(a);
+    }
+};
+
+// exercises the node and buffer allocations of every container type
+template<template<typename> class Allocator>
+void test_containers()
+{
+    const int max = 10000;
+    {
+        taapp::vector<int, Allocator<int> > v;
+        for(int i = 0; i < max; ++i)
+        {
+            v.push_back(i);
+        }
+        for(int i = 0; i < max; ++i)
+        {
+            assert(v[i] == i);
+        }
+        v.resize(10);
+        v.shrink_to_fit();
+        assert(v[9] == 9);
+    }
+    {
+        taapp::list<int, Allocator<int> > l;
+        for(int i = 0; i < max; ++i)
+        {
+            l.push_back(i);
+        }
+        int i = 0;
+        while(!l.empty())
+        {
+            assert(l.front() == i);
+            l.pop_front();
+            ++i;
+        }
+        assert(i == max);
+    }
+    {
+        typedef taapp::map<int, int, int_less, Allocator<int> > int_map;
+        int_map m;
+        for(int i = 0; i < max; ++i)
+        {
+            typename int_map::value_type v = { i, -i };
+            m.insert(v);
+        }
+        for(int i = 0; i < max; i += 2)
+        {
+            m.erase(i);
+        }
+        assert(m.size() == max / 2);
+        assert(m.find(1)->second == -1);
+    }
+    {
+        typedef taapp::unordered_map<
+            int,
+            int,
+            int_hash,
+            int_equal,
+            Allocator<int> > int_map;
+        int_map m;
+        for(int i = 0; i < max; ++i)
+        {
+            typename int_map::value_type v = { i, -i };
+            m.insert(v);
+        }
+        for(int i = 0; i < max; i += 2)
+        {
+            m.erase(i);
+        }
+        assert(m.size() == max / 2);
+        assert(m.find(1)->second == -1);
+    }
+}
+
+static int bulk_calls = 0;
+static int single_calls = 0;
+// the most blocks allocate_bulk hands out, as if memory ran short
+static size_t bulk_limit = static_cast<size_t>(-1);
+
+// counts the calls made to a thread_cache_allocator
+template<typename T>
+class counting_allocator : public taapp::thread_cache_allocator<T>
+{
+public:
+
+    typedef taapp::thread_cache_allocator<T> base;
+
+    template<typename U> struct rebind
+    {
+        typedef counting_allocator<U> other;
+    };
+
+    T* allocate(size_t n, const void* = 0)
+    {
+        ++single_calls;
+        return base::allocate(n);
+    }
+
+    T* allocate_bulk(size_t n)
+    {
+        ++bulk_calls;
+        return base::allocate_bulk((n < bulk_limit) ? n : bulk_limit);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        ++single_calls;
+        base::deallocate(p, n);
+    }
+
+    void deallocate_bulk(T* chain, size_t n)
+    {
+        ++bulk_calls;
+        base::deallocate_bulk(chain, n);
+    }
+};
+
+// range inserts and clear take and return all of their nodes in one call
+static void test_bulk()
+{
+    enum { COUNT = 100000, UNIQUE = 90000 };
+    static taapp::pair<int, int> values[COUNT];
+    for(int i = 0; i < COUNT; ++i)
+    {
+        values[i].first = i % UNIQUE;
+        values[i].second = -(i % UNIQUE);
+    }
+    {
+        taapp::map<int, int, int_less, counting_allocator<int> > m;
+        m.insert(values, values + COUNT);
+        assert(m.size() == UNIQUE);
+        assert(m.find(UNIQUE - 1)->second == 1 - UNIQUE);
+        // the nodes left over by duplicate keys are returned in one call
+        assert(bulk_calls == 2);
+        assert(single_calls == 0);
+    }
+    assert(bulk_calls == 3);
+    assert(single_calls == 0);
+    bulk_calls = 0;
+    {
+        taapp::unordered_map<
+            int,
+            int,
+            int_hash,
+            int_equal,
+            counting_allocator<int> > m;
+        m.insert(values, values + COUNT);
+        assert(m.size() == UNIQUE);
+        assert(m.find(UNIQUE - 1)->second == 1 - UNIQUE);
+        assert(bulk_calls == 2);
+        // only the bucket array is allocated on its own
+        assert(single_calls == 1);
+    }
+    assert(bulk_calls == 3);
+    assert(single_calls == 2);
+    bulk_calls = 0;
+    single_calls = 0;
+    {
+        static int ints[COUNT];
+        taapp::list<int, counting_allocator<int> > l;
+        l.insert(l.end(), ints, ints + COUNT);
+        l.clear();
+        assert(l.empty());
+        assert(bulk_calls == 2);
+        assert(single_calls == 0);
+    }
+
+    // a short chain is topped up one node at a time, and what is left of
+    // it is returned with its true length, which the debug block counts of
+    // the allocators check
+    bulk_limit = COUNT / 2;
+    {
+        taapp::map<int, int, int_less, counting_allocator<int> > m;
+        m.insert(values, values + COUNT);
+        assert(m.size() == UNIQUE);
+        assert(m.find(UNIQUE - 1)->second == 1 - UNIQUE);
+        taapp::unordered_map<
+            int,
+            int,
+            int_hash,
+            int_equal,
+            counting_allocator<int> > u;
+        u.insert(values, values + COUNT);
+        assert(u.size() == UNIQUE);
+        assert(u.find(UNIQUE - 1)->second == 1 - UNIQUE);
+        static int ints[COUNT];
+        ints[COUNT - 1] = 7;
+        taapp::list<int, counting_allocator<int> > l;
+        l.insert(l.end(), ints, ints + COUNT);
+        assert(l.back() == 7);
+    }
+    bulk_limit = static_cast<size_t>(-1);
+}
+
+enum
+{
+    BLOCK_COUNT = 4096
+};
+
+struct remote_free_args
+{
+    void* blocks[BLOCK_COUNT];
+};
+
+static void remote_free(void* arg)
+{
+    remote_free_args* args = static_cast<remote_free_args*>(arg);
+    for(int i = 0; i < BLOCK_COUNT; ++i)
+    {
+        taapp::thread_cache::deallocate(args->blocks[i]);
+    }
+}
+
+// blocks freed by another thread return to the owner through its remote
+// free stack and are handed out again by the owner. uses a size class that
+// the container tests leave empty
+static void test_remote_free()
+{
+    remote_free_args args;
+    taapp::thread_cache* cache = taapp::thread_cache::get();
+    for(int i = 0; i < BLOCK_COUNT; ++i)
+    {
+        args.blocks[i] = cache->allocate(176);
+        assert(taapp::thread_cache::slab_of(args.blocks[i])->owner == cache);
+    }
+    taapp::thread t;
+    t.start(&remote_free, &args);
+    t.join();
+    assert(cache->remote_ != NULL);
+    void* p = cache->allocate(176);
+    assert(cache->remote_ == NULL);
+    bool found = false;
+    for(int i = 0; i < BLOCK_COUNT; ++i)
+    {
+        found |= args.blocks[i] == p;
+    }
+    assert(found);
+    taapp::thread_cache::deallocate(p);
+}
+
+static void get_cache(void* arg)
+{
+    *static_cast<taapp::thread_cache**>(arg) = taapp::thread_cache::get();
+}
+
+// the cache of an exited thread is adopted by the next thread
+static void test_adoption()
+{
+    taapp::thread_cache* first = NULL;
+    taapp::thread_cache* second = NULL;
+    taapp::thread t;
+    t.start(&get_cache, &first);
+    t.join();
+    t.start(&get_cache, &second);
+    t.join();
+    assert(first != NULL);
+#if !defined(_WIN32)
+    assert(first == second);
+#endif
+}
+
+struct stress_args
+{
+    int** shared;
+    int seed;
+};
+
+static void stress(void* arg)
+{
+    stress_args* args = static_cast<stress_args*>(arg);
+    unsigned int x = args->seed;
+    for(int i = 0; i < 100000; ++i)
+    {
+        x = x * 1103515245 + 12345;
+        int slot = (x >> 8) % BLOCK_COUNT;
+        // steal a block, possibly allocated by another thread, and replace it
+        int* p = taapp::atomic_exchange(&args->shared[slot], (int*)NULL);
+        if(p != NULL)
+        {
+            assert(*p == slot);
+            taapp::thread_cache::deallocate(p);
+        }
+        p = static_cast<int*>(taapp::thread_cache::get()->allocate(
+            sizeof(int) * (1 + (x >> 20) % 32)));
+        *p = slot;
+        p = taapp::atomic_exchange(&args->shared[slot], p);
+        if(p != NULL)
+        {
+            assert(*p == slot);
+            taapp::thread_cache::deallocate(p);
+        }
+    }
+}
+
+// threads allocate blocks and free each other's blocks concurrently
+static void test_stress()
+{
+    enum { THREADS = 8 };
+    static int* shared[BLOCK_COUNT];
+    taapp::thread threads[THREADS];
+    stress_args args[THREADS];
+    for(int i = 0; i < THREADS; ++i)
+    {
+        args[i].shared = shared;
+        args[i].seed = i;
+        threads[i].start(&stress, &args[i]);
+    }
+    for(int i = 0; i < THREADS; ++i)
+    {
+        threads[i].join();
+    }
+    for(int i = 0; i < BLOCK_COUNT; ++i)
+    {
+        if(shared[i] != NULL)
+        {
+            assert(*shared[i] == i);
+            taapp::thread_cache::deallocate(shared[i]);
+        }
+    }
+}
+
+struct stats_tag
+{
+};
+
+typedef taapp::stats_allocator<int, taapp::allocator<int>, stats_tag>
+    stats_int_allocator;
+
+static void stats_worker(void*)
+{
+    taapp::vector<int, stats_int_allocator> v;
+    for(int i = 0; i < 100000; ++i)
+    {
+        v.push_back(i);
+    }
+}
+
+static size_t count_stats_blocks()
+{
+    size_t n = 0;
+    stats_int_allocator::counters::block* b =
+        stats_int_allocator::counters::head();
+    while(b != NULL)
+    {
+        ++n;
+        b = b->next;
+    }
+    return n;
+}
+
+static void test_stats()
+{
+    taapp::allocator_stats s;
+    stats_int_allocator::snapshot(s);
+    assert(s.bytes == 0);
+    assert(s.allocations == 0);
+    {
+        taapp::vector<int, stats_int_allocator> v;
+        for(int i = 0; i < 1000; ++i)
+        {
+            v.push_back(i);
+        }
+        stats_int_allocator::snapshot(s);
+        // includes the slack the allocator reported to the vector
+        assert(s.bytes == v.capacity() * sizeof(int));
+        assert(s.live_allocations == 1);
+        assert(s.allocations == 1);
+        assert(s.reallocations > 0);
+        // node and bucket allocators obtained through rebind share the tag
+        typedef taapp::unordered_map<
+            int,
+            int,
+            int_hash,
+            int_equal,
+            stats_int_allocator> int_map;
+        int_map m;
+        for(int i = 0; i < 100; ++i)
+        {
+            int_map::value_type p = { i, i };
+            m.insert(p);
+        }
+        stats_int_allocator::snapshot(s);
+        // one allocation per node, plus the bucket array and the vector
+        assert(s.live_allocations == 102);
+        assert(s.bytes > v.capacity() * sizeof(int) + 100 * 2 * sizeof(int));
+    }
+    stats_int_allocator::snapshot(s);
+    assert(s.bytes == 0);
+    assert(s.live_allocations == 0);
+    size_t total = 0;
+    for(size_t i = 0; i < taapp::allocator_stats::SIZE_CLASSES; ++i)
+    {
+        total += s.size_histogram[i];
+    }
+    assert(total == s.allocations + s.reallocations);
+    // the vector header of 8 ints falls in the (16, 32] class
+    assert(s.size_histogram[5] >= 1);
+
+    // counters from several threads add up, and the peak reflects the
+    // largest vector within the flush granularity
+    enum { THREADS = 4 };
+    taapp::thread threads[THREADS];
+    for(int i = 0; i < THREADS; ++i)
+    {
+        threads[i].start(&stats_worker, NULL);
+    }
+    for(int i = 0; i < THREADS; ++i)
+    {
+        threads[i].join();
+    }
+    stats_int_allocator::snapshot(s);
+    assert(s.bytes == 0);
+    assert(s.live_allocations == 0);
+    assert(s.peak_bytes + stats_int_allocator::counters::FLUSH_BYTES >=
+        100000 * sizeof(int));
+    stats_int_allocator::counters::reset_peak();
+    stats_int_allocator::snapshot(s);
+    assert(s.peak_bytes == 0);
+
+    // asking for the usable size does not change the counts
+    {
+        stats_int_allocator a;
+        int* p = a.allocate(3);
+        stats_int_allocator::snapshot(s);
+        size_t bytes = s.bytes;
+        // the heap's slack is only reported with taapp_HEAP_USABLE_SIZE
+        assert(a.usable_size(p, 3) == 3);
+        stats_int_allocator::snapshot(s);
+        assert(s.bytes == bytes);
+        a.deallocate(p, 3);
+        stats_int_allocator::snapshot(s);
+        assert(s.bytes == 0);
+    }
+
+#if !defined(_WIN32)
+    // the blocks of exited threads are reused by the threads that follow
+    size_t blocks = count_stats_blocks();
+    for(int i = 0; i < 8; ++i)
+    {
+        taapp::thread t;
+        t.start(&stats_worker, NULL);
+        t.join();
+    }
+    assert(count_stats_blocks() == blocks);
+    stats_int_allocator::snapshot(s);
+    assert(s.bytes == 0);
+#endif
+}
+
+// memory charged to one user of the containers
+struct tenant
+{
+    int live;
+};
+
+// stateful allocator that charges its allocations to a tenant. equal
+// instances free each other's memory, so it does not use the per instance
+// debug counter of its base
+template<typename T>
+class tenant_allocator : public taapp::allocator<T>
+{
+public:
+
+    typedef taapp::allocator<T> base;
+
+    template<typename U> struct rebind
+    {
+        typedef tenant_allocator<U> other;
+    };
+
+    explicit tenant_allocator(tenant& t) : tenant_(&t)
+    {
+    }
+
+    template<typename U>
+    tenant_allocator(const tenant_allocator<U>& a) : tenant_(a.get_tenant())
+    {
+    }
+
+    bool operator==(const tenant_allocator& a) const
+    {
+        return tenant_ == a.tenant_;
+    }
+
+    bool operator!=(const tenant_allocator& a) const
+    {
+        return tenant_ != a.tenant_;
+    }
+
+    tenant* get_tenant() const
+    {
+        return tenant_;
+    }
+
+    T* allocate(size_t n, const void* = 0)
+    {
+        ++tenant_->live;
+        return static_cast<T*>(malloc(sizeof(T) * n));
+    }
+
+    T* reallocate(void* p, size_t oldn, size_t n)
+    {
+        if(p == NULL)
+        {
+            ++tenant_->live;
+        }
+        return static_cast<T*>(realloc(p, sizeof(T) * n));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        --tenant_->live;
+        free(p);
+    }
+
+private:
+
+    tenant* tenant_;
+};
+
+static void test_stateful()
+{
+    typedef tenant_allocator<int> int_allocator;
+    typedef taapp::list<int, int_allocator> int_list;
+    tenant a = { 0 };
+    tenant b = { 0 };
+    {
+        taapp::vector<int, int_allocator> v((int_allocator(a)));
+        int_list la((int_allocator(a)));
+        int_list lb((int_allocator(b)));
+        taapp::map<int, int, int_less, int_allocator> m((int_allocator(b)));
+        taapp::unordered_map<int, int, int_hash, int_equal, int_allocator> u(
+            (int_allocator(a)));
+        for(int i = 0; i < 10; ++i)
+        {
+            taapp::pair<int, int> p = { i, i };
+            v.push_back(i);
+            la.push_back(i);
+            lb.push_back(10 + i);
+            m.insert(p);
+            u.insert(p);
+        }
+        // the node and bucket allocators are rebound from the instance
+        assert(a.live == 1 + 10 + 10 + 1);
+        assert(b.live == 10 + 10);
+        assert(m.get_allocator() == int_allocator(b));
+        assert(u.get_allocator() == int_allocator(a));
+
+        // splicing between tenants copies the items
+        la.splice(la.end(), lb);
+        assert(lb.empty());
+        assert(a.live == 1 + 20 + 10 + 1);
+        assert(b.live == 10);
+
+        // splicing within a tenant relinks the nodes
+        int_list la2((int_allocator(a)));
+        la2.push_back(-1);
+        la.splice(la.begin(), la2);
+        assert(la2.empty());
+        assert(a.live == 1 + 21 + 10 + 1);
+        int_list::const_iterator itr(la.begin());
+        for(int i = -1; i < 20; ++i)
+        {
+            assert(*itr == i);
+            ++itr;
+        }
+        assert(itr == la.end());
+    }
+    assert(a.live == 0);
+    assert(b.live == 0);
+}
+
+// slab allocator that counts the containers' calls to release_all
+static int release_calls = 0;
+
+template<typename T>
+class releasing_allocator : public taapp::slab_allocator<T, 4096>
+{
+public:
+
+    template<typename U> struct rebind
+    {
+        typedef releasing_allocator<U> other;
+    };
+
+    releasing_allocator()
+    {
+    }
+
+    template<typename U> releasing_allocator(const releasing_allocator<U>&)
+    {
+    }
+
+    void release_all()
+    {
+        ++release_calls;
+        taapp::slab_allocator<T, 4096>::release_all();
+    }
+};
+
+// value with a destructor, which must not be skipped by clear
+struct counted
+{
+    static int live;
+
+    counted(int v) : value(v)
+    {
+        ++live;
+    }
+
+    counted(const counted& c) : value(c.value)
+    {
+        ++live;
+    }
+
+    ~counted()
+    {
+        --live;
+    }
+
+    int value;
+};
+
+int counted::live = 0;
+
+static void test_slab()
+{
+    typedef releasing_allocator<int> int_allocator;
+    taapp::list<int, int_allocator> l;
+    taapp::map<int, int, int_less, int_allocator> m;
+    taapp::set<int, int_less, int_allocator> s;
+    taapp::unordered_map<int, int, int_hash, int_equal, int_allocator> u;
+    taapp::list<counted, releasing_allocator<counted> > lc;
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        for(int i = 0; i < 1000; ++i)
+        {
+            taapp::pair<int, int> p = { i, i };
+            l.push_back(i);
+            m.insert(p);
+            s.insert(i);
+            u.insert(p);
+            lc.push_back(counted(i));
+        }
+        assert(counted::live == 1000);
+        assert(m.find(999)->second == 999);
+        assert(u.find(999)->second == 999);
+        assert(s.find(999) != s.end());
+
+        // trivially destructible values are freed with the slabs
+        release_calls = 0;
+        l.clear();
+        m.clear();
+        s.clear();
+        u.clear();
+        assert(release_calls == 4);
+        assert(l.empty() && m.empty() && s.empty() && u.size() == 0);
+        assert(u.find(0) == u.end());
+
+        // the others are destroyed one node at a time
+        lc.clear();
+        assert(release_calls == 4);
+        assert(counted::live == 0);
+        assert(lc.empty());
+    }
+    // destruction without clear
+    for(int i = 0; i < 100; ++i)
+    {
+        taapp::pair<int, int> p = { i, i };
+        m.insert(p);
+        lc.push_back(counted(i));
+    }
+}
+
+// swapped containers take the allocator state that owns their nodes
+static void test_swap()
+{
+    typedef taapp::slab_allocator<int> slab;
+    taapp::list<int, slab> la;
+    taapp::list<int, slab> lb;
+    typedef taapp::stats_allocator<int, taapp::allocator<int> > stats;
+    taapp::map<int, int, int_less, stats> ma;
+    taapp::map<int, int, int_less, stats> mb;
+    for(int i = 0; i < 1000; ++i)
+    {
+        taapp::pair<int, int> p = { i, i };
+        la.push_back(i);
+        ma.insert(p);
+    }
+    lb.push_back(-1);
+    la.swap(lb);
+    ma.swap(mb);
+    assert(la.front() == -1 && la.back() == -1);
+    assert(lb.front() == 0 && lb.back() == 999);
+    assert(ma.empty() && mb.size() == 1000);
+    // the nodes are freed through the allocators that now hold them
+    lb.clear();
+    mb.clear();
+    la.push_back(1);
+    for(int i = 0; i < 10; ++i)
+    {
+        taapp::pair<int, int> p = { i, i };
+        ma.insert(p);
+    }
+    // the debug counters assert on destruction that every block was freed
+}
+
+// orders ascending or descending, as chosen when it was constructed
+struct direction_less
+{
+    bool descending;
+
+    bool operator()(int a, int b) const
+    {
+        return descending ? (b < a) : (a < b);
+    }
+};
+
+struct seeded_hash
+{
+    size_t seed;
+
+    size_t operator()(int a) const
+    {
+        return (static_cast<size_t>(a) ^ seed) * 2654435761u;
+    }
+};
+
+// reclaimed containers keep their own functors
+static void test_reclaimer_functors(taapp::reclaimer& r)
+{
+    direction_less descending = { true };
+    taapp::set<int, direction_less, taapp::allocator<int> > s(
+        descending,
+        taapp::allocator<int>());
+    seeded_hash h = { 7 };
+    typedef taapp::unordered_map<
+        int,
+        int,
+        seeded_hash,
+        int_equal,
+        taapp::allocator<int> > seeded_map;
+    seeded_map u(h, int_equal(), taapp::allocator<int>());
+    u.max_load_factor(2.0f);
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        for(int i = 0; i < 100; ++i)
+        {
+            taapp::pair<int, int> p = { i, i };
+            s.insert(i);
+            u.insert(p);
+        }
+        assert(*s.begin() == 99);
+        r.reclaim(s);
+        r.reclaim(u);
+        assert(s.key_comp().descending);
+        assert(u.hash_function().seed == 7);
+        assert(u.max_load_factor() == 2.0f);
+        s.insert(1);
+        s.insert(2);
+        assert(*s.begin() == 2);
+        s.clear();
+        u.clear();
+    }
+}
+
+// containers emptied in constant time and destroyed on another thread
+static void test_reclaimer()
+{
+    typedef taapp::allocator<int> int_allocator;
+    typedef taapp::slab_allocator<int> slab_allocator;
+    taapp::map<int, int, int_less, int_allocator> m;
+    taapp::set<int, int_less, slab_allocator> s;
+    taapp::unordered_map<int, int, int_hash, int_equal, int_allocator> u;
+    taapp::list<counted, taapp::allocator<counted> > l;
+    taapp::reclaimer r;
+
+    // without the background thread the items are destroyed immediately
+    l.push_back(counted(0));
+    r.reclaim(l);
+    assert(l.empty());
+    assert(counted::live == 0);
+    test_reclaimer_functors(r);
+
+    bool started = r.start();
+    assert(started);
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        for(int i = 0; i < 10000; ++i)
+        {
+            taapp::pair<int, int> p = { i, i };
+            m.insert(p);
+            s.insert(i);
+            u.insert(p);
+            l.push_back(counted(i));
+        }
+        r.reclaim(m);
+        r.reclaim(s);
+        r.reclaim(u);
+        r.reclaim(l);
+        assert(m.size() == 0 && m.find(1) == m.end());
+        assert(s.size() == 0 && s.find(1) == s.end());
+        assert(u.size() == 0 && u.find(1) == u.end());
+        assert(l.empty());
+        r.flush();
+        assert(r.pending() == 0);
+        assert(counted::live == 0);
+    }
+    test_reclaimer_functors(r);
+    // stopping destroys anything still queued
+    for(int i = 0; i < 100; ++i)
+    {
+        l.push_back(counted(i));
+    }
+    r.reclaim(l);
+    r.stop();
+    assert(counted::live == 0);
+}
+
+struct reclaim_args
+{
+    taapp::reclaimer* r;
+    volatile int done;
+};
+
+static void reclaim_until_done(void* arg)
+{
+    reclaim_args* args = static_cast<reclaim_args*>(arg);
+    taapp::list<int, taapp::allocator<int> > l;
+    while(taapp::atomic_load(&args->done) == 0)
+    {
+        l.push_back(1);
+        args->r->reclaim(l);
+        assert(l.empty());
+    }
+}
+
+// containers reclaimed while the reclaimer stops are never left queued
+static void test_reclaimer_stop()
+{
+    for(int i = 0; i < 200; ++i)
+    {
+        taapp::reclaimer r;
+        reclaim_args args = { &r, 0 };
+        bool started = r.start();
+        assert(started);
+        taapp::thread t;
+        started = t.start(&reclaim_until_done, &args);
+        assert(started);
+        r.stop();
+        taapp::atomic_store(&args.done, 1);
+        t.join();
+        assert(r.pending() == 0);
+    }
+}
+
+// containers that live in a file_arena, found through its root
+struct file_root
+{
+    typedef taapp::file_allocator<int> int_allocator;
+
+    taapp::list<int, int_allocator> l;
+    taapp::map<int, int, int_less, int_allocator> m;
+    taapp::set<int, int_less, int_allocator> s;
+    taapp::unordered_map<int, int, int_hash, int_equal, int_allocator> u;
+};
+
+static void check_file_root(file_root* r, int max)
+{
+    taapp::list<int, file_root::int_allocator>::const_iterator itr(
+        r->l.begin());
+    for(int i = 0; i < max; ++i)
+    {
+        assert(*itr == i);
+        ++itr;
+    }
+    assert(itr == r->l.end());
+    assert(r->m.size() == static_cast<size_t>(max / 2));
+    assert(r->s.size() == static_cast<size_t>(max / 2));
+    assert(r->u.size() == static_cast<size_t>(max / 2));
+    for(int i = 1; i < max; i += 2)
+    {
+        assert(r->m.find(i)->second == -i);
+        assert(r->s.find(i) != r->s.end());
+        assert(r->u.find(i)->second == -i);
+    }
+    assert(r->m.find(0) == r->m.end());
+    assert(r->u.find(0) == r->u.end());
+}
+
+// containers built in a file stay valid wherever the file is mapped
+static void test_file_arena()
+{
+    const char* path = "allocatortest.arena";
+    const int max = 10000;
+    assert(taapp::pointer_traits<file_root::int_allocator>::RELATIVE_POINTERS);
+    {
+        taapp::file_arena arena;
+        bool ok = arena.create(path, 16 * 1024 * 1024);
+        assert(ok);
+        taapp::file_arena::set_current(&arena);
+        file_root* r = arena.construct<file_root>();
+        arena.set_root(r);
+        for(int i = 0; i < max; ++i)
+        {
+            typedef taapp::pair<int, int> int_pair;
+            int_pair v = { i, -i };
+            r->l.push_back(i);
+            r->m.insert(v);
+            r->s.insert(i);
+            r->u.insert(v);
+        }
+        for(int i = 0; i < max; i += 2)
+        {
+            r->m.erase(i);
+            r->s.erase(i);
+            r->u.erase(i);
+        }
+        check_file_root(r, max);
+        // freed nodes are reused
+        size_t used = arena.used();
+        taapp::pair<int, int> v = { 0, 0 };
+        r->m.insert(v);
+        r->m.erase(0);
+        assert(arena.used() == used);
+        arena.close();
+        assert(taapp::file_arena::current() == NULL);
+    }
+    {
+        // map the file twice, so the views are at different addresses
+        taapp::file_arena a;
+        taapp::file_arena b;
+        bool ok = a.open(path, false);
+        assert(ok);
+        ok = b.open(path, false);
+        assert(ok);
+        assert(a.root() != b.root());
+        check_file_root(static_cast<file_root*>(a.root()), max);
+        check_file_root(static_cast<file_root*>(b.root()), max);
+    }
+    {
+        // modify the containers after reopening, then destroy them
+        taapp::file_arena arena;
+        bool ok = arena.open(path, true);
+        assert(ok);
+        taapp::file_arena::set_current(&arena);
+        file_root* r = static_cast<file_root*>(arena.root());
+        r->l.clear();
+        for(int i = 0; i < max; ++i)
+        {
+            r->l.push_back(i);
+        }
+        check_file_root(r, max);
+        r->~file_root();
+        arena.deallocate(r, sizeof(file_root));
+        arena.set_root(NULL);
+        taapp::file_arena::set_current(NULL);
+    }
+    remove(path);
+}
+
+int main(int argc, char* argv[])
+{
+    printf("testing taapp::thread_cache_allocator...");
+    fflush(stdout);
+    test_containers<taapp::thread_cache_allocator>();
+    test_bulk();
+    test_stateful();
+    test_remote_free();
+    test_adoption();
+    test_stress();
+    printf("pass\n");
+    printf("testing taapp::stats_allocator...");
+    fflush(stdout);
+    test_stats();
+    printf("pass\n");
+    printf("testing taapp::slab_allocator...");
+    fflush(stdout);
+    test_slab();
+    test_swap();
+    printf("pass\n");
+    printf("testing taapp::reclaimer...");
+    fflush(stdout);
+    test_reclaimer();
+    test_reclaimer_stop();
+    printf("pass\n");
+    printf("testing taapp::file_allocator...");
+    fflush(stdout);
+    test_file_arena();
+    printf("pass\n");
+#if defined(_DEBUG) && defined(_MSC_FULL_VER)
+    _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
+    _CrtSetReportFile(_CRT_ERROR, _CRTDBG_FILE_STDOUT);
+    _CrtCheckMemory();
+    _CrtDumpMemoryLeaks();
+#endif
+    return EXIT_SUCCESS;
+}
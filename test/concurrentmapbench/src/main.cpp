@@ -0,0 +1,206 @@
+/**
+ * @brief     concurrent hash map scaling benchmark
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#include <taapp/allocator.h>
+#include <taapp/concurrent_unordered_map.h>
+#include <taapp/lockfree_unordered_map.h>
+#include <taapp/thread.h>
+#include <taapp/unordered_map.h>
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+struct int_equal
+{
+    bool operator()(int a, int b) const
+    {
+        return a == b;
+    }
+};
+
+struct int_hash
+{
+    size_t operator()(int a) const
+    {
+        return static_cast<size_t>(a) * 2654435761u;
+    }
+};
+
+typedef taapp::unordered_map<
+    int,
+    int,
+    int_hash,
+    int_equal,
+    taapp::allocator<int> > table;
+
+typedef taapp::concurrent_unordered_map<
+    int,
+    int,
+    int_hash,
+    int_equal,
+    taapp::allocator<int> > sharded_table;
+
+typedef taapp::lockfree_unordered_map<
+    int,
+    int,
+    int_hash,
+    int_equal,
+    taapp::allocator<int> > lockfree_table;
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+enum
+{
+    KEYS = 1 << 16,
+    OPS = 1 << 20,
+    MAX_THREADS = 64
+};
+
+// a single unordered_map behind one mutex, as the baseline
+struct locked_table
+{
+    taapp::mutex lock;
+    table map;
+
+    bool find(int k, int& out)
+    {
+        taapp::scoped_lock<taapp::mutex> l(lock);
+        table::iterator itr(map.find(k));
+        if(itr != map.end())
+        {
+            out = itr->second;
+            return true;
+        }
+        return false;
+    }
+
+    void insert_or_assign(int k, int v)
+    {
+        taapp::scoped_lock<taapp::mutex> l(lock);
+        map.insert_or_assign(k, v);
+    }
+};
+
+// updates replace the item, since lock-free values are immutable
+struct replacing_table
+{
+    lockfree_table map;
+
+    bool find(int k, int& out)
+    {
+        return map.find(k, out);
+    }
+
+    void insert_or_assign(int k, int v)
+    {
+        lockfree_table::value_type kv = { k, v };
+        map.erase(k);
+        map.insert(kv);
+    }
+};
+
+template<typename Map> struct worker_args
+{
+    Map* map;
+    // writes per thousand operations
+    int writes;
+    unsigned seed;
+};
+
+template<typename Map> static void worker(void* arg)
+{
+    worker_args<Map>* args = static_cast<worker_args<Map>*>(arg);
+    unsigned x = args->seed;
+    int sink = 0;
+    for(int i = 0; i < OPS; ++i)
+    {
+        // xorshift, so the threads do not share rand's state
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        int k = static_cast<int>(x % KEYS);
+        if(static_cast<int>((x >> 8) % 1000) < args->writes)
+        {
+            args->map->insert_or_assign(k, i);
+        }
+        else
+        {
+            int v;
+            sink += args->map->find(k, v) ? v : 0;
+        }
+    }
+    args->seed = static_cast<unsigned>(sink);
+}
+
+template<typename Map>
+static double run(Map& map, int count, int writes)
+{
+    taapp::thread threads[MAX_THREADS];
+    worker_args<Map> args[MAX_THREADS];
+    double t = now();
+    for(int i = 0; i < count; ++i)
+    {
+        args[i].map = &map;
+        args[i].writes = writes;
+        args[i].seed = 2463534242u + i;
+        threads[i].start(&worker<Map>, &args[i]);
+    }
+    for(int i = 0; i < count; ++i)
+    {
+        threads[i].join();
+    }
+    t = now() - t;
+    return static_cast<double>(OPS) * count / t / 1e6;
+}
+
+int main(int argc, char* argv[])
+{
+    // writes per thousand operations
+    static const int mixes[] = { 0, 1, 100, 500 };
+    int maxthreads = (argc > 1) ? atoi(argv[1]) : MAX_THREADS;
+    if(maxthreads > MAX_THREADS)
+    {
+        maxthreads = MAX_THREADS;
+    }
+    locked_table locked;
+    sharded_table sharded;
+    replacing_table lockfree;
+    for(int i = 0; i < KEYS; ++i)
+    {
+        locked.insert_or_assign(i, i);
+        sharded.insert_or_assign(i, i);
+        lockfree.insert_or_assign(i, i);
+    }
+    printf("lookup and update throughput in millions of operations per "
+        "second\n");
+    printf("%8s %8s %12s %12s %12s\n",
+        "writes",
+        "threads",
+        "mutex",
+        "sharded",
+        "lockfree");
+    for(size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); ++m)
+    {
+        for(int n = 1; n <= maxthreads; n <<= 1)
+        {
+            double base = run(locked, n, mixes[m]);
+            double shard = run(sharded, n, mixes[m]);
+            double lf = run(lockfree, n, mixes[m]);
+            printf("%6.1f%% %8d %12.2f %12.2f %12.2f\n",
+                mixes[m] / 10.0,
+                n,
+                base,
+                shard,
+                lf);
+        }
+    }
+    return EXIT_SUCCESS;
+}
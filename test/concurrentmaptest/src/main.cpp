@@ -0,0 +1,184 @@
+/**
+ * @brief     unit test for taapp::concurrent_unordered_map
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#if defined(_DEBUG) && defined(_MSC_FULL_VER)
+#define _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+// the shards count their lookups, which readers under the shared lock
+// update concurrently
+#define taapp_UNORDERED_MAP_COUNT_PROBES
+#include <taapp/allocator.h>
+#include <taapp/concurrent_unordered_map.h>
+#include <taapp/thread.h>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef NDEBUG
+#error asserts are not enabled
+#endif
+
+struct int_equal
+{
+    bool operator()(int a, int b) const
+    {
+        return a == b;
+    }
+};
+
+struct int_hash
+{
+    size_t operator()(int a) const
+    {
+        return static_cast<size_t>(a) * 2654435761u;
+    }
+};
+
+typedef taapp::concurrent_unordered_map<
+    int,
+    int,
+    int_hash,
+    int_equal,
+    taapp::allocator<int>,
+    16> cmap;
+
+enum
+{
+    THREADS = 8,
+    KEYS = 5000
+};
+
+struct worker_args
+{
+    cmap* map;
+    int id;
+};
+
+// adds one to the value it visits
+struct increment
+{
+    void operator()(cmap::value_type& v)
+    {
+        ++v.second;
+    }
+};
+
+// sums the values it visits
+struct summer
+{
+    long sum;
+    int count;
+
+    void operator()(const cmap::value_type& v)
+    {
+        sum += v.second;
+        ++count;
+    }
+};
+
+// each worker owns the keys congruent to its id and reads everyone's
+static void worker(void* arg)
+{
+    worker_args* args = static_cast<worker_args*>(arg);
+    cmap& map = *args->map;
+    for(int i = args->id; i < KEYS; i += THREADS)
+    {
+        cmap::value_type v = { i, i };
+        bool inserted = map.insert(v);
+        assert(inserted);
+        inserted = map.insert(v);
+        assert(!inserted);
+    }
+    increment inc;
+    for(int i = args->id; i < KEYS; i += THREADS)
+    {
+        bool found = map.visit(i, inc);
+        assert(found);
+        int value = -1;
+        found = map.find(i, value);
+        assert(found && value == i + 1);
+        // another worker's key is either absent or holds a value that
+        // worker wrote
+        int other = (i + 1) % KEYS;
+        if(map.find(other, value))
+        {
+            assert(value == other || value == other + 1 || value == -other);
+        }
+    }
+    for(int i = args->id; i < KEYS; i += THREADS)
+    {
+        if(i % 2 == 0)
+        {
+            bool erased = map.erase(i);
+            assert(erased);
+            assert(!map.contains(i));
+        }
+        else
+        {
+            bool inserted = map.insert_or_assign(i, -i);
+            assert(!inserted);
+        }
+    }
+}
+
+static void test_concurrent()
+{
+    cmap map;
+    worker_args args[THREADS];
+    taapp::thread threads[THREADS];
+    for(int i = 0; i < THREADS; ++i)
+    {
+        args[i].map = &map;
+        args[i].id = i;
+        bool started = threads[i].start(&worker, &args[i]);
+        assert(started);
+    }
+    for(int i = 0; i < THREADS; ++i)
+    {
+        threads[i].join();
+    }
+    // the odd keys remain, each holding its negation
+    assert(map.size() == KEYS / 2);
+    summer s = { 0, 0 };
+    const cmap& cm = map;
+    cm.visit_all(s);
+    assert(s.count == KEYS / 2);
+    long expected = 0;
+    for(int i = 1; i < KEYS; i += 2)
+    {
+        expected -= i;
+    }
+    assert(s.sum == expected);
+    increment inc;
+    map.visit_all(inc);
+    int value = 0;
+    assert(map.find(1, value) && value == 0);
+    assert(!map.find(2, value));
+    assert(!map.visit(2, inc));
+    bool inserted = map.insert_or_assign(2, 7);
+    assert(inserted);
+    assert(cm.visit(2, s));
+    map.clear();
+    assert(map.size() == 0);
+    assert(!map.contains(1));
+}
+
+int main(int argc, char* argv[])
+{
+    printf("testing taapp::concurrent_unordered_map...");
+    fflush(stdout);
+    test_concurrent();
+    printf("pass\n");
+#if defined(_DEBUG) && defined(_MSC_FULL_VER)
+    _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
+    _CrtSetReportFile(_CRT_ERROR, _CRTDBG_FILE_STDOUT);
+    _CrtCheckMemory();
+    _CrtDumpMemoryLeaks();
+#endif
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1 @@
+#include "src/main.cpp"
@@ -0,0 +1,109 @@
+/**
+ * @brief     frozen_unordered_map build and lookup benchmark
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#include <taapp/frozen_unordered_map.h>
+#include <taapp/thread.h>
+#include <taapp/unordered_map.h>
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+typedef taapp::unordered_map<int, int> table;
+typedef taapp::frozen_unordered_map<int, int> frozen_table;
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+enum
+{
+    PROBES = 1 << 22
+};
+
+// random keys, half of which are in a table of size keys
+static void make_probes(int* probes, int size)
+{
+    for(int i = 0; i < PROBES; ++i)
+    {
+        probes[i] = rand() % (size * 2);
+    }
+}
+
+// millions of probes per second
+template<typename Map>
+static double run_find(const Map& t, const int* probes, long& hits)
+{
+    double s = now();
+    for(int i = 0; i < PROBES; ++i)
+    {
+        hits += (t.find(probes[i]) != t.end()) ? 1 : 0;
+    }
+    return PROBES / (now() - s) / 1e6;
+}
+
+// millions of keys per second built into f by threads threads
+static double run_build(frozen_table& f, const table& t, size_t threads)
+{
+    double s = now();
+    if(!f.build(t, threads))
+    {
+        printf("build failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return t.size() / (now() - s) / 1e6;
+}
+
+int main(int argc, char* argv[])
+{
+    int maxsize = (argc > 1) ? atoi(argv[1]) : (1 << 24);
+    size_t threads = taapp::thread::hardware_concurrency();
+    int* probes = static_cast<int*>(malloc(sizeof(int) * PROBES));
+    printf("lookup throughput in millions of probes per second, and build "
+        "throughput\nin millions of keys per second with 1 and %lu threads\n",
+        static_cast<unsigned long>(threads));
+    printf("%10s %10s %10s %10s %10s\n",
+        "size",
+        "unordered",
+        "frozen",
+        "build 1",
+        "build n");
+    for(int size = 1 << 12; size <= maxsize; size <<= 2)
+    {
+        table t;
+        for(int i = 0; i < size; ++i)
+        {
+            int k = static_cast<int>(
+                (static_cast<unsigned>(i) * 2654435761u) %
+                    static_cast<unsigned>(size));
+            table::value_type v = { k, k };
+            t.insert(v);
+        }
+        frozen_table f;
+        double build1 = run_build(f, t, 1);
+        double buildn = run_build(f, t, threads);
+        make_probes(probes, size);
+        long hits = 0;
+        long frozenhits = 0;
+        double unordered = run_find(t, probes, hits);
+        double frozen = run_find(f, probes, frozenhits);
+        if(hits != frozenhits)
+        {
+            printf("mismatched results\n");
+            return EXIT_FAILURE;
+        }
+        printf("%10d %10.2f %10.2f %10.2f %10.2f\n",
+            size,
+            unordered,
+            frozen,
+            build1,
+            buildn);
+    }
+    free(probes);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,166 @@
+/**
+ * @brief     unit test for taapp::frozen_unordered_map
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#if defined(_DEBUG) && defined(_MSC_FULL_VER)
+#define _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <taapp/allocator.h>
+#include <taapp/frozen_unordered_map.h>
+#include <taapp/hash.h>
+#include <taapp/unordered_map.h>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef NDEBUG
+#error asserts are not enabled
+#endif
+
+// sends every key to a handful of hashes
+struct collide_hash
+{
+    size_t operator()(int a) const
+    {
+        return static_cast<size_t>(a % 7);
+    }
+};
+
+typedef taapp::frozen_unordered_map<int, int> frozen_map;
+typedef taapp::pair<int, int> int_pair;
+
+enum
+{
+    KEYS = 200000,
+    RANGE_KEYS = 5000
+};
+
+// every key is found with its value, exactly once, and nothing else is
+static void check(const frozen_map& map, int count, int stride)
+{
+    assert(map.size() == static_cast<size_t>(count));
+    assert(map.end() - map.begin() == count);
+    static unsigned char seen[KEYS];
+    memset(seen, 0, sizeof(seen));
+    frozen_map::const_iterator itr = map.begin();
+    while(itr != map.end())
+    {
+        assert(itr->first % stride == 0);
+        assert(itr->second == -itr->first);
+        int i = itr->first / stride;
+        assert(i >= 0 && i < count && seen[i] == 0);
+        seen[i] = 1;
+        ++itr;
+    }
+    for(int i = 0; i < count; ++i)
+    {
+        frozen_map::const_iterator f = map.find(i * stride);
+        assert(f != map.end() && f->second == -i * stride);
+        assert(!map.contains(i * stride + 1));
+    }
+    assert(!map.contains(-stride));
+}
+
+static void test_from_map()
+{
+    taapp::unordered_map<int, int> source;
+    for(int i = 0; i < KEYS; ++i)
+    {
+        source.insert_or_assign(i * 3, -i * 3);
+    }
+    frozen_map map;
+    assert(map.empty() && !map.contains(0));
+    assert(map.build(source, 1));
+    check(map, KEYS, 3);
+    // several threads build the same map
+    assert(map.build(source, 4));
+    check(map, KEYS, 3);
+    // threads picked from the processor count
+    assert(map.build(source));
+    check(map, KEYS, 3);
+    taapp::unordered_map<int, int> empty;
+    assert(map.build(empty));
+    assert(map.empty() && map.begin() == map.end() && !map.contains(0));
+}
+
+static void test_from_range()
+{
+    static int_pair pairs[RANGE_KEYS + 1];
+    frozen_map map;
+    // sizes around the partition and bucket sizes
+    static const int counts[] = {
+        1, 2, 3, 5, 100, 2047, 2048, 2049, RANGE_KEYS
+    };
+    for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+    {
+        for(int i = 0; i < counts[c]; ++i)
+        {
+            pairs[i].first = i * 5;
+            pairs[i].second = -i * 5;
+        }
+        assert(map.build(pairs, pairs + counts[c], 2));
+        check(map, counts[c], 5);
+    }
+    // a duplicate key fails and leaves the map as it was
+    pairs[RANGE_KEYS].first = 10;
+    pairs[RANGE_KEYS].second = 7;
+    assert(!map.build(pairs, pairs + RANGE_KEYS + 1));
+    check(map, RANGE_KEYS, 5);
+    // so do distinct keys with equal hashes
+    taapp::frozen_unordered_map<int, int, collide_hash> collide;
+    int_pair one[] = { { 1, 1 } };
+    assert(collide.build(one, one + 1));
+    assert(collide.contains(1) && !collide.contains(8));
+    assert(!collide.build(pairs, pairs + 20));
+    assert(collide.size() == 1 && collide.contains(1));
+    map.clear();
+    assert(map.empty() && !map.contains(0));
+}
+
+static void test_strings()
+{
+    static const char* names[] = {
+        "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta"
+    };
+    enum
+    {
+        NAMES = sizeof(names) / sizeof(names[0])
+    };
+    taapp::pair<const char*, int> pairs[NAMES];
+    for(int i = 0; i < NAMES; ++i)
+    {
+        pairs[i].first = names[i];
+        pairs[i].second = i;
+    }
+    taapp::frozen_unordered_map<
+        const char*,
+        int,
+        taapp::string_hash,
+        taapp::string_equal> map;
+    assert(map.build(pairs, pairs + NAMES));
+    char key[] = "delta";
+    assert(map.find(key) != map.end() && map.find(key)->second == 3);
+    assert(!map.contains("iota"));
+}
+
+int main(int argc, char* argv[])
+{
+    printf("testing taapp::frozen_unordered_map...");
+    fflush(stdout);
+    test_from_map();
+    test_from_range();
+    test_strings();
+    printf("pass\n");
+#if defined(_DEBUG) && defined(_MSC_FULL_VER)
+    _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
+    _CrtSetReportFile(_CRT_ERROR, _CRTDBG_FILE_STDOUT);
+    _CrtCheckMemory();
+    _CrtDumpMemoryLeaks();
+#endif
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,209 @@
+/**
+ * @brief     hash function throughput and distribution benchmark
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#include <taapp/hash.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+
+// the multiplicative hash the tests and benchmarks have been using
+struct int_hash
+{
+    size_t operator()(int a) const
+    {
+        return static_cast<size_t>(a) * 2654435761u;
+    }
+};
+
+// 64 bit FNV-1a, the usual hand written byte hash
+struct fnv_hash
+{
+    size_t operator()(const void* p, size_t len) const
+    {
+        const unsigned char* b = static_cast<const unsigned char*>(p);
+        unsigned long long h = 14695981039346656037ull;
+        for(size_t i = 0; i < len; ++i)
+        {
+            h ^= b[i];
+            h *= 1099511628211ull;
+        }
+        return static_cast<size_t>(h);
+    }
+};
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+enum
+{
+    BUFFER = 1 << 16,
+    BYTES = 1 << 28,
+    KEYS = 1 << 17,
+    PRIME_BUCKETS = 196613,
+    POW2_BUCKETS = 1 << 17,
+    KEY_LENGTH = 16
+};
+
+// gigabytes hashed per second in keys of len bytes
+template<typename H>
+static double run_bytes(const H& h, const unsigned char* buf, size_t len)
+{
+    size_t count = BYTES / len;
+    size_t mask = BUFFER - len;
+    size_t sink = 0;
+    double t = now();
+    for(size_t i = 0; i < count; ++i)
+    {
+        // vary the offset so that the hashes do not fold into a constant
+        sink += h(buf + ((i * 64) & mask), len);
+    }
+    t = now() - t;
+    if(sink == 1)
+    {
+        printf(" ");
+    }
+    return static_cast<double>(count) * len / t / 1e9;
+}
+
+// millions of integers hashed per second
+template<typename H> static double run_ints(const H& h, const int* keys)
+{
+    size_t sink = 0;
+    double t = now();
+    for(int i = 0; i < BYTES / 4; ++i)
+    {
+        sink += h(keys[i & (KEYS - 1)]);
+    }
+    t = now() - t;
+    if(sink == 1)
+    {
+        printf(" ");
+    }
+    return BYTES / 4 / t / 1e6;
+}
+
+// longest chain and share of empty buckets for hashes h in n buckets
+static void print_chains(
+    const char* name,
+    const size_t* h,
+    size_t nbuckets,
+    bool pow2)
+{
+    static unsigned int counts[PRIME_BUCKETS];
+    memset(counts, 0, sizeof(counts));
+    for(size_t i = 0; i < KEYS; ++i)
+    {
+        size_t b = pow2 ? (h[i] & (nbuckets - 1)) : (h[i] % nbuckets);
+        ++counts[b];
+    }
+    unsigned int longest = 0;
+    size_t empty = 0;
+    for(size_t i = 0; i < nbuckets; ++i)
+    {
+        longest = (counts[i] > longest) ? counts[i] : longest;
+        empty += (counts[i] == 0);
+    }
+    printf("%14s %10s %8u %9.1f%%\n",
+        name,
+        pow2 ? "pow2" : "prime",
+        longest,
+        100.0 * empty / nbuckets);
+}
+
+static void print_distributions(const char* keyset, const int* keys)
+{
+    static size_t h[KEYS];
+    printf("%s\n", keyset);
+    for(int pow2 = 0; pow2 < 2; ++pow2)
+    {
+        size_t nbuckets = pow2 ? POW2_BUCKETS : PRIME_BUCKETS;
+        for(size_t i = 0; i < KEYS; ++i)
+        {
+            h[i] = int_hash()(keys[i]);
+        }
+        print_chains("multiplicative", h, nbuckets, pow2 != 0);
+        for(size_t i = 0; i < KEYS; ++i)
+        {
+            h[i] = taapp::hash<int>()(keys[i]);
+        }
+        print_chains("taapp::hash", h, nbuckets, pow2 != 0);
+    }
+}
+
+static void print_string_distributions()
+{
+    static size_t h[KEYS];
+    static char names[KEYS][KEY_LENGTH];
+    for(size_t i = 0; i < KEYS; ++i)
+    {
+        memset(names[i], 0, KEY_LENGTH);
+        sprintf(names[i], "user%lu", static_cast<unsigned long>(i));
+    }
+    printf("strings \"user0\" to \"user%d\"\n", KEYS - 1);
+    for(int pow2 = 0; pow2 < 2; ++pow2)
+    {
+        size_t nbuckets = pow2 ? POW2_BUCKETS : PRIME_BUCKETS;
+        for(size_t i = 0; i < KEYS; ++i)
+        {
+            h[i] = fnv_hash()(names[i], strlen(names[i]));
+        }
+        print_chains("fnv-1a", h, nbuckets, pow2 != 0);
+        for(size_t i = 0; i < KEYS; ++i)
+        {
+            h[i] = taapp::string_hash()(names[i]);
+        }
+        print_chains("taapp::hash", h, nbuckets, pow2 != 0);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    static unsigned char buf[BUFFER];
+    for(size_t i = 0; i < BUFFER; ++i)
+    {
+        buf[i] = static_cast<unsigned char>(rand());
+    }
+    printf("byte hash throughput in GB/s\n");
+    printf("%8s %12s %12s\n", "bytes", "fnv-1a", "taapp::hash");
+    static const size_t lengths[] = { 8, 16, 32, 64, 256, 1024, 4096, 16384 };
+    for(size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l)
+    {
+        printf("%8lu %12.2f %12.2f\n",
+            static_cast<unsigned long>(lengths[l]),
+            run_bytes(fnv_hash(), buf, lengths[l]),
+            run_bytes(taapp::byte_hash(), buf, lengths[l]));
+    }
+    static int keys[KEYS];
+    for(int i = 0; i < KEYS; ++i)
+    {
+        keys[i] = i;
+    }
+    printf("\ninteger hash throughput in millions per second\n");
+    printf("%14s %12.2f\n", "multiplicative", run_ints(int_hash(), keys));
+    printf("%14s %12.2f\n",
+        "taapp::hash",
+        run_ints(taapp::hash<int>(), keys));
+    printf("\nlongest chain and empty buckets for %d keys\n", KEYS);
+    printf("%14s %10s %8s %10s\n", "hash", "buckets", "longest", "empty");
+    print_distributions("sequential integers", keys);
+    for(int i = 0; i < KEYS; ++i)
+    {
+        keys[i] = i << 12;
+    }
+    print_distributions("integers with a stride of 4096", keys);
+    for(int i = 0; i < KEYS; ++i)
+    {
+        keys[i] = (rand() << 16) ^ rand();
+    }
+    print_distributions("random integers", keys);
+    print_string_distributions();
+    return EXIT_SUCCESS;
+}
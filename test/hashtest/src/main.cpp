@@ -0,0 +1,163 @@
+/**
+ * @brief     unit test for taapp::hash
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#if defined(_DEBUG) && defined(_MSC_FULL_VER)
+#define _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#define taapp_HASH_INTERNAL_API
+#include <taapp/hash.h>
+#include <taapp/unordered_map.h>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef NDEBUG
+#error asserts are not enabled
+#endif
+
+enum
+{
+    BUFFER = 4096
+};
+
+static void fill(unsigned char* buf, size_t len)
+{
+    unsigned x = 2463534242u;
+    for(size_t i = 0; i < len; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = static_cast<unsigned char>(x);
+    }
+}
+
+// the vector path must agree with the scalar one at any length and offset
+static void test_simd()
+{
+    static unsigned char buf[BUFFER + 16];
+    fill(buf, sizeof(buf));
+    unsigned long long key[taapp::byte_hash::KEY_LANES];
+    taapp::byte_hash::make_key(key, 12345);
+    for(size_t offset = 0; offset < 8; ++offset)
+    {
+        for(size_t n = 0; n < 20; ++n)
+        {
+            unsigned long long a[taapp::byte_hash::LANES];
+            unsigned long long b[taapp::byte_hash::LANES];
+            for(size_t i = 0; i < taapp::byte_hash::LANES; ++i)
+            {
+                a[i] = b[i] = i * 0x0123456789abcdefull;
+            }
+            taapp::byte_hash::accumulate_scalar(a, buf + offset, n, key);
+            taapp::byte_hash::accumulate_simd(b, buf + offset, n, key);
+            for(size_t i = 0; i < taapp::byte_hash::LANES; ++i)
+            {
+                assert(a[i] == b[i]);
+            }
+        }
+    }
+}
+
+// flipping any one bit of a key changes its hash
+static void test_bytes()
+{
+    static unsigned char buf[BUFFER];
+    fill(buf, sizeof(buf));
+    static const size_t lengths[] = {
+        0, 1, 2, 3, 4, 7, 8, 9, 15, 16, 17, 31, 32, 33, 47, 48, 49, 63, 64,
+        65, 96, 255, 256, 257, 300, 511, 512, 513, 1000, 4096
+    };
+    for(size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l)
+    {
+        size_t len = lengths[l];
+        size_t h = taapp::hash_bytes(buf, len);
+        assert(h == taapp::byte_hash()(buf, len));
+        assert(h != taapp::byte_hash(1)(buf, len));
+        for(size_t i = 0; i < len * 8; i += (len > 64) ? 7 : 1)
+        {
+            buf[i / 8] ^= static_cast<unsigned char>(1 << (i % 8));
+            assert(taapp::hash_bytes(buf, len) != h);
+            buf[i / 8] ^= static_cast<unsigned char>(1 << (i % 8));
+        }
+        // a prefix hashes differently from the whole
+        if(len > 0)
+        {
+            assert(taapp::hash_bytes(buf, len - 1) != h);
+        }
+    }
+}
+
+static void test_functors()
+{
+    // the mixer is a bijection, so small integers never collide
+    taapp::unordered_map<size_t, int> seen;
+    taapp::hash<int> ih;
+    for(int i = -1000; i < 1000; ++i)
+    {
+        bool inserted = seen.insert_or_assign(ih(i), i).second;
+        assert(inserted);
+    }
+    assert(taapp::hash<long>()(5) == taapp::hash<unsigned long>()(5));
+    assert(taapp::hash<float>()(0.0f) == taapp::hash<float>()(-0.0f));
+    assert(taapp::hash<double>()(1.0) != taapp::hash<double>()(2.0));
+    int a = 0;
+    int b = 0;
+    assert(taapp::hash<int*>()(&a) != taapp::hash<int*>()(&b));
+    taapp::pair<int, int> p01 = { 0, 1 };
+    taapp::pair<int, int> p10 = { 1, 0 };
+    taapp::hash<taapp::pair<int, int> > ph;
+    assert(ph(p01) != ph(p10));
+    assert(taapp::hash_combine(1, 2) != taapp::hash_combine(2, 1));
+    char s1[] = "routing";
+    char s2[] = "routing";
+    assert(taapp::string_hash()(s1) == taapp::hash_bytes("routing", 7));
+    assert(taapp::string_equal()(s1, s2));
+    assert(!taapp::string_equal()(s1, "route"));
+    assert(taapp::equal_to<int>()(3, 3));
+}
+
+// the maps pick up the default functors and allocator
+static void test_defaults()
+{
+    taapp::unordered_map<int, int> m;
+    for(int i = 0; i < 1000; ++i)
+    {
+        taapp::pair<int, int> v = { i, -i };
+        m.insert(v);
+    }
+    assert(m.size() == 1000);
+    assert(m.find(7) != m.end() && m.find(7)->second == -7);
+    taapp::unordered_map<
+        const char*,
+        int,
+        taapp::string_hash,
+        taapp::string_equal> names;
+    char key[] = "beta";
+    names.insert_or_assign("alpha", 1);
+    names.insert_or_assign("beta", 2);
+    assert(names.find(key) != names.end() && names.find(key)->second == 2);
+}
+
+int main(int argc, char* argv[])
+{
+    printf("testing taapp::hash...");
+    fflush(stdout);
+    test_simd();
+    test_bytes();
+    test_functors();
+    test_defaults();
+    printf("pass\n");
+#if defined(_DEBUG) && defined(_MSC_FULL_VER)
+    _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
+    _CrtSetReportFile(_CRT_ERROR, _CRTDBG_FILE_STDOUT);
+    _CrtCheckMemory();
+    _CrtDumpMemoryLeaks();
+#endif
+    return EXIT_SUCCESS;
+}
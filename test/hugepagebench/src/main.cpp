@@ -0,0 +1,172 @@
+/**
+ * @brief     random access benchmark for taapp::hugepage_allocator
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#include <taapp/allocator.h>
+#include <taapp/hugepage_allocator.h>
+#include <taapp/vector.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// counts data TLB load misses for the calling thread. reports -1 if the
+// kernel does not expose the counter (e.g. inside some containers)
+class tlb_counter
+{
+public:
+
+    tlb_counter() : fd_(-1)
+    {
+#if defined(__linux__)
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config =
+            PERF_COUNT_HW_CACHE_DTLB |
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(
+            syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+
+    ~tlb_counter()
+    {
+#if defined(__linux__)
+        if(fd_ >= 0)
+        {
+            close(fd_);
+        }
+#endif
+    }
+
+    void start()
+    {
+#if defined(__linux__)
+        if(fd_ >= 0)
+        {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    long long stop()
+    {
+        long long count = -1;
+#if defined(__linux__)
+        if(fd_ >= 0)
+        {
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if(read(fd_, &count, sizeof(count)) != sizeof(count))
+            {
+                count = -1;
+            }
+        }
+#endif
+        return count;
+    }
+
+private:
+    int fd_;
+};
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct result
+{
+    double seconds;
+    long long tlbmisses;
+    size_t checksum;
+};
+
+template<typename Allocator>
+result run(size_t count, size_t probes)
+{
+    typedef taapp::vector<size_t, Allocator> size_vector;
+    size_vector v;
+    v.resize(count);
+    for(size_t i = 0; i < count; ++i)
+    {
+        v[i] = i * 2654435761u;
+    }
+    tlb_counter tlb;
+    result r;
+    size_t x = 88172645463325252ull;
+    size_t sum = 0;
+    double t = now();
+    tlb.start();
+    for(size_t i = 0; i < probes; ++i)
+    {
+        // xorshift keeps the access pattern random and cheap to generate
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        sum += v[x % count];
+    }
+    r.tlbmisses = tlb.stop();
+    r.seconds = now() - t;
+    r.checksum = sum;
+    return r;
+}
+
+static void report(const char* name, const result& r, size_t probes)
+{
+    printf(
+        "%-20s %8.3f s  %7.2f ns/probe",
+        name,
+        r.seconds,
+        r.seconds * 1e9 / probes);
+    if(r.tlbmisses >= 0)
+    {
+        printf("  %12lld dTLB misses", r.tlbmisses);
+    }
+    else
+    {
+        printf("  dTLB misses n/a");
+    }
+    printf("  (checksum %zx)\n", r.checksum);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t megabytes = (argc > 1) ? strtoul(argv[1], NULL, 10) : 512;
+    size_t probes = (argc > 2) ? strtoul(argv[2], NULL, 10) : 50000000;
+    size_t count = (megabytes << 20) / sizeof(size_t);
+    printf(
+        "random access over %zu MB, %zu probes\n",
+        megabytes,
+        probes);
+    result base = run<taapp::allocator<size_t> >(count, probes);
+    report("allocator", base, probes);
+    result huge = run<taapp::hugepage_allocator<size_t> >(count, probes);
+    report("hugepage_allocator", huge, probes);
+    printf("speedup: %.2fx", base.seconds / huge.seconds);
+    if(base.tlbmisses > 0 && huge.tlbmisses >= 0)
+    {
+        printf(
+            "  dTLB miss reduction: %.1f%%",
+            100.0 * (base.tlbmisses - huge.tlbmisses) / base.tlbmisses);
+    }
+    printf("\n");
+    return EXIT_SUCCESS;
+}
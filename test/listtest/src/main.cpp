@@ -206,6 +206,55 @@ void test_list()
         assert(list.front() == 1);
         assert(list.back() == 5);
     }
+    {
+        // range insert and clear
+        int_list list;
+        T values[] = { 1, 2, 3 };
+        list.push_back(0);
+        list.push_back(4);
+        typename int_list::iterator pos(list.begin());
+        ++pos;
+        pos = list.insert(pos, values, values + 3);
+        assert(*pos == 1);
+        typename int_list::const_iterator itr(list.begin());
+        typename int_list::const_iterator end(list.end());
+        int i = 0;
+        while(itr != end)
+        {
+            assert(*itr == i);
+            ++i;
+            ++itr;
+        }
+        assert(i == 5);
+        list.clear();
+        assert(list.empty());
+        pos = list.insert(list.end(), values, values);
+        assert(pos == list.end());
+        list.push_back(5);
+        assert(list.front() == 5);
+    }
+    {
+        // swap with empty and non-empty lists
+        int_list list;
+        int_list list2;
+        list.push_back(0);
+        list.push_back(1);
+        list.swap(list2);
+        assert(list.empty());
+        assert(list2.front() == 0 && list2.back() == 1);
+        list.push_back(2);
+        list.swap(list2);
+        assert(list2.front() == 2 && list2.back() == 2);
+        assert(list.front() == 0 && list.back() == 1);
+        assert(++(++list.begin()) == list.end());
+        assert(++list2.begin() == list2.end());
+        list2.clear();
+        list2.swap(list);
+        assert(list.empty());
+        assert(list.begin() == list.end());
+        list.push_front(3);
+        assert(list.front() == 3);
+    }
     assert(listtest_instance_counter == 0);
     assert(listtest_allocate_counter == 0);
     assert(listtest_construct_counter == 0);
@@ -0,0 +1,222 @@
+/**
+ * @brief     unit test for taapp::lockfree_unordered_map
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#if defined(_DEBUG) && defined(_MSC_FULL_VER)
+#define _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <taapp/allocator.h>
+#include <taapp/atomic.h>
+#include <taapp/lockfree_unordered_map.h>
+#include <taapp/thread.h>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef NDEBUG
+#error asserts are not enabled
+#endif
+
+struct int_equal
+{
+    bool operator()(int a, int b) const
+    {
+        return a == b;
+    }
+};
+
+struct int_hash
+{
+    size_t operator()(int a) const
+    {
+        return static_cast<size_t>(a) * 2654435761u;
+    }
+};
+
+// sends every key to a handful of hashes, so that items share split keys
+struct collide_hash
+{
+    size_t operator()(int a) const
+    {
+        return static_cast<size_t>(a % 7);
+    }
+};
+
+typedef taapp::lockfree_unordered_map<
+    int,
+    int,
+    int_hash,
+    int_equal,
+    taapp::allocator<int> > lfmap;
+
+typedef taapp::lockfree_unordered_map<
+    int,
+    int,
+    collide_hash,
+    int_equal,
+    taapp::allocator<int> > collide_map;
+
+enum
+{
+    WRITERS = 4,
+    READERS = 4,
+    KEYS = 20000,
+    ROUNDS = 4
+};
+
+struct worker_args
+{
+    lfmap* map;
+    int id;
+    volatile int* done;
+};
+
+// copies the value it visits
+struct copier
+{
+    int value;
+
+    void operator()(const lfmap::value_type& v)
+    {
+        value = v.second;
+    }
+};
+
+// each writer owns the keys congruent to its id. the odd keys keep their
+// value and the even keys are erased and inserted again every round
+static void writer(void* arg)
+{
+    worker_args* args = static_cast<worker_args*>(arg);
+    lfmap& map = *args->map;
+    for(int i = args->id; i < KEYS; i += WRITERS)
+    {
+        lfmap::value_type v = { i, i };
+        bool inserted = map.insert(v);
+        assert(inserted);
+        inserted = map.insert(v);
+        assert(!inserted);
+    }
+    for(int r = 0; r < ROUNDS; ++r)
+    {
+        for(int i = args->id; i < KEYS; i += WRITERS)
+        {
+            if(i % 2 == 0)
+            {
+                bool erased = map.erase(i);
+                assert(erased);
+                assert(!map.contains(i));
+                erased = map.erase(i);
+                assert(!erased);
+                lfmap::value_type v = { i, i };
+                bool inserted = map.insert(v);
+                assert(inserted);
+            }
+            int value = -1;
+            bool found = map.find(i, value);
+            assert(found && value == i);
+        }
+    }
+}
+
+// every key a reader finds holds the value it was inserted with
+static void reader(void* arg)
+{
+    worker_args* args = static_cast<worker_args*>(arg);
+    const lfmap& map = *args->map;
+    int i = args->id;
+    while(taapp::atomic_load(args->done) == 0)
+    {
+        i = (i + 7919) % KEYS;
+        int value = -1;
+        if(map.find(i, value))
+        {
+            assert(value == i);
+        }
+        copier c = { -1 };
+        if(map.visit(i, c))
+        {
+            assert(c.value == i);
+        }
+    }
+}
+
+static void test_concurrent()
+{
+    lfmap map;
+    volatile int done = 0;
+    worker_args args[WRITERS + READERS];
+    taapp::thread threads[WRITERS + READERS];
+    for(int i = 0; i < WRITERS + READERS; ++i)
+    {
+        args[i].map = &map;
+        args[i].id = (i < WRITERS) ? i : i * 31;
+        args[i].done = &done;
+        bool started = threads[i].start(
+            (i < WRITERS) ? &writer : &reader,
+            &args[i]);
+        assert(started);
+    }
+    for(int i = 0; i < WRITERS; ++i)
+    {
+        threads[i].join();
+    }
+    taapp::atomic_store(&done, 1);
+    for(int i = WRITERS; i < WRITERS + READERS; ++i)
+    {
+        threads[i].join();
+    }
+    assert(map.size() == KEYS);
+    // the table grew as it filled
+    assert(map.bucket_count() * 2 >= KEYS);
+    for(int i = 0; i < KEYS; ++i)
+    {
+        int value = -1;
+        assert(map.find(i, value) && value == i);
+    }
+    assert(!map.contains(KEYS));
+    // the allocators assert on destruction that every node was freed
+}
+
+static void test_collisions()
+{
+    collide_map map;
+    for(int i = 0; i < 100; ++i)
+    {
+        collide_map::value_type v = { i, -i };
+        assert(map.insert(v));
+        assert(!map.insert(v));
+    }
+    assert(map.size() == 100);
+    for(int i = 0; i < 100; i += 3)
+    {
+        assert(map.erase(i));
+        assert(!map.erase(i));
+    }
+    for(int i = 0; i < 100; ++i)
+    {
+        int value = 1;
+        bool found = map.find(i, value);
+        assert(found == (i % 3 != 0));
+        assert(!found || value == -i);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    printf("testing taapp::lockfree_unordered_map...");
+    fflush(stdout);
+    test_concurrent();
+    test_collisions();
+    printf("pass\n");
+#if defined(_DEBUG) && defined(_MSC_FULL_VER)
+    _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
+    _CrtSetReportFile(_CRT_ERROR, _CRTDBG_FILE_STDOUT);
+    _CrtCheckMemory();
+    _CrtDumpMemoryLeaks();
+#endif
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+/**
+ * @brief     mapped_unordered_map startup and lookup benchmark
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#include <taapp/mapped_unordered_map.h>
+#include <taapp/unordered_map.h>
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+typedef taapp::unordered_map<int, int> table;
+typedef taapp::mapped_unordered_map<int, int> mapped_table;
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+enum
+{
+    PROBES = 1 << 22
+};
+
+// random keys, half of which are in a table of size keys
+static void make_probes(int* probes, int size)
+{
+    for(int i = 0; i < PROBES; ++i)
+    {
+        probes[i] = rand() % (size * 2);
+    }
+}
+
+// millions of probes per second
+static double run_find(const table& t, const int* probes, long& hits)
+{
+    double s = now();
+    for(int i = 0; i < PROBES; ++i)
+    {
+        hits += (t.find(probes[i]) != t.end()) ? 1 : 0;
+    }
+    return PROBES / (now() - s) / 1e6;
+}
+
+static double run_find(const mapped_table& t, const int* probes, long& hits)
+{
+    double s = now();
+    for(int i = 0; i < PROBES; ++i)
+    {
+        hits += (t.find(probes[i]) != NULL) ? 1 : 0;
+    }
+    return PROBES / (now() - s) / 1e6;
+}
+
+int main(int argc, char* argv[])
+{
+    int maxsize = (argc > 1) ? atoi(argv[1]) : (1 << 24);
+    const char* path = "mappedmapbench.table";
+    int* probes = static_cast<int*>(malloc(sizeof(int) * PROBES));
+    printf("milliseconds to insert every item or to open the file, and "
+        "lookup\nthroughput in millions of probes per second\n");
+    printf("%10s %10s %10s %10s %10s\n",
+        "size",
+        "insert",
+        "open",
+        "unordered",
+        "mapped");
+    for(int size = 1 << 12; size <= maxsize; size <<= 2)
+    {
+        double insert = now();
+        table t;
+        for(int i = 0; i < size; ++i)
+        {
+            int k = static_cast<int>(
+                (static_cast<unsigned>(i) * 2654435761u) %
+                    static_cast<unsigned>(size));
+            table::value_type v = { k, k };
+            t.insert(v);
+        }
+        insert = now() - insert;
+        mapped_table m;
+        if(!m.write(path, t))
+        {
+            printf("write failed\n");
+            return EXIT_FAILURE;
+        }
+        double open = now();
+        if(!m.open(path))
+        {
+            printf("open failed\n");
+            return EXIT_FAILURE;
+        }
+        open = now() - open;
+        make_probes(probes, size);
+        long hits = 0;
+        long mappedhits = 0;
+        double unordered = run_find(t, probes, hits);
+        double mapped = run_find(m, probes, mappedhits);
+        if(hits != mappedhits)
+        {
+            printf("mismatched results\n");
+            return EXIT_FAILURE;
+        }
+        printf("%10d %10.3f %10.3f %10.2f %10.2f\n",
+            size,
+            insert * 1e3,
+            open * 1e3,
+            unordered,
+            mapped);
+    }
+    remove(path);
+    free(probes);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+/**
+ * @brief     unit test for taapp::mapped_unordered_map
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#if defined(_DEBUG) && defined(_MSC_FULL_VER)
+#define _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#define taapp_MAPPED_UNORDERED_MAP_INTERNAL_API
+#include <taapp/hash.h>
+#include <taapp/mapped_unordered_map.h>
+#include <taapp/unordered_map.h>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef NDEBUG
+#error asserts are not enabled
+#endif
+
+// a trivially copyable value with padding after its first member
+struct record
+{
+    char tag;
+    int count;
+    double weight;
+};
+
+// any hash other than the one the file was written with
+struct other_hash
+{
+    size_t operator()(int a) const
+    {
+        return static_cast<size_t>(a) * 31;
+    }
+};
+
+typedef taapp::unordered_map<int, record> table;
+typedef taapp::mapped_unordered_map<int, record> mapped_table;
+
+enum
+{
+    KEYS = 100000
+};
+
+static void check(const mapped_table& m, int count)
+{
+    assert(m.is_open());
+    assert(m.size() == static_cast<size_t>(count));
+    assert(m.bucket_count() * 3 >= m.size() * 4);
+    for(int i = 0; i < count; ++i)
+    {
+        const mapped_table::value_type* v = m.find(i * 2);
+        assert(v != NULL && v->first == i * 2);
+        assert(v->second.tag == static_cast<char>(i));
+        assert(v->second.count == -i && v->second.weight == i * 0.5);
+        assert(!m.contains(i * 2 + 1));
+    }
+    assert(!m.contains(-2));
+}
+
+static void write_table(const char* path, int count)
+{
+    table t;
+    for(int i = 0; i < count; ++i)
+    {
+        // clear the padding, so that equal tables are equal byte for byte
+        record r;
+        memset(&r, 0, sizeof(r));
+        r.tag = static_cast<char>(i);
+        r.count = -i;
+        r.weight = i * 0.5;
+        t.insert_or_assign(i * 2, r);
+    }
+    mapped_table writer;
+    assert(!writer.is_open());
+    bool written = writer.write(path, t);
+    assert(written);
+}
+
+// the file is found through any mapping of it
+static void test_lookup()
+{
+    const char* path = "mappedmaptest.table";
+    write_table(path, KEYS);
+    {
+        mapped_table a;
+        mapped_table b;
+        assert(a.open(path));
+        assert(b.open(path));
+        // the two views are at different addresses
+        assert(a.find(0) != b.find(0));
+        check(a, KEYS);
+        check(b, KEYS);
+        a.close();
+        assert(!a.is_open() && a.size() == 0 && !a.contains(0));
+        check(b, KEYS);
+    }
+    // equal maps write equal files
+    const char* copy = "mappedmaptest.copy";
+    write_table(copy, KEYS);
+    FILE* fa = fopen(path, "rb");
+    FILE* fb = fopen(copy, "rb");
+    assert(fa != NULL && fb != NULL);
+    int ca = 0;
+    int cb = 0;
+    while(ca != EOF)
+    {
+        ca = fgetc(fa);
+        cb = fgetc(fb);
+        assert(ca == cb);
+    }
+    fclose(fa);
+    fclose(fb);
+    remove(copy);
+    // an empty map
+    write_table(path, 0);
+    {
+        mapped_table m;
+        assert(m.open(path));
+        check(m, 0);
+    }
+    remove(path);
+}
+
+// files that do not match the types, or are damaged, are not opened
+static void test_invalid()
+{
+    const char* path = "mappedmaptest.table";
+    mapped_table m;
+    assert(!m.open("mappedmaptest.missing"));
+    write_table(path, 1000);
+    taapp::mapped_unordered_map<int, double> other;
+    assert(!other.open(path));
+    // the same types with a different hash
+    taapp::mapped_unordered_map<int, record, other_hash> rehashed;
+    assert(!rehashed.open(path));
+    assert(m.open(path));
+    m.close();
+    // a truncated file
+    FILE* f = fopen(path, "rb");
+    assert(f != NULL);
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* bytes = static_cast<char*>(malloc(size));
+    assert(fread(bytes, 1, size, f) == static_cast<size_t>(size));
+    fclose(f);
+    f = fopen(path, "wb");
+    assert(f != NULL);
+    fwrite(bytes, 1, size - 1, f);
+    fclose(f);
+    free(bytes);
+    assert(!m.open(path));
+    // a control section offset that wraps around when the table's size is
+    // added to it
+    write_table(path, 1000);
+    f = fopen(path, "r+b");
+    assert(f != NULL);
+    mapped_table::header h;
+    assert(fread(&h, sizeof(h), 1, f) == 1);
+    h.controls = 0ULL - h.capacity;
+    fseek(f, 0, SEEK_SET);
+    fwrite(&h, sizeof(h), 1, f);
+    fclose(f);
+    assert(!m.open(path));
+    // not a table at all
+    f = fopen(path, "wb");
+    assert(f != NULL);
+    fputs("not a table", f);
+    fclose(f);
+    assert(!m.open(path));
+    remove(path);
+}
+
+int main(int argc, char* argv[])
+{
+    printf("testing taapp::mapped_unordered_map...");
+    fflush(stdout);
+    test_lookup();
+    test_invalid();
+    printf("pass\n");
+#if defined(_DEBUG) && defined(_MSC_FULL_VER)
+    _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
+    _CrtSetReportFile(_CRT_ERROR, _CRTDBG_FILE_STDOUT);
+    _CrtCheckMemory();
+    _CrtDumpMemoryLeaks();
+#endif
+    return EXIT_SUCCESS;
+}
@@ -242,6 +242,47 @@ public:
             map.clear();
             assert(0 == map.size());
 
+            // test range insert with duplicate keys
+            {
+                typename imap::value_type values[64];
+                for(int i = 0; i < 64; ++i)
+                {
+                    int j = i % 48;
+                    typename imap::value_type v =
+                    {
+                        j, ((unsigned char*)NULL) + j
+                    };
+                    values[i] = v;
+                }
+                map.insert(values, values + 64);
+                validate_tree(map.root_);
+                assert(48 == map.size());
+                assert(map.find(47)->second == ((unsigned char*)NULL) + 47);
+                map.clear();
+            }
+
+            // test swap
+            {
+                imap map2;
+                for(int i = 0; i < 16; ++i)
+                {
+                    typename imap::value_type v =
+                    {
+                        i, ((unsigned char*)NULL) + i
+                    };
+                    map2.insert(v);
+                }
+                map.swap(map2);
+                assert(16 == map.size());
+                assert(0 == map2.size());
+                assert(map2.find(3) == map2.end());
+                assert(map.find(3)->second == ((unsigned char*)NULL) + 3);
+                validate_tree(map.root_);
+                map2.swap(map);
+                assert(0 == map.size());
+                assert(16 == map2.size());
+            }
+
             // insert again to test destruction
             typename imap::value_type v = { 0, NULL };
             map.insert(v);
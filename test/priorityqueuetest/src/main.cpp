@@ -103,7 +103,7 @@ public:
             int j;
             for(j = 0; j < POT_SIZE; ++j)
             {
-                if(pot.container_[j] == vec[i])
+                if(pot.container()[j] == vec[i])
                 {
                     vec[i] = -1;
                     break;
@@ -116,7 +116,7 @@ public:
         for(i = 0; i < POT_SIZE; ++i)
         {
             printf("%4u", ((int) pot.top()));
-            assert(prev >= pot.container_[0]);
+            assert(prev >= pot.container()[0]);
             pot.pop();
             prev = pot.top();
             --size;
@@ -236,6 +236,38 @@ public:
             assert(set.empty());
             assert(0 == set.size());
 
+            // test range insert with duplicate keys
+            {
+                T values[64];
+                for(int i = 0; i < 64; ++i)
+                {
+                    values[i] = i % 48;
+                }
+                set.insert(values, values + 64);
+                validate_tree(set.root_);
+                assert(48 == set.size());
+                assert(set.find(47) != set.end());
+                set.clear();
+            }
+
+            // test swap
+            {
+                iset set2;
+                for(int i = 0; i < 16; ++i)
+                {
+                    set2.insert(i);
+                }
+                set.swap(set2);
+                assert(16 == set.size());
+                assert(set2.empty());
+                assert(set2.find(3) == set2.end());
+                assert(set.find(3) != set.end());
+                validate_tree(set.root_);
+                set2.swap(set);
+                assert(set.empty());
+                assert(16 == set2.size());
+            }
+
             // insert again to test destruction
             set.insert(0);
         }
@@ -0,0 +1,117 @@
+/**
+ * @brief     multithreaded node allocation benchmark
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#include <taapp/allocator.h>
+#include <taapp/map.h>
+#include <taapp/thread.h>
+#include <taapp/thread_cache_allocator.h>
+#include <taapp/unordered_map.h>
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+struct int_less
+{
+    bool operator()(int a, int b) const
+    {
+        return a < b;
+    }
+};
+
+struct int_equal
+{
+    bool operator()(int a, int b) const
+    {
+        return a == b;
+    }
+};
+
+struct int_hash
+{
+    size_t operator()(int a) const
+    {
+        return static_cast<size_t>(a) * 2654435761u;
+    }
+};
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+enum
+{
+    KEYS = 20000,
+    ROUNDS = 20,
+    MAX_THREADS = 64
+};
+
+// each worker owns its containers and repeatedly fills and empties them
+template<typename Allocator>
+static void worker(void*)
+{
+    typedef taapp::map<int, int, int_less, Allocator> tree;
+    typedef taapp::unordered_map<int, int, int_hash, int_equal, Allocator>
+        table;
+    tree t;
+    table h;
+    for(int r = 0; r < ROUNDS; ++r)
+    {
+        for(int i = 0; i < KEYS; ++i)
+        {
+            typename tree::value_type v = { i, i };
+            t.insert(v);
+            h.insert(v);
+        }
+        for(int i = 0; i < KEYS; ++i)
+        {
+            t.erase(i);
+            h.erase(i);
+        }
+    }
+}
+
+template<typename Allocator>
+static double run(int count)
+{
+    taapp::thread threads[MAX_THREADS];
+    double t = now();
+    for(int i = 0; i < count; ++i)
+    {
+        threads[i].start(&worker<Allocator>, NULL);
+    }
+    for(int i = 0; i < count; ++i)
+    {
+        threads[i].join();
+    }
+    t = now() - t;
+    // two containers, one insert and one erase per key per round
+    return 4.0 * KEYS * ROUNDS * count / t / 1e6;
+}
+
+int main(int argc, char* argv[])
+{
+    int maxthreads = (argc > 1) ? atoi(argv[1]) : MAX_THREADS;
+    if(maxthreads > MAX_THREADS)
+    {
+        maxthreads = MAX_THREADS;
+    }
+    printf("insert/erase throughput in millions of operations per second\n");
+    printf("%8s %14s %22s %8s\n",
+        "threads",
+        "allocator",
+        "thread_cache_allocator",
+        "ratio");
+    for(int n = 1; n <= maxthreads; n <<= 1)
+    {
+        double base = run<taapp::allocator<int> >(n);
+        double cached = run<taapp::thread_cache_allocator<int> >(n);
+        printf("%8d %14.2f %22.2f %7.2fx\n", n, base, cached, cached / base);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+/**
+ * @brief     unordered_map lookup benchmark
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2010
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#include <taapp/allocator.h>
+#include <taapp/unordered_map.h>
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+struct int_equal
+{
+    bool operator()(int a, int b) const
+    {
+        return a == b;
+    }
+};
+
+struct int_hash
+{
+    size_t operator()(int a) const
+    {
+        return static_cast<size_t>(a) * 2654435761u;
+    }
+};
+
+typedef taapp::unordered_map<
+    int,
+    int,
+    int_hash,
+    int_equal,
+    taapp::allocator<int> > table;
+
+typedef taapp::unordered_map<
+    int,
+    int,
+    int_hash,
+    int_equal,
+    taapp::allocator<int>,
+    true> ordered_table;
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+enum
+{
+    PROBES = 1 << 22,
+    BATCH = 256,
+    ITERATIONS = 8
+};
+
+// random keys, half of which are in a table of size keys
+static void make_probes(int* probes, int size)
+{
+    for(int i = 0; i < PROBES; ++i)
+    {
+        probes[i] = rand() % (size * 2);
+    }
+}
+
+static double run_find(const table& t, const int* probes, long& hits)
+{
+    double s = now();
+    for(int i = 0; i < PROBES; ++i)
+    {
+        hits += (t.find(probes[i]) != t.end()) ? 1 : 0;
+    }
+    return PROBES / (now() - s) / 1e6;
+}
+
+static double run_find_many(const table& t, const int* probes, long& hits)
+{
+    table::const_iterator found[BATCH];
+    double s = now();
+    for(int i = 0; i < PROBES; i += BATCH)
+    {
+        t.find_many(probes + i, BATCH, found);
+        for(int j = 0; j < BATCH; ++j)
+        {
+            hits += (found[j] != t.end()) ? 1 : 0;
+        }
+    }
+    return PROBES / (now() - s) / 1e6;
+}
+
+// items visited per microsecond by a full iteration after erasing all but
+// one in keep
+template<typename Map> static double run_iterate(int size, int keep)
+{
+    Map t;
+    for(int i = 0; i < size; ++i)
+    {
+        typename Map::value_type v = { i, i };
+        t.insert(v);
+    }
+    for(int i = 0; i < size; ++i)
+    {
+        if(i % keep != 0)
+        {
+            t.erase(i);
+        }
+    }
+    long sum = 0;
+    double s = now();
+    for(int r = 0; r < ITERATIONS; ++r)
+    {
+        typename Map::const_iterator itr(t.begin());
+        typename Map::const_iterator end(t.end());
+        while(itr != end)
+        {
+            sum += itr->second;
+            ++itr;
+        }
+    }
+    s = now() - s;
+    if(sum == 1)
+    {
+        printf(" ");
+    }
+    return static_cast<double>(t.size()) * ITERATIONS / s / 1e6;
+}
+
+int main(int argc, char* argv[])
+{
+    int maxsize = (argc > 1) ? atoi(argv[1]) : (1 << 24);
+    int* probes = static_cast<int*>(malloc(sizeof(int) * PROBES));
+    printf("lookup throughput in millions of probes per second\n");
+    printf("%10s %10s %10s %8s\n", "size", "find", "find_many", "ratio");
+    for(int size = 1 << 12; size <= maxsize; size <<= 2)
+    {
+        table t;
+        // insert in a shuffled order so the nodes are scattered in memory
+        for(int i = 0; i < size; ++i)
+        {
+            int k = static_cast<int>(
+                (static_cast<unsigned>(i) * 2654435761u) %
+                    static_cast<unsigned>(size));
+            table::value_type v = { k, k };
+            t.insert(v);
+        }
+        make_probes(probes, size);
+        long hits = 0;
+        long hitsmany = 0;
+        double single = run_find(t, probes, hits);
+        double many = run_find_many(t, probes, hitsmany);
+        if(hits != hitsmany)
+        {
+            printf("mismatched results\n");
+            return EXIT_FAILURE;
+        }
+        printf("%10d %10.2f %10.2f %7.2fx\n",
+            size,
+            single,
+            many,
+            many / single);
+    }
+    free(probes);
+    printf("\niteration throughput in millions of items per second after "
+        "erasing\n");
+    printf("%10s %10s %10s %10s\n", "size", "kept", "unordered", "ordered");
+    static const int keeps[] = { 1, 10, 100 };
+    for(size_t k = 0; k < sizeof(keeps) / sizeof(keeps[0]); ++k)
+    {
+        int size = 1 << 20;
+        printf("%10d %9.1f%% %10.2f %10.2f\n",
+            size,
+            100.0 / keeps[k],
+            run_iterate<table>(size, keeps[k]),
+            run_iterate<ordered_table>(size, keeps[k]));
+    }
+    return EXIT_SUCCESS;
+}
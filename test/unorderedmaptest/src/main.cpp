@@ -9,6 +9,7 @@
 #include <crtdbg.h>
 #endif
 
+#define taapp_UNORDERED_MAP_COUNT_PROBES
 #include <taapp/unordered_map.h>
 #include <cassert>
 #include <cstdio>
@@ -148,7 +149,7 @@ private:
     };
 };
 
-template<typename T, typename U>
+template<typename T, typename U, bool Ordered>
 class map_test
 {
 public:
@@ -216,6 +217,18 @@ public:
                     --size;
                 }
             }
+            // test shrinking the table after the erases
+            {
+                size_t buckets = map.bucket_count();
+                map.shrink_to_fit();
+                assert(map.bucket_count() < buckets);
+                assert(map.load_factor() <= 1.0f);
+                typename imap::iterator itr(map.begin());
+                assert(itr != map.end());
+                assert(map.find(itr->first) == itr);
+                ++itr;
+                assert(itr == map.end());
+            }
             // insert randomly
             for(int i = 0; i < max; ++i)
             {
@@ -236,9 +249,211 @@ public:
             // test clear
             map.clear();
             assert(0 == map.size());
+            // test range insert with duplicate keys, which sizes the table
+            // once for the whole range
+            {
+                typename imap::value_type values[64];
+                for(int i = 0; i < 64; ++i)
+                {
+                    int j = i % 48;
+                    typename imap::value_type v =
+                    {
+                        j,
+                        ((unsigned char*)NULL) + j
+                    };
+                    values[i] = v;
+                }
+                map.insert(values, values + 64);
+                assert(48 == map.size());
+                assert(map.load_factor() <= 1.0f);
+                assert(map.find(47)->second == ((unsigned char*)NULL) + 47);
+                map.clear();
+            }
+            // test the single lookup insert paths
+            {
+                unsigned char* p = NULL;
+                taapp::pair<typename imap::iterator, bool> ir;
+                ir = map.try_emplace(1, p + 1);
+                assert(ir.second && ir.first->second == p + 1);
+                ir = map.try_emplace(1, p + 2);
+                assert(!ir.second && ir.first->second == p + 1);
+                ir = map.insert_or_assign(1, p + 3);
+                assert(!ir.second && ir.first->second == p + 3);
+                ir = map.insert_or_assign(2, p + 4);
+                assert(ir.second && ir.first->second == p + 4);
+                ir = map.try_emplace(3);
+                assert(ir.second);
+                ir.first->second = p + 6;
+                ir = map.try_emplace(3);
+                assert(!ir.second && ir.first->second == p + 6);
+                assert(map[1] == p + 3);
+                map[4] = p + 5;
+                assert(map.find(4)->second == p + 5);
+                assert(4 == map.size());
+                for(int i = 0; i < 100; ++i)
+                {
+                    map[i] = p + i;
+                }
+                assert(100 == map.size());
+                assert(map.load_factor() <= 1.0f);
+                for(int i = 0; i < 100; ++i)
+                {
+                    assert(map.find(i)->second == p + i);
+                }
+                // batched lookups, including misses and a partial group
+                T keys[150];
+                typename imap::iterator found[150];
+                for(int i = 0; i < 150; ++i)
+                {
+                    keys[i] = (i * 7) % 150;
+                }
+                map.find_many(keys, 150, found);
+                const imap& cmap = map;
+                typename imap::const_iterator cfound[150];
+                cmap.find_many(keys, 150, cfound);
+                for(int i = 0; i < 150; ++i)
+                {
+                    int k = (i * 7) % 150;
+                    if(k < 100)
+                    {
+                        assert(found[i] == map.find(k));
+                        assert(found[i]->second == p + k);
+                        assert(cfound[i] == found[i]);
+                    }
+                    else
+                    {
+                        assert(found[i] == map.end());
+                        assert(cfound[i] == cmap.end());
+                    }
+                }
+                map.clear();
+            }
+            // an empty map releases its buckets
+            map.shrink_to_fit();
+            assert(0 == map.bucket_count());
+            assert(map.find(0) == map.end());
+            // test swap with a map that has buckets
+            {
+                imap map2;
+                for(int i = 0; i < 16; ++i)
+                {
+                    typename imap::value_type v =
+                    {
+                        i,
+                        ((unsigned char*)NULL) + i
+                    };
+                    map2.insert(v);
+                }
+                size_t buckets = map2.bucket_count();
+                map.swap(map2);
+                assert(16 == map.size());
+                assert(buckets == map.bucket_count());
+                assert(0 == map2.size());
+                assert(0 == map2.bucket_count());
+                assert(map2.find(3) == map2.end());
+                assert(map.find(3)->second == ((unsigned char*)NULL) + 3);
+                map2.swap(map);
+                assert(0 == map.size());
+                assert(16 == map2.size());
+            }
+            // test the diagnostics on a table with one long chain
+            {
+                map.rehash(13);
+                assert(13 == map.bucket_count());
+                static const int keys[] = { 0, 13, 26, 1 };
+                for(int i = 0; i < 4; ++i)
+                {
+                    typename imap::value_type v =
+                    {
+                        keys[i],
+                        ((unsigned char*)NULL) + keys[i]
+                    };
+                    map.insert(v);
+                }
+                assert(3 == map.bucket_size(0));
+                assert(1 == map.bucket_size(1));
+                assert(0 == map.bucket_size(2));
+                taapp::hash_stats st;
+                map.reset_probe_counts();
+                map.stats(st);
+                assert(4 == st.size);
+                assert(13 == st.bucket_count);
+                assert(11 == st.empty_buckets);
+                assert(3 == st.max_chain);
+                assert(2.0f == st.mean_chain);
+                assert(11 == st.histogram[0]);
+                assert(1 == st.histogram[1]);
+                assert(0 == st.histogram[2]);
+                assert(1 == st.histogram[3]);
+                // (1 + 2 + 3) probes in bucket 0 and 1 in bucket 1
+                assert(1.75f == st.probes_hit);
+                assert(4.0f / 13.0f == st.probes_miss);
+                assert(0 == st.counted_hits && 0 == st.counted_misses);
+                // the last key of the long chain and a miss in it
+                assert(map.find(keys[0]) != map.end());
+                assert(map.find(39) == map.end());
+                map.stats(st);
+                assert(1 == st.counted_hits);
+                assert(3 == st.counted_hit_probes);
+                assert(1 == st.counted_misses);
+                assert(3 == st.counted_miss_probes);
+                // erase from the middle and the head of the chain
+                map.erase(map.find(13));
+                assert(2 == map.bucket_size(0));
+                assert(map.find(0) != map.end());
+                assert(map.find(26) != map.end());
+                // a miss walks the whole chain and unlinks nothing
+                assert(0 == map.erase(39));
+                assert(2 == map.bucket_size(0));
+                assert(1 == map.erase(26));
+                assert(1 == map.bucket_size(0));
+                assert(map.find(0)->first == 0);
+                map.clear();
+            }
+            // an ordered map iterates in insertion order
+            if(Ordered)
+            {
+                unsigned char* p = NULL;
+                for(int i = 0; i < 64; ++i)
+                {
+                    map.insert_or_assign((i * 37) % 64, p + i);
+                }
+                // erase through an advanced iterator, which has no bucket
+                typename imap::iterator itr(map.begin());
+                ++itr;
+                assert(itr->first == 37);
+                map.erase(itr);
+                map.erase(0);
+                // reinserting moves a key to the end; assigning does not
+                map.insert_or_assign(0, p);
+                map.insert_or_assign(74 % 64, p);
+                int count = 0;
+                const imap& cmap = map;
+                typename imap::const_iterator citr(cmap.begin());
+                for(int i = 2; i < 64; ++i)
+                {
+                    assert(citr->first == (i * 37) % 64);
+                    ++citr;
+                    ++count;
+                }
+                assert(citr->first == 0);
+                ++citr;
+                assert(citr == cmap.end());
+                assert(63 == count + 1 && 63 == map.size());
+                map.clear();
+                assert(map.begin() == map.end());
+                map.insert_or_assign(5, p);
+                assert(map.begin()->first == 5);
+                map.clear();
+            }
             // insert again to test destruction
             typename imap::value_type v = { 0, NULL };
             map.insert(v);
+            // emptying and refilling the map must not grow the table
+            size_t buckets = map.bucket_count();
+            map.erase(0);
+            map.insert(v);
+            assert(map.bucket_count() == buckets);
         }
         assert(maptest_instance_counter == 0);
         assert(maptest_allocate_counter == 0);
@@ -264,18 +479,26 @@ private:
     };
 
     typedef test_alloc<T> ialloc;
-    typedef taapp::unordered_map<T,U,ihash,iequal,ialloc> imap;
+    typedef taapp::unordered_map<T,U,ihash,iequal,ialloc,Ordered> imap;
 };
 
 int main(int argc, char* argv[])
 {
     printf("testing taapp::unordered_map<int, unsigned char*>...");
     fflush(stdout);
-    map_test<int, unsigned char*>::execute();
+    map_test<int, unsigned char*, false>::execute();
     printf("pass\n");
     printf("testing taapp::unordered_map<int_class, ptr_class>...");
     fflush(stdout);
-    map_test<int_class, ptr_class>::execute();
+    map_test<int_class, ptr_class, false>::execute();
+    printf("pass\n");
+    printf("testing ordered taapp::unordered_map<int, unsigned char*>...");
+    fflush(stdout);
+    map_test<int, unsigned char*, true>::execute();
+    printf("pass\n");
+    printf("testing ordered taapp::unordered_map<int_class, ptr_class>...");
+    fflush(stdout);
+    map_test<int_class, ptr_class, true>::execute();
     printf("pass\n");
 #if defined(_DEBUG) && defined(_MSC_FULL_VER)
     _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
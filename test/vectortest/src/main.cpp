@@ -9,9 +9,13 @@
 #include <crtdbg.h>
 #endif
 
+#define taapp_HEAP_USABLE_SIZE
 #define taapp_VECTOR_INTERNAL_API
 #include <taapp/vector.h>
+#include <taapp/aligned_allocator.h>
 #include <taapp/allocator.h>
+#include <taapp/hugepage_allocator.h>
+#include <taapp/mmap_allocator.h>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
@@ -26,7 +30,7 @@ public:
     int i_;
     static int tracker;
     
-    int_class()
+    int_class() : i_(0)
     {
         ++tracker;
     }
@@ -60,6 +64,71 @@ public:
 
 int int_class::tracker;
 
+struct is_vowel
+{
+    template<typename T>
+    bool operator()(const T& t) const
+    {
+        return t == 'a' || t == 'e' || t == 'i' || t == 'o' || t == 'u';
+    }
+};
+
+template<typename T>
+void check_contents(T& v, const char* expected)
+{
+    typename T::iterator itr = v.begin();
+    while(*expected != '\0')
+    {
+        assert(itr != v.end());
+        assert(*itr == *expected);
+        ++expected;
+        ++itr;
+    }
+    assert(itr == v.end());
+}
+
+template<typename T>
+void test_range(T& v)
+{
+    int ch;
+    typename T::iterator itr;
+    T src;
+    for(ch = '0'; ch <= '9'; ++ch)
+    {
+        src.push_back(ch);
+    }
+    v.append(src.begin(), src.begin() + 3);
+    v.append(src.begin() + 7, src.end());
+    check_contents(v, "012789");
+    // inserted range is longer than the tail it displaces
+    itr = v.insert(v.begin() + 3, src.begin() + 3, src.begin() + 7);
+    assert(*itr == '3');
+    check_contents(v, "0123456789");
+    // inserted range is shorter than the tail it displaces
+    itr = v.insert(v.begin() + 1, src.begin(), src.begin() + 2);
+    assert(*itr == '0');
+    check_contents(v, "001123456789");
+    itr = v.insert(v.end(), src.end() - 1, src.end());
+    check_contents(v, "0011234567899");
+    itr = v.insert(v.begin(), src.begin(), src.begin());
+    assert(itr == v.begin());
+    check_contents(v, "0011234567899");
+    // assign within the existing capacity
+    v.assign(src.begin() + 5, src.end());
+    check_contents(v, "56789");
+    // assign past the existing capacity
+    for(ch = 10; ch < 100; ++ch)
+    {
+        src.push_back('0' + ch % 10);
+    }
+    v.assign(src.begin(), src.end());
+    assert(v.size() == 100);
+    assert(v.capacity() >= 100);
+    assert(v[99] == '9');
+    v.assign(src.begin(), src.begin());
+    assert(v.empty());
+}
+
 template<typename T>
 void test_vector(T& v)
 {
@@ -88,6 +157,22 @@ void test_vector(T& v)
     itr = v.insert(itr, 'd');
     assert(v.size() == 25);
     assert(*itr == 'd');
+    // copy elements while the vector is full, so that the buffer they
+    // refer to moves
+    while(v.size() != v.capacity())
+    {
+        v.push_back(v.back());
+    }
+    v.push_back(v.back());
+    assert(v.back() == 'z');
+    while(v.size() != v.capacity())
+    {
+        v.push_back(v.back());
+    }
+    itr = v.insert(v.begin(), v[1]);
+    assert(v[0] == 'b' && v[1] == 'a' && v[2] == 'b');
+    v.erase(v.begin());
+    v.resize(25);
     // make sure contents of the vector is the ordered alphabet, excluding 'e'
     itr = v.begin();
     end = v.end();
@@ -109,6 +194,168 @@ void test_vector(T& v)
     v.resize(25);
     assert(v.size() == 25);
     v[24] = 'z';
+    // remove 'f' through 'j' in one call
+    itr = v.erase(v.begin() + ('f' - 'a' - 1), v.begin() + ('k' - 'a' - 1));
+    assert(v.size() == 20);
+    assert(*itr == 'k');
+    assert(*(itr - 1) == 'd');
+    // an empty range is a no-op
+    itr = v.erase(v.begin() + 2, v.begin() + 2);
+    assert(v.size() == 20);
+    assert(*itr == 'c');
+    // erase the tail
+    itr = v.erase(v.end() - 2, v.end());
+    assert(itr == v.end());
+    assert(v.size() == 18);
+    assert(v.back() == 'x');
+    // remove the vowels 'a', 'o' and 'u'
+    assert(v.erase_if(is_vowel()) == 3);
+    assert(v.size() == 15);
+    check_contents(v, "bcdklmnpqrstvwx");
+    // nothing left to remove
+    assert(v.erase_if(is_vowel()) == 0);
+    assert(v.size() == 15);
+}
+
+// grows a vector across the allocator's mapping threshold so every
+// reallocate path is used. alignment is the expected alignment of large
+// buffers on linux, or 0 if there is no requirement
+template<typename Allocator>
+void test_large_vector(size_t alignment)
+{
+    typedef taapp::vector<int, Allocator> int_vector;
+    int_vector v;
+    test_vector(v);
+    v.clear();
+    for(int i = 0; i < 1 << 20; ++i)
+    {
+        v.push_back(i);
+    }
+    v.reserve(v.size() * 3);
+#if defined(__linux__)
+    if(alignment != 0)
+    {
+        assert(reinterpret_cast<size_t>(v.begin()) % alignment == 0);
+    }
+#endif
+    for(int i = 0; i < 1 << 20; ++i)
+    {
+        assert(v[i] == i);
+    }
+    // shrink from a mapping back onto the heap
+    v.resize(100);
+    v.shrink_to_fit();
+    assert(v.capacity() >= 100);
+    assert(v.capacity() < 1024);
+    for(int i = 0; i < 100; ++i)
+    {
+        assert(v[i] == i);
+    }
+}
+
+// every buffer the vector holds must keep the allocator's alignment,
+// including those grown through the realloc path for trivial types
+template<size_t Alignment>
+void test_aligned_vector()
+{
+    typedef taapp::aligned_allocator<float, Alignment> float_allocator;
+    typedef taapp::vector<float, float_allocator> float_vector;
+    float_vector v;
+    for(int i = 0; i < 100000; ++i)
+    {
+        v.push_back(static_cast<float>(i));
+        assert(reinterpret_cast<size_t>(v.begin()) % Alignment == 0);
+    }
+    v.reserve(v.size() * 2);
+    assert(reinterpret_cast<size_t>(v.begin()) % Alignment == 0);
+    v.resize(1000);
+    v.shrink_to_fit();
+    assert(reinterpret_cast<size_t>(v.begin()) % Alignment == 0);
+    for(int i = 0; i < 1000; ++i)
+    {
+        assert(v[i] == static_cast<float>(i));
+    }
+}
+
+static int unsized_reallocations = 0;
+
+// an allocator written before reallocate was told the old size
+template<typename T> class unsized_allocator
+{
+public:
+
+    template<typename U> struct rebind
+    {
+        typedef unsized_allocator<U> other;
+    };
+
+    T* allocate(size_t n, const void* = 0)
+    {
+        return static_cast<T*>(malloc(sizeof(T) * n));
+    }
+
+    T* reallocate(void* p, size_t n)
+    {
+        ++unsized_reallocations;
+        return static_cast<T*>(realloc(p, sizeof(T) * n));
+    }
+
+    void construct(T* p, const T& v)
+    {
+        *p = v;
+    }
+
+    void destroy(T*)
+    {
+    }
+
+    void deallocate(T* p, size_t)
+    {
+        free(p);
+    }
+};
+
+// the vector falls back to reallocate(p, n) for such allocators
+static void test_unsized_reallocate()
+{
+    typedef unsized_allocator<int> int_allocator;
+    taapp::vector<int, int_allocator> v;
+    for(int i = 0; i < 1000; ++i)
+    {
+        v.push_back(i);
+    }
+    assert(unsized_reallocations > 0);
+    for(int i = 0; i < 1000; ++i)
+    {
+        assert(v[i] == i);
+    }
+}
+
+// allocators that report the usable size of their blocks let the vector
+// treat the allocator's rounding as free capacity. taapp::allocator only
+// reports it when compiled with taapp_HEAP_USABLE_SIZE
+static void test_usable_size()
+{
+    typedef taapp::allocator<char> char_allocator;
+    typedef taapp::vector<char, char_allocator> char_vector;
+    typedef taapp::allocator_traits<char_allocator, char> traits;
+    typedef int traits_check[traits::HAS_USABLE_SIZE*2 - 1];
+    (void) sizeof(traits_check);
+    char_vector v;
+    v.push_back('a');
+    assert(v.capacity() >= 8);
+#if defined(__GLIBC__)
+    // glibc never hands out fewer than 24 usable bytes
+    assert(v.capacity() >= 24);
+#endif
+    size_t c = v.capacity();
+    while(v.size() < c)
+    {
+        v.push_back('b');
+    }
+    // the full block is usable without tripping over the heap's bounds
+    assert(v.capacity() == c);
+    assert(v[c - 1] == 'b');
 }
 
 int main(int argc, char* argv[])
@@ -120,8 +367,11 @@ int main(int argc, char* argv[])
         typedef taapp::allocator<int> int_allocator;
         typedef taapp::vector<int, int_allocator> int_vector;
         typedef int traits_check[int_vector::TRIVIAL*2 - 1];
+        (void) sizeof(traits_check);
         int_vector v;  
         test_vector(v);
+        int_vector r;
+        test_range(r);
     }
     printf("pass\n");
     printf("testing taapp::vector<int_class>...");
@@ -131,22 +381,62 @@ int main(int argc, char* argv[])
         typedef taapp::allocator<int_class> int_allocator;
         typedef taapp::vector<int_class, int_allocator> int_vector;
         typedef int traits_check[(!int_vector::TRIVIAL)*2 - 1];
+        (void) sizeof(traits_check);
         int_vector v;
         test_vector(v);
+        {
+            int_vector r;
+            test_range(r);
+        }
         assert(v.size() != 0);
         assert(int_class::tracker == static_cast<int>(v.size()));
         v.resize(v.size() + 30);
         assert(int_class::tracker == static_cast<int>(v.size()));
         v.resize(v.size() - 10);
         assert(int_class::tracker == static_cast<int>(v.size()));
+        // verify that shrink_to_fit drops the reserve but keeps the contents.
+        // the allocator may report a little slack in the new block
+        v.shrink_to_fit();
+        assert(v.capacity() >= v.size());
+        assert(v.capacity() < v.size() + 8);
+        assert(int_class::tracker == static_cast<int>(v.size()));
+        assert(v[0] == 'b');
         // verify that clear sets size to zero, but does not destroy reserve
         v.clear();
         assert(v.size() == 0);
         assert(v.capacity() != 0);
         assert(v.begin_ != NULL);
         assert(int_class::tracker == 0);
+        // an empty vector releases its buffer
+        v.shrink_to_fit();
+        assert(v.capacity() == 0);
+        assert(v.begin_ == NULL);
+        v.push_back(1);
+        assert(v.size() == 1);
     }
     printf("pass\n");
+    printf("testing taapp::vector<char> usable size...");
+    fflush(stdout);
+    test_usable_size();
+    printf("pass\n");
+    printf("testing taapp::vector<int> unsized reallocate...");
+    fflush(stdout);
+    test_unsized_reallocate();
+    printf("pass\n");
+    printf("testing taapp::vector<float, aligned_allocator>...");
+    fflush(stdout);
+    test_aligned_vector<32>();
+    test_aligned_vector<64>();
+    test_aligned_vector<4096>();
+    printf("pass\n");
+    printf("testing taapp::vector<int, mmap_allocator>...");
+    fflush(stdout);
+    test_large_vector<taapp::mmap_allocator<int, 4096> >(0);
+    printf("pass\n");
+    printf("testing taapp::vector<int, hugepage_allocator>...");
+    fflush(stdout);
+    test_large_vector<taapp::hugepage_allocator<int, 4096> >(2097152);
+    printf("pass\n");
 #if defined(_DEBUG) && defined(_MSC_FULL_VER)
     _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
     _CrtSetReportFile(_CRT_ERROR, _CRTDBG_FILE_STDOUT);